@@ -0,0 +1,163 @@
+/*
+ *	Example10 shows hedged requests. It starts a local
+ *	server whose responses are usually fast, but sometimes
+ *	very slow, and runs the same batch of asynchronous GET
+ *	calls against it with and without hedging, printing
+ *	the latency percentiles of each. It fails if any
+ *	request does, or sees the headers of more than one
+ *	response, so it doubles as a regression run
+ */
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using asio::ip::tcp;
+
+struct Connection
+{
+	explicit Connection(tcp::socket socket) : socket(std::move(socket)) {}
+	tcp::socket socket;
+	asio::streambuf request;
+};
+
+// the server answers one request per connection. 1 in 20
+// responses takes half a second, the rest take 5 milliseconds
+void Serve(tcp::acceptor& acceptor, std::mt19937& rng)
+{
+	acceptor.async_accept([&acceptor, &rng](const asio::error_code& ec, tcp::socket socket)
+		{
+			if (ec)
+				return;
+			auto conn = std::make_shared<Connection>(std::move(socket));
+			const auto delay = (std::uniform_int_distribution<int>(0, 19)(rng) == 0) ?
+				std::chrono::milliseconds(500) : std::chrono::milliseconds(5);
+			asio::async_read_until(conn->socket, conn->request, "\r\n\r\n",
+				[conn, delay](const asio::error_code& ec, size_t)
+				{
+					if (ec)
+						return;
+					auto timer = std::make_shared<asio::steady_timer>(
+						conn->socket.get_executor(), delay);
+					timer->async_wait([conn, timer](const asio::error_code&)
+						{
+							static const std::string response = "HTTP/1.1 200 OK\r\n"
+								"Content-Length: 2\r\nConnection: close\r\n\r\nok";
+							asio::async_write(conn->socket, asio::buffer(response),
+								[conn](const asio::error_code&, size_t) {});
+						});
+				});
+			Serve(acceptor, rng);
+		});
+}
+
+size_t HeaderCb(char* buffer, size_t size, size_t nitems, std::string* headers)
+{
+	headers->append(buffer, size * nitems);
+	return size * nitems;
+}
+
+// runs the requests a few at a time, and returns each one's latency.
+// failures are added to errors
+std::vector<double> RunBatch(asio::io_context& ctx, const std::string& url,
+	std::shared_ptr<cma::HedgePolicy> hedge, size_t& errors)
+{
+	constexpr size_t requests = 400;
+	constexpr size_t concurrency = 16;
+	cma::Multi multi(ctx);
+	std::vector<cma::Easy> easies(concurrency);
+	std::vector<std::string> buffers(concurrency);
+	std::vector<std::string> headers(concurrency);
+	std::vector<double> latencies;
+	size_t started = 0;
+	// the options are shared by every request, so the hedge policy
+	// learns the latencies of all of them
+	cma::PerformOptions options;
+	options.hedge = hedge;
+	std::function<void(size_t)> launch = [&](size_t slot)
+	{
+		if (started == requests)
+			return;
+		++started;
+		buffers[slot].clear();
+		headers[slot].clear();
+		easies[slot].SetURL(url.c_str());
+		easies[slot].SetBuffer(buffers[slot]);
+		easies[slot].SetOption(CURLoption::CURLOPT_HEADERFUNCTION, &HeaderCb);
+		easies[slot].SetOption(CURLoption::CURLOPT_HEADERDATA, &headers[slot]);
+		const auto start = std::chrono::steady_clock::now();
+		multi.AsyncPerform(easies[slot], options,
+			[&, slot, start](const asio::error_code& ec)
+			{
+				if (ec)
+				{
+					std::cerr << "Error: " << ec.message() << " (" << ec << ")\n";
+					++errors;
+				}
+				// only the response that won is seen, whichever it was
+				else if (headers[slot].find("HTTP/") != 0 ||
+					headers[slot].find("HTTP/", 1) != std::string::npos)
+				{
+					std::cerr << "Error: unexpected headers\n" << headers[slot];
+					++errors;
+				}
+				latencies.push_back(std::chrono::duration<double, std::milli>(
+					std::chrono::steady_clock::now() - start).count());
+				launch(slot);
+			});
+	};
+	for (size_t slot = 0; slot < concurrency; ++slot)
+		launch(slot);
+	// run until every request has finished
+	while (latencies.size() < requests)
+		ctx.run_one();
+	// every connection is closed by the server, so none should be left
+	if (const auto openSockets = multi.GetStats().openSockets; openSockets != 0)
+	{
+		std::cerr << "Error: " << openSockets << " sockets still open\n";
+		++errors;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	return latencies;
+}
+
+void Print(const char* name, const std::vector<double>& latencies)
+{
+	const auto at = [&latencies](double p)
+	{
+		return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+	};
+	std::cout << name << ": p50 " << at(0.50) << "ms, p95 " << at(0.95)
+		<< "ms, p99 " << at(0.99) << "ms\n";
+}
+
+int main()
+{
+	asio::io_context ctx;
+	std::mt19937 rng(std::random_device{}());
+	tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+	Serve(acceptor, rng);
+	const auto url = "http://127.0.0.1:" +
+		std::to_string(acceptor.local_endpoint().port()) + "/";
+
+	size_t errors = 0;
+	Print("unhedged", RunBatch(ctx, url, nullptr, errors));
+	// hedge anything slower than 90% of requests, but never
+	// send more than 10% extra requests to the server
+	auto hedge = std::make_shared<cma::HedgePolicy>();
+	hedge->delay = std::chrono::milliseconds(20);
+	hedge->percentile = 0.9;
+	hedge->maxHedgeRatio = 0.1;
+	Print("hedged", RunBatch(ctx, url, hedge, errors));
+	std::cout << hedge->GetHedgesLaunched() << " hedges launched, "
+		<< hedge->GetHedgesWon() << " won\n";
+	return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+/*
+ *	Example11 shows a circuit breaker. It starts a local
+ *	server that stops answering partway through, and runs
+ *	the same batch of asynchronous GET calls against it with
+ *	and without a breaker, printing how much time was spent
+ *	waiting on requests that timed out. It fails unless the
+ *	breaker cuts that time down to a fraction
+ */
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using asio::ip::tcp;
+
+struct Connection
+{
+	explicit Connection(tcp::socket socket) : socket(std::move(socket)) {}
+	tcp::socket socket;
+	asio::streambuf request;
+};
+
+struct Server
+{
+	explicit Server(asio::io_context& ctx) :
+		acceptor(ctx, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0)) {}
+
+	// the server answers one request per connection. after the first
+	// 100, it holds on to every connection without ever answering
+	void Serve()
+	{
+		acceptor.async_accept([this](const asio::error_code& ec, tcp::socket socket)
+			{
+				if (ec)
+					return;
+				auto conn = std::make_shared<Connection>(std::move(socket));
+				if (++accepted > 100)
+					hung.push_back(conn);
+				else
+				{
+					asio::async_read_until(conn->socket, conn->request, "\r\n\r\n",
+						[conn](const asio::error_code& ec, size_t)
+						{
+							if (ec)
+								return;
+							static const std::string response = "HTTP/1.1 200 OK\r\n"
+								"Content-Length: 2\r\nConnection: close\r\n\r\nok";
+							asio::async_write(conn->socket, asio::buffer(response),
+								[conn](const asio::error_code&, size_t) {});
+						});
+				}
+				Serve();
+			});
+	}
+
+	tcp::acceptor acceptor;
+	size_t accepted = 0;
+	std::vector<std::shared_ptr<Connection>> hung;
+};
+
+// runs the requests a few at a time, prints how they went, and
+// returns the time spent waiting on requests that timed out
+std::chrono::steady_clock::duration RunBatch(asio::io_context& ctx, std::shared_ptr<cma::CircuitBreaker> breaker)
+{
+	constexpr size_t requests = 400;
+	constexpr size_t concurrency = 8;
+	Server server(ctx);
+	server.Serve();
+	const auto url = "http://127.0.0.1:" +
+		std::to_string(server.acceptor.local_endpoint().port()) + "/";
+	cma::Multi multi(ctx);
+	std::vector<cma::Easy> easies(concurrency);
+	size_t started = 0;
+	size_t finished = 0;
+	size_t rejected = 0;
+	size_t timedOut = 0;
+	std::chrono::steady_clock::duration wasted{};
+	cma::PerformOptions options;
+	options.breaker = breaker;
+	const auto batchStart = std::chrono::steady_clock::now();
+	std::function<void(size_t)> launch = [&](size_t slot)
+	{
+		if (started == requests)
+			return;
+		++started;
+		easies[slot].SetURL(url.c_str());
+		easies[slot].SetBuffer(cma::Easy::NullBuffer{});
+		easies[slot].SetOption(CURLoption::CURLOPT_TIMEOUT_MS, 250L);
+		const auto start = std::chrono::steady_clock::now();
+		multi.AsyncPerform(easies[slot], options,
+			[&, slot, start](const asio::error_code& ec)
+			{
+				++finished;
+				if (ec == cma::Error::CircuitOpen)
+					++rejected;
+				else if (ec)
+				{
+					++timedOut;
+					wasted += std::chrono::steady_clock::now() - start;
+				}
+				launch(slot);
+			});
+	};
+	for (size_t slot = 0; slot < concurrency; ++slot)
+		launch(slot);
+	// run until every request has finished
+	while (finished < requests)
+		ctx.run_one();
+	std::cout << ((breaker != nullptr) ? "with breaker" : "without breaker") << ": "
+		<< timedOut << " timed out, " << rejected << " failed fast, "
+		<< std::chrono::duration<double>(wasted).count() << "s spent waiting on timeouts, "
+		<< std::chrono::duration<double>(std::chrono::steady_clock::now() -
+			batchStart).count() << "s total\n";
+	return wasted;
+}
+
+int main()
+{
+	asio::io_context ctx;
+	const auto unguarded = RunBatch(ctx, nullptr);
+	// open after 3 timeouts in a row, and probe again every half second
+	auto breaker = std::make_shared<cma::CircuitBreaker>();
+	breaker->consecutiveFailures = 3;
+	breaker->openDuration = std::chrono::milliseconds(500);
+	const auto guarded = RunBatch(ctx, breaker);
+	// the breaker only lets a probe through every so often, so it
+	// should spend well under a quarter of the time on timeouts
+	if (unguarded == std::chrono::steady_clock::duration::zero() ||
+		guarded * 4 >= unguarded)
+	{
+		std::cerr << "the breaker did not save enough time\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ *	Example12 shows client-side load balancing. It starts
+ *	three local servers that answer at different speeds,
+ *	puts them behind one service name, and runs a batch of
+ *	asynchronous GET calls against the service, printing
+ *	how many requests each replica got. It fails unless the
+ *	fastest replica got the most and the slowest the fewest
+ */
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using asio::ip::tcp;
+
+struct Connection
+{
+	explicit Connection(tcp::socket socket) : socket(std::move(socket)) {}
+	tcp::socket socket;
+	asio::streambuf request;
+};
+
+// the server answers one request per connection, after a delay
+void Serve(tcp::acceptor& acceptor, std::chrono::milliseconds delay)
+{
+	acceptor.async_accept([&acceptor, delay](const asio::error_code& ec, tcp::socket socket)
+		{
+			if (ec)
+				return;
+			auto conn = std::make_shared<Connection>(std::move(socket));
+			asio::async_read_until(conn->socket, conn->request, "\r\n\r\n",
+				[conn, delay](const asio::error_code& ec, size_t)
+				{
+					if (ec)
+						return;
+					auto timer = std::make_shared<asio::steady_timer>(
+						conn->socket.get_executor(), delay);
+					timer->async_wait([conn, timer](const asio::error_code&)
+						{
+							static const std::string response = "HTTP/1.1 200 OK\r\n"
+								"Content-Length: 2\r\nConnection: close\r\n\r\nok";
+							asio::async_write(conn->socket, asio::buffer(response),
+								[conn](const asio::error_code&, size_t) {});
+						});
+				});
+			Serve(acceptor, delay);
+		});
+}
+
+int main()
+{
+	asio::io_context ctx;
+	const std::vector<std::chrono::milliseconds> delays = {
+		std::chrono::milliseconds(5), std::chrono::milliseconds(20),
+		std::chrono::milliseconds(80) };
+	std::vector<std::unique_ptr<tcp::acceptor>> acceptors;
+	std::vector<cma::EndpointSet::Endpoint> endpoints;
+	for (const auto delay : delays)
+	{
+		acceptors.push_back(std::make_unique<tcp::acceptor>(ctx,
+			tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0)));
+		Serve(*acceptors.back(), delay);
+		endpoints.push_back({ "127.0.0.1", acceptors.back()->local_endpoint().port() });
+	}
+	// the URLs name the service, which never has to resolve
+	cma::PerformOptions options;
+	options.endpoints = std::make_shared<cma::EndpointSet>("backend", 80, endpoints);
+
+	constexpr size_t requests = 600;
+	constexpr size_t concurrency = 16;
+	cma::Multi multi(ctx);
+	std::vector<cma::Easy> easies(concurrency);
+	size_t started = 0;
+	size_t finished = 0;
+	size_t failed = 0;
+	std::function<void(size_t)> launch = [&](size_t slot)
+	{
+		if (started == requests)
+			return;
+		++started;
+		easies[slot].SetURL("http://backend/");
+		easies[slot].SetBuffer(cma::Easy::NullBuffer{});
+		multi.AsyncPerform(easies[slot], options,
+			[&, slot](const asio::error_code& ec)
+			{
+				if (ec)
+				{
+					std::cerr << "Error: " << ec.message() << " (" << ec << ")\n";
+					++failed;
+				}
+				++finished;
+				launch(slot);
+			});
+	};
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t slot = 0; slot < concurrency; ++slot)
+		launch(slot);
+	while (finished < requests)
+		ctx.run_one();
+	std::cout << requests << " requests in " << std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count() << "s\n";
+	for (size_t i = 0; i < delays.size(); ++i)
+	{
+		std::cout << "replica answering in " << delays[i].count() << "ms: "
+			<< options.endpoints->GetPicks(i) << " requests, average latency "
+			<< options.endpoints->GetLatency(i).count() / 1000.0 << "ms\n";
+	}
+	// the delays go from fastest to slowest, and so should the picks
+	const auto& set = *options.endpoints;
+	if (failed != 0 || set.GetPicks(0) <= set.GetPicks(1) ||
+		set.GetPicks(1) <= set.GetPicks(2))
+	{
+		std::cerr << "the replicas were not picked by speed\n";
+		return 1;
+	}
+	return 0;
+}
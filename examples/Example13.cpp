@@ -0,0 +1,46 @@
+/*
+ *	Example13 shows lifecycle tracing. It records every
+ *	event of a few asynchronous GET requests, and prints
+ *	the trace as Chrome trace JSON, which can be saved and
+ *	opened in chrome://tracing or ui.perfetto.dev to see
+ *	where each request spent its time
+ */
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+
+#include <array>
+#include <iostream>
+#include <string>
+
+int main()
+{
+	asio::io_context ctx;
+	cma::Multi multi(ctx);
+	// the recorder keeps the most recent events in a ring buffer. it
+	// must stay alive for as long as the multi handle traces into it
+	cma::TraceRecorder recorder;
+	multi.SetTraceSink(&recorder);
+	std::array<cma::Easy, 3> easies;
+	std::array<std::string, 3> buffers;
+	const std::array<const char*, 3> urls = { "http://www.example.com/",
+		"http://www.google.com/", "http://www.example.com/" };
+	for (size_t i = 0; i < easies.size(); ++i)
+	{
+		easies[i].SetURL(urls[i]);
+		easies[i].SetBuffer(buffers[i]);
+		multi.AsyncPerform(easies[i], [i](const asio::error_code& ec)
+			{
+				if (ec)
+					std::cerr << "Error: " << ec.message() << " (" << ec << ")\n";
+				else
+					std::cerr << "Completed request " << i << "\n";
+			});
+	}
+	ctx.run();
+	// stop tracing before the recorder goes away
+	multi.SetTraceSink(nullptr);
+	recorder.WriteChromeTrace(std::cout);
+	std::cout << '\n';
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ *	Example14 is a benchmark of where cURL's memory comes
+ *	from. It makes the same batch of GET requests with cURL
+ *	using malloc directly, through the default CurlAllocator
+ *	and through the ThreadCachingAllocator, with a multi
+ *	handle per thread, and prints the requests per second
+ *	and what cURL allocated for each. Point it at a local
+ *	server, or the network will be all that is measured:
+ *	Example14 [url] [requests] [threads]
+ */
+
+#include <curl-multi-asio/CurlAllocator.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	/// @brief The requests each multi handle has going at once
+	constexpr size_t s_window = 16;
+
+	/// @brief Keeps a window of requests going on one multi handle
+	struct Worker
+	{
+		cma::Multi& multi;
+		const char* url;
+		size_t remaining;
+		std::vector<cma::Easy> easies = std::vector<cma::Easy>(s_window);
+		std::vector<std::string> buffers = std::vector<std::string>(s_window);
+
+		void Start(size_t slot)
+		{
+			if (remaining == 0)
+				return;
+			--remaining;
+			buffers[slot].clear();
+			easies[slot].SetURL(url);
+			easies[slot].SetBuffer(buffers[slot]);
+			multi.AsyncPerform(easies[slot], [this, slot](const asio::error_code& ec)
+				{
+					if (ec)
+						std::cerr << "Error: " << ec.message() << " (" << ec << ")\n";
+					Start(slot);
+				});
+		}
+	};
+
+	/// @brief Makes the requests, split between the threads
+	/// @return How long they took
+	std::chrono::duration<double> Run(const char* url, size_t requests, size_t threads)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < threads; ++i)
+		{
+			workers.emplace_back([=]
+				{
+					asio::io_context ctx;
+					cma::Multi multi(ctx);
+					Worker worker{ multi, url, requests / threads + ((i < requests % threads) ? 1 : 0) };
+					for (size_t slot = 0; slot < s_window; ++slot)
+						worker.Start(slot);
+					ctx.run();
+				});
+		}
+		for (auto& worker : workers)
+			worker.join();
+		return std::chrono::steady_clock::now() - start;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* url = (argc > 1) ? argv[1] : "http://localhost:8080/";
+	const size_t requests = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 10000;
+	const size_t threads = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) :
+		std::max(1u, std::thread::hardware_concurrency());
+	cma::CurlAllocator mallocAllocator;
+	cma::ThreadCachingAllocator cachingAllocator;
+	const struct
+	{
+		const char* name;
+		cma::CurlAllocator* allocator;
+	} runs[] = { { "cURL's malloc", nullptr }, { "CurlAllocator", &mallocAllocator },
+		{ "ThreadCachingAllocator", &cachingAllocator } };
+	for (const auto& run : runs)
+	{
+		// the allocator can only change while cURL isn't initialized, which
+		// it isn't between runs, since every handle is gone by then
+		cma::Detail::Lifetime::SetAllocator(run.allocator);
+		const auto before = cma::Detail::Lifetime::GetMemoryStats();
+		const auto elapsed = Run(url, requests, threads);
+		const auto after = cma::Detail::Lifetime::GetMemoryStats();
+		std::cout << run.name << ": " << static_cast<size_t>(requests / elapsed.count())
+			<< " requests/s, " << (after.allocations - before.allocations)
+			<< " allocations, " << (after.reallocations - before.reallocations)
+			<< " reallocations\n";
+	}
+	cma::Detail::Lifetime::SetAllocator(nullptr);
+	return 0;
+}
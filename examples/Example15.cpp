@@ -0,0 +1,104 @@
+/*
+ *	Example15 is a benchmark of submitting transfers from
+ *	many threads at once. For 1 to 64 producer threads, it
+ *	submits a batch of transfers to a single multi handle
+ *	run by one thread, once with submissions batched through
+ *	the queue and once with each of them posted to the
+ *	strand on its own, as they were before. It prints how
+ *	many per second made it onto the strand in each case.
+ *	Every transfer has a deadline that already passed, so
+ *	the strand completes it as soon as it takes it in, and
+ *	neither run pays for cURL adding the handle. The best
+ *	of a few runs is kept: Example15 [transfers] [runs]
+ */
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	/// @brief Runs the producers, each of which submits its share
+	/// @param multi The multi handle
+	/// @param easies The easy handles, one per transfer
+	/// @param producers The number of producer threads
+	/// @param errors Incremented for every transfer that didn't
+	/// complete with the deadline it was given
+	/// @return How long it took for all of them to make it
+	std::chrono::duration<double> Run(cma::Multi& multi, std::vector<cma::Easy>& easies,
+		size_t producers, size_t& errors)
+	{
+		const size_t transfers = easies.size();
+		cma::PerformOptions options;
+		options.deadline = std::chrono::steady_clock::time_point();
+		std::atomic<size_t> remaining = transfers;
+		std::atomic<size_t> failed = 0;
+		std::promise<void> done;
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < producers; ++i)
+		{
+			threads.emplace_back([&, i]
+				{
+					for (size_t transfer = i; transfer < transfers; transfer += producers)
+						multi.AsyncPerform(easies[transfer], options, [&](const asio::error_code& ec)
+							{
+								if (ec != cma::Error::DeadlineExceeded)
+									failed.fetch_add(1, std::memory_order_relaxed);
+								if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+									done.set_value();
+							});
+				});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		done.get_future().wait();
+		errors += failed.load(std::memory_order_relaxed);
+		return std::chrono::steady_clock::now() - start;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t transfers = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 20000;
+	const size_t runs = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 5;
+	asio::io_context ctx;
+	auto work = asio::make_work_guard(ctx);
+	cma::Multi multi(ctx);
+	std::thread loop([&] { ctx.run(); });
+
+	std::vector<cma::Easy> easies(transfers);
+	for (auto& easy : easies)
+		easy.SetURL("file:///dev/null");
+	size_t errors = 0;
+	for (size_t producers = 1; producers <= 64; producers *= 2)
+	{
+		std::chrono::duration<double> posted = std::chrono::hours(1);
+		std::chrono::duration<double> batched = std::chrono::hours(1);
+		// interleaved, so that both see the same machine
+		for (size_t run = 0; run < runs; ++run)
+		{
+			multi.SetSubmissionBatching(false);
+			posted = std::min(posted, Run(multi, easies, producers, errors));
+			multi.SetSubmissionBatching(true);
+			batched = std::min(batched, Run(multi, easies, producers, errors));
+		}
+		std::cout << producers << " producers: " << static_cast<size_t>(transfers / batched.count())
+			<< " batched/s, " << static_cast<size_t>(transfers / posted.count())
+			<< " posted/s, " << posted / batched << "x\n";
+	}
+	if (errors != 0)
+		std::cerr << "Error: " << errors << " transfers didn't miss their deadline\n";
+	work.reset();
+	loop.join();
+	return (errors == 0) ? 0 : 1;
+}
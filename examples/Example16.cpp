@@ -0,0 +1,85 @@
+/*
+ *	Example16 streams the results of a large batch of GET
+ *	requests. It performs the batch through a TransferStream,
+ *	once in completion order and once in submission order,
+ *	and receives the results one at a time. The window keeps
+ *	only so many requests going at once, however many there
+ *	are in the batch. Point it at a local server, or the
+ *	network will be all that is measured:
+ *	Example16 [url] [requests] [window]
+ */
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+#include <curl-multi-asio/TransferStream.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	/// @brief Receives every result of a stream, and checks their order
+	struct Consumer
+	{
+		std::shared_ptr<cma::TransferStream> stream;
+		cma::StreamOrder order;
+		size_t received = 0;
+		size_t failed = 0;
+		size_t outOfOrder = 0;
+
+		void Receive()
+		{
+			stream->AsyncReceive([this](const asio::error_code& ec, size_t index,
+				const asio::error_code& result)
+				{
+					if (ec)
+					{
+						if (ec != asio::error::eof)
+							std::cerr << "Error: " << ec.message() << " (" << ec << ")\n";
+						return;
+					}
+					if (result)
+						++failed;
+					if (order == cma::StreamOrder::Submission && index != received)
+						++outOfOrder;
+					++received;
+					Receive();
+				});
+		}
+	};
+}
+
+int main(int argc, char** argv)
+{
+	const char* url = (argc > 1) ? argv[1] : "http://localhost:8080/";
+	const size_t requests = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 10000;
+	const size_t window = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 64;
+	std::vector<cma::Easy> easies(requests);
+	std::vector<std::string> buffers(requests);
+	for (size_t i = 0; i < requests; ++i)
+	{
+		easies[i].SetURL(url);
+		easies[i].SetBuffer(buffers[i]);
+	}
+	for (auto order : { cma::StreamOrder::Completion, cma::StreamOrder::Submission })
+	{
+		asio::io_context ctx;
+		cma::Multi multi(ctx);
+		Consumer consumer{ std::make_shared<cma::TransferStream>(multi, easies, window, order),
+			order };
+		const auto start = std::chrono::steady_clock::now();
+		consumer.stream->Start();
+		consumer.Receive();
+		ctx.run();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << ((order == cma::StreamOrder::Completion) ? "Completion" : "Submission")
+			<< " order: " << consumer.received << " results, " << consumer.failed << " failed, "
+			<< consumer.outOfOrder << " out of order, "
+			<< static_cast<size_t>(consumer.received / elapsed.count()) << " results/s\n";
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ *	Example17 runs a small graph of dependent requests.
+ *	It fetches a page, then fetches three more in parallel
+ *	once it has, and finally fetches one more with the
+ *	sizes of all three in its query string. Several copies
+ *	of the graph run on the same multi handle at once
+ */
+
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Multi.h>
+#include <curl-multi-asio/RequestGraph.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace
+{
+	using Inputs = std::span<const cma::RequestGraph::Result>;
+
+	/// @brief Builds a copy of the graph
+	/// @param multi The multi handle
+	/// @return The graph
+	std::shared_ptr<cma::RequestGraph> MakeGraph(cma::Multi& multi)
+	{
+		auto graph = std::make_shared<cma::RequestGraph>(multi);
+		const auto first = *graph->AddNode([](cma::Easy& easy, Inputs)
+			{
+				return easy.SetURL("http://www.example.com/");
+			});
+		const auto a = *graph->AddNode([](cma::Easy& easy, Inputs)
+			{
+				return easy.SetURL("http://www.example.com/a");
+			}, { first });
+		const auto b = *graph->AddNode([](cma::Easy& easy, Inputs)
+			{
+				return easy.SetURL("http://www.example.com/b");
+			}, { first });
+		const auto c = *graph->AddNode([](cma::Easy& easy, Inputs)
+			{
+				return easy.SetURL("http://www.example.com/c");
+			}, { first });
+		graph->AddNode([](cma::Easy& easy, Inputs inputs)
+			{
+				std::string url = "http://www.example.com/?sizes=";
+				for (const auto& input : inputs)
+					url += std::to_string(input.body.size()) + ',';
+				return easy.SetURL(url.c_str());
+			}, { a, b, c });
+		return graph;
+	}
+}
+
+int main()
+{
+	asio::io_context ctx;
+	cma::Multi multi(ctx);
+	for (int i = 0; i < 4; ++i)
+	{
+		auto graph = MakeGraph(multi);
+		graph->AsyncRun([i, graph](const asio::error_code& ec)
+			{
+				if (ec)
+					std::cerr << "Graph " << i << " failed: " << ec.message() << " (" << ec << ")\n";
+				else
+					std::cout << "Graph " << i << " got " << graph->GetResult(4).body.size()
+						<< " bytes at the end\n";
+			});
+	}
+	ctx.run();
+	return 0;
+}
@@ -0,0 +1,139 @@
+#ifndef CURLMULTIASIO_CIRCUITBREAKER_H_
+#define CURLMULTIASIO_CIRCUITBREAKER_H_
+
+/// @file
+/// Per-Origin Circuit Breaker
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Detail/StringHash.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cma
+{
+	/// @brief Tracks the health of each origin a transfer goes to, and ejects
+	/// origins that are failing. An origin's circuit opens after too many
+	/// failures in a row, or too high a failure rate over its recent calls.
+	/// While it is open, transfers to it fail right away with
+	/// Error::CircuitOpen instead of waiting on a backend that won't answer.
+	/// Once the open duration is up the circuit is half-open, and a few probe
+	/// transfers are let through. If they succeed, the circuit closes again,
+	/// and if one fails, it opens for twice as long as the last time. Errors,
+	/// 5xx statuses and calls slower than the slow call threshold count as
+	/// failures. A breaker is thread safe, and is meant to be shared by every
+	/// transfer that should be cut off together
+	class CircuitBreaker
+	{
+	public:
+		enum class State
+		{
+			Closed,
+			Open,
+			HalfOpen
+		};
+
+		/// @brief The failures in a row that open the circuit, or 0 for no limit
+		unsigned consecutiveFailures = 5;
+		/// @brief The failure rate over the window that opens the circuit.
+		/// Above 1, the failure rate is ignored
+		double failureRate = 0.5;
+		/// @brief The number of recent calls the failure rate is taken over.
+		/// The rate isn't used until the window is full
+		size_t window = 20;
+		/// @brief Successful calls slower than this count as failures.
+		/// 0 turns this off
+		std::chrono::milliseconds slowCallThreshold{ 0 };
+		/// @brief How long the circuit stays open the first time
+		std::chrono::milliseconds openDuration{ 5000 };
+		/// @brief How long the circuit stays open at most, after failed probes
+		std::chrono::milliseconds maxOpenDuration{ 60000 };
+		/// @brief The probe transfers let through while half-open, all of
+		/// which must succeed for the circuit to close
+		unsigned halfOpenProbes = 1;
+
+		CircuitBreaker() noexcept = default;
+		CircuitBreaker(const CircuitBreaker&) = delete;
+		CircuitBreaker& operator=(const CircuitBreaker&) = delete;
+
+		/// @brief Decides whether a transfer to an origin may start. An open
+		/// circuit whose time is up becomes half-open here
+		/// @param origin The origin
+		/// @return Whether or not the transfer may start
+		bool Allow(std::string_view origin) noexcept;
+		/// @brief Records the outcome of a transfer that was allowed
+		/// @param origin The origin
+		/// @param failed Whether or not it failed
+		void Record(std::string_view origin, bool failed) noexcept;
+		/// @brief Gives back a transfer that was allowed, but ended without an
+		/// outcome, such as one that was cancelled
+		/// @param origin The origin
+		void Release(std::string_view origin) noexcept;
+		/// @param ec The result of the transfer
+		/// @param status The HTTP status of the transfer
+		/// @param latency How long the transfer took
+		/// @return Whether or not the transfer counts as a failure
+		bool IsFailure(const error_code& ec, long status,
+			std::chrono::steady_clock::duration latency) const noexcept;
+
+		/// @param origin The origin
+		/// @return The state of the origin's circuit
+		State GetState(std::string_view origin) const noexcept;
+		/// @return The number of transfers that failed fast on an open circuit
+		inline size_t GetRejected() const noexcept
+		{
+			return m_rejected.load(std::memory_order_relaxed);
+		}
+		/// @brief Gets the origin of a URL, which is its scheme, host and port
+		/// @param url The URL
+		/// @return The origin, or an empty string if the URL couldn't be parsed
+		static std::string GetOrigin(const char* url) noexcept;
+		/// @brief Gets the origin of a URL into a string that may allocate
+		/// from somewhere other than the heap, such as a transfer's arena
+		/// @param url The URL
+		/// @param origin The origin, or an empty string if the URL couldn't
+		/// be parsed
+		static void GetOrigin(const char* url, std::pmr::string& origin) noexcept;
+	private:
+		struct Origin
+		{
+			State state = State::Closed;
+			unsigned consecutive = 0;
+			/// @brief The recent outcomes as a ring, 1 for a failure
+			std::vector<uint8_t> outcomes;
+			size_t next = 0;
+			size_t recorded = 0;
+			size_t failures = 0;
+			/// @brief When an open circuit becomes half-open
+			std::chrono::steady_clock::time_point openUntil;
+			/// @brief The times in a row the circuit opened, which
+			/// lengthens each opening
+			unsigned ejections = 0;
+			unsigned probes = 0;
+			unsigned probeSuccesses = 0;
+		};
+
+		/// @brief Opens a circuit
+		/// @param origin The origin's state
+		void Open(Origin& origin) noexcept;
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<std::string, Origin, Detail::StringHash, std::equal_to<>> m_origins;
+		std::atomic<size_t> m_rejected = 0;
+	};
+}
+
+#endif
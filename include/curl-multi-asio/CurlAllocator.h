@@ -0,0 +1,73 @@
+#ifndef CURLMULTIASIO_CURLALLOCATOR_H_
+#define CURLMULTIASIO_CURLALLOCATOR_H_
+
+/// @file
+/// cURL Memory Allocators
+/// 10/17/26
+
+// STL includes
+#include <cstddef>
+#include <cstdint>
+
+namespace cma
+{
+	/// @brief Where cURL's own allocations come from, once it is installed
+	/// with Detail::Lifetime::SetAllocator. Unlike malloc, the size of a
+	/// block is always given back when it is freed. This one uses malloc,
+	/// and it can be overridden to use something else
+	class CurlAllocator
+	{
+	public:
+		virtual ~CurlAllocator() = default;
+
+		/// @param size The size of the block
+		/// @return The block, aligned like malloc's, or nullptr
+		virtual void* Allocate(size_t size) noexcept;
+		/// @param block A block from Allocate or Reallocate
+		/// @param size The size it was allocated with
+		virtual void Deallocate(void* block, size_t size) noexcept;
+		/// @brief Resizes a block, moving it if it has to. By default,
+		/// this allocates a new block and copies the old one over
+		/// @param block A block from Allocate or Reallocate
+		/// @param size The size it was allocated with
+		/// @param newSize The size it should have
+		/// @return The block, or nullptr if it couldn't be resized, in
+		/// which case the old one is untouched
+		virtual void* Reallocate(void* block, size_t size, size_t newSize) noexcept;
+	};
+
+	/// @brief A CurlAllocator that keeps blocks of up to 4KiB freed by each
+	/// thread in a cache for that thread, by powers of two, so that the
+	/// small allocations cURL makes by the thousand, like headers and
+	/// slists, don't contend on the global heap. Larger blocks go to malloc
+	class ThreadCachingAllocator : public CurlAllocator
+	{
+	public:
+		/// @param cachedPerClass The most blocks of each size each
+		/// thread keeps. Blocks freed past that go back to malloc
+		explicit ThreadCachingAllocator(size_t cachedPerClass = 256) noexcept :
+			m_cachedPerClass(cachedPerClass) {}
+
+		void* Allocate(size_t size) noexcept override;
+		void Deallocate(void* block, size_t size) noexcept override;
+		void* Reallocate(void* block, size_t size, size_t newSize) noexcept override;
+	private:
+		size_t m_cachedPerClass;
+	};
+
+	/// @brief What cURL has allocated through the installed CurlAllocator,
+	/// see Detail::Lifetime::GetMemoryStats
+	struct CurlMemoryStats
+	{
+		/// @brief The bytes cURL holds right now
+		uint64_t liveBytes = 0;
+		/// @brief The blocks cURL holds right now
+		uint64_t liveAllocations = 0;
+		/// @brief The blocks ever allocated, strdup and calloc included
+		uint64_t allocations = 0;
+		/// @brief The blocks ever resized
+		uint64_t reallocations = 0;
+	};
+}
+
+#endif
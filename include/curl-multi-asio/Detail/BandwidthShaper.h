@@ -0,0 +1,144 @@
+#ifndef CURLMULTIASIO_DETAIL_BANDWIDTHSHAPER_H_
+#define CURLMULTIASIO_DETAIL_BANDWIDTHSHAPER_H_
+
+/// @file
+/// Aggregate Bandwidth Shaper
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <chrono>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace cma
+{
+	/// @brief A byte rate shared by every transfer of a Multi. A
+	/// rate of 0 leaves that direction unlimited
+	struct BandwidthLimit
+	{
+		/// @brief The total download rate in bytes per second
+		curl_off_t recvBytesPerSecond = 0;
+		/// @brief The total upload rate in bytes per second
+		curl_off_t sendBytesPerSecond = 0;
+		/// @brief How often the budget is handed out. Shorter intervals
+		/// are smoother, longer intervals pause and unpause less often
+		std::chrono::milliseconds interval{ 100 };
+
+		/// @return Whether or not either direction is limited
+		inline bool Enabled() const noexcept
+		{
+			return recvBytesPerSecond > 0 || sendBytesPerSecond > 0;
+		}
+	};
+
+	namespace Detail
+	{
+		class BandwidthShaper;
+
+		/// @brief The shaping state of a single transfer. It lives inside
+		/// of the transfer's handler so no allocation is needed to track it
+		struct ShapedTransfer
+		{
+			/// @brief The accounting for one direction of the transfer
+			struct Direction
+			{
+				/// @brief The last byte count reported by cURL
+				curl_off_t last = 0;
+				/// @brief The bytes the transfer may still move this interval.
+				/// It goes negative when cURL delivers more than was granted
+				curl_off_t credit = 0;
+				/// @brief The bytes moved since the last interval
+				curl_off_t used = 0;
+				/// @brief Whether the transfer ran out of credit this interval
+				bool throttled = false;
+			};
+
+			BandwidthShaper* shaper = nullptr;
+			CURL* easy = nullptr;
+			double weight = 1.0;
+			Direction recv;
+			Direction send;
+			/// @brief The CURLPAUSE_* bits currently applied to the handle
+			int pausedMask = 0;
+			/// @brief Whether or not the transfer is tracked by the shaper
+			bool active = false;
+			/// @brief The position in the shaper, for O(1) removal
+			size_t index = 0;
+		};
+
+		/// @brief Apportions an aggregate byte rate across a set of transfers
+		/// by their weights, and enforces it by pausing transfers that have
+		/// used up their share and unpausing them when the next interval's
+		/// budget is handed out. Budget that a transfer can't use is given to
+		/// the others. It has no synchronization of its own, and must only be
+		/// used from the Multi's strand.
+		class BandwidthShaper
+		{
+		public:
+			/// @brief Sets the limit. Disabling a direction unpauses every
+			/// transfer paused in that direction
+			/// @param limit The limit
+			void SetLimit(const BandwidthLimit& limit) noexcept;
+			/// @return The current limit
+			inline const BandwidthLimit& GetLimit() const noexcept { return m_limit; }
+			/// @return Whether or not any direction is limited
+			inline bool Enabled() const noexcept { return m_limit.Enabled(); }
+			/// @return Whether or not there are no shaped transfers
+			inline bool Empty() const noexcept { return m_transfers.empty(); }
+
+			/// @brief Starts shaping a transfer by installing a progress
+			/// callback on its handle, which replaces any set by the user.
+			/// It is given an even share of the current interval so that
+			/// it doesn't stall until the next one
+			/// @param transfer The transfer
+			/// @param easy The easy handle of the transfer
+			/// @param weight The weight of the transfer
+			void Add(ShapedTransfer& transfer, CURL* easy, double weight) noexcept;
+			/// @brief Stops shaping a transfer, unpauses it, and clears the
+			/// progress callback and turns progress off, so the handle can be
+			/// reused anywhere. cURL can't tell what was set before, so the
+			/// user's own callback isn't put back
+			/// @param transfer The transfer
+			void Remove(ShapedTransfer& transfer) noexcept;
+			/// @brief Charges a transfer for the bytes it moved since the
+			/// last report, and pauses it if it ran out of credit
+			/// @param transfer The transfer
+			/// @param dlnow The total bytes downloaded
+			/// @param ulnow The total bytes uploaded
+			void OnProgress(ShapedTransfer& transfer, curl_off_t dlnow,
+				curl_off_t ulnow) noexcept;
+			/// @brief Hands out the next interval's budget, and unpauses
+			/// any transfers that have credit again
+			void Tick() noexcept;
+		private:
+			/// @brief The progress callback installed on shaped handles. For
+			/// a description of arguments, check cURL documentation for
+			/// CURLOPT_XFERINFOFUNCTION
+			/// @return 0 to continue the transfer
+			static int XferInfoCb(ShapedTransfer* clientp, curl_off_t dltotal,
+				curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) noexcept;
+			/// @brief Divides the interval's budget for a direction across all
+			/// of the transfers by weight, capped by what each can use
+			/// @param direction The direction member
+			/// @param bytesPerSecond The rate of the direction
+			/// @param pauseBit The CURLPAUSE_* bit of the direction
+			void Apportion(ShapedTransfer::Direction ShapedTransfer::* direction,
+				curl_off_t bytesPerSecond, int pauseBit) noexcept;
+			/// @brief Applies the pause mask of a transfer to its handle
+			/// @param transfer The transfer
+			/// @param mask The new mask
+			static void ApplyPause(ShapedTransfer& transfer, int mask) noexcept;
+
+			BandwidthLimit m_limit;
+			std::vector<ShapedTransfer*> m_transfers;
+			// scratch space for Apportion, kept to avoid reallocating every tick
+			std::vector<std::pair<double, ShapedTransfer*>> m_demand;
+		};
+	}
+}
+
+#endif
@@ -51,6 +51,20 @@ namespace cma
 				return s_instance;
 			}
 		};
+		/// @brief A category for the errors of the library itself
+		struct CMAErrCategory : error_category
+		{
+			const char* name() const noexcept override
+			{
+				return "curl-multi-asio";
+			}
+			std::string message(int ev) const override;
+			static const CMAErrCategory& Instance() noexcept
+			{
+				static const CMAErrCategory s_instance;
+				return s_instance;
+			}
+		};
 	}
 }
 
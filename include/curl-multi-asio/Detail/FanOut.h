@@ -0,0 +1,167 @@
+#ifndef CURLMULTIASIO_DETAIL_FANOUT_H_
+#define CURLMULTIASIO_DETAIL_FANOUT_H_
+
+/// @file
+/// Fan-out Operation State
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace cma
+{
+	class RequestGroup;
+
+	namespace Detail
+	{
+		/// @brief The state shared by every transfer of a fan-out. It counts
+		/// the transfers as they complete, cancels the ones left once the
+		/// outcome is settled, and finishes once the last of them completes,
+		/// so that the easy handles are free again by the time the handler
+		/// is called. It deletes itself after that. Transfers may complete
+		/// on different threads, so everything they share is atomic
+		class FanOutBase
+		{
+		public:
+			/// @brief What the first success is when there is none
+			static constexpr size_t s_none = std::numeric_limits<size_t>::max();
+
+			/// @param transfers The number of transfers
+			/// @param needed The number of them that have to succeed
+			/// @param cutShort Whether the transfers left are cancelled
+			/// once enough have succeeded, or too many have failed
+			FanOutBase(size_t transfers, size_t needed, bool cutShort) :
+				m_results(transfers), m_remaining(transfers + 1), m_needed(needed),
+				m_cutShort(cutShort) {}
+			FanOutBase(const FanOutBase&) = delete;
+			FanOutBase& operator=(const FanOutBase&) = delete;
+			virtual ~FanOutBase() = default;
+
+			/// @return Whether the transfers left are cancelled once the
+			/// outcome is settled
+			inline bool CutsShort() const noexcept { return m_cutShort; }
+			/// @param group The group that cancels the transfers left
+			inline void SetGroup(std::shared_ptr<RequestGroup> group) noexcept
+			{
+				m_group = std::move(group);
+			}
+			/// @brief Records the result of a transfer
+			/// @param index The index of the transfer
+			/// @param ec The error code it completed with
+			void Complete(size_t index, const error_code& ec) noexcept;
+			/// @brief Lets go of a reference. The fan-out holds one on
+			/// itself until every transfer was submitted, and each
+			/// transfer holds one until it completes
+			void Release() noexcept;
+		protected:
+			/// @brief Calls the handler
+			/// @param results The error code of each transfer
+			/// @param succeeded The number of transfers that succeeded
+			/// @param first The index of the first transfer to succeed,
+			/// or s_none
+			virtual void Finish(std::vector<error_code> results,
+				size_t succeeded, size_t first) noexcept = 0;
+		private:
+			std::vector<error_code> m_results;
+			std::atomic<size_t> m_remaining;
+			std::atomic<size_t> m_succeeded = 0;
+			std::atomic<size_t> m_failed = 0;
+			std::atomic<size_t> m_first = s_none;
+			size_t m_needed;
+			bool m_cutShort;
+			std::shared_ptr<RequestGroup> m_group;
+		};
+
+		/// @brief The completion handler of a single transfer of a fan-out.
+		/// It is all each transfer adds to the shared state
+		struct FanOutChild
+		{
+			FanOutBase* fanOut;
+			size_t index;
+
+			void operator()(const error_code& ec) const noexcept
+			{
+				fanOut->Complete(index, ec);
+			}
+		};
+
+		/// @brief A fan-out that completes with the error code of every
+		/// transfer, and the first of them that failed
+		template<typename Handler>
+		class FanOutAll : public FanOutBase
+		{
+		public:
+			FanOutAll(Handler& handler, size_t transfers) :
+				FanOutBase(transfers, transfers, false), m_handler(std::move(handler)) {}
+		protected:
+			void Finish(std::vector<error_code> results, size_t, size_t) noexcept override
+			{
+				error_code ec;
+				for (const auto& result : results)
+				{
+					if (result)
+					{
+						ec = result;
+						break;
+					}
+				}
+				m_handler(ec, std::move(results));
+			}
+		private:
+			Handler m_handler;
+		};
+
+		/// @brief A fan-out that completes with the index of the first
+		/// transfer to succeed
+		template<typename Handler>
+		class FanOutAny : public FanOutBase
+		{
+		public:
+			FanOutAny(Handler& handler, size_t transfers) :
+				FanOutBase(transfers, 1, true), m_handler(std::move(handler)) {}
+		protected:
+			void Finish(std::vector<error_code> results, size_t succeeded,
+				size_t first) noexcept override
+			{
+				if (succeeded == 0)
+					return m_handler(Error::QuorumNotReached, results.size());
+				m_handler(error_code(), first);
+			}
+		private:
+			Handler m_handler;
+		};
+
+		/// @brief A fan-out that completes once enough of its transfers
+		/// succeeded, with the error code of every transfer
+		template<typename Handler>
+		class FanOutQuorum : public FanOutBase
+		{
+		public:
+			FanOutQuorum(Handler& handler, size_t transfers, size_t needed) :
+				FanOutBase(transfers, needed, true), m_handler(std::move(handler)),
+				m_needed(needed) {}
+		protected:
+			void Finish(std::vector<error_code> results, size_t succeeded,
+				size_t) noexcept override
+			{
+				const auto ec = (succeeded >= m_needed) ? error_code() :
+					error_code(Error::QuorumNotReached);
+				m_handler(ec, std::move(results));
+			}
+		private:
+			Handler m_handler;
+			size_t m_needed;
+		};
+	}
+}
+
+#endif
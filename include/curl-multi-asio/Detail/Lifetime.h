@@ -7,6 +7,7 @@
 
 // curl-multi-asio includes
 #include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/CurlAllocator.h>
 
 // STL includes
 #include <atomic>
@@ -30,6 +31,20 @@ namespace cma
 			Lifetime& operator=(const Lifetime&) = default;
 			Lifetime(Lifetime&&) noexcept;
 			Lifetime& operator=(Lifetime&&) = default;
+
+			/// @brief Routes cURL's allocations through an allocator, with
+			/// curl_global_init_mem, and keeps statistics on them. It can
+			/// only be set while cURL isn't initialized, that is before the
+			/// first Lifetime is created or after the last one is destroyed,
+			/// and not at the same time as either. The allocator must stay
+			/// alive until the last Lifetime after it is destroyed
+			/// @param allocator The allocator, or nullptr for cURL's own
+			/// @return Whether or not it was set
+			static bool SetAllocator(CurlAllocator* allocator) noexcept;
+			/// @brief Gets what cURL has allocated through the allocator,
+			/// which is nothing without one. This can be called from any thread
+			/// @return The statistics
+			static CurlMemoryStats GetMemoryStats() noexcept;
 		private:
 			static std::atomic_size_t s_refCount;
 		};
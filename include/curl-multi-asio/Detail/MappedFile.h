@@ -0,0 +1,53 @@
+#ifndef CURLMULTIASIO_DETAIL_MAPPEDFILE_H_
+#define CURLMULTIASIO_DETAIL_MAPPEDFILE_H_
+
+/// @file
+/// Read-Only File Mapping
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief A whole file mapped read-only into memory. The mapping covers
+		/// the file as it was when it was mapped, anything appended later needs
+		/// another mapping
+		class MappedFile
+		{
+		public:
+			MappedFile() noexcept = default;
+			~MappedFile() noexcept;
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			/// @brief Maps a file, unmapping whatever was mapped before
+			/// @param path The path of the file
+			/// @return The error, if any
+			error_code Map(const std::filesystem::path& path) noexcept;
+			/// @brief Unmaps the file
+			void Unmap() noexcept;
+
+			/// @return The mapped bytes
+			inline std::string_view GetView() const noexcept
+			{
+				return std::string_view(m_data, m_size);
+			}
+			/// @return The number of mapped bytes
+			inline size_t GetSize() const noexcept { return m_size; }
+		private:
+			const char* m_data = nullptr;
+			size_t m_size = 0;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CURLMULTIASIO_DETAIL_PROBES_H_
+#define CURLMULTIASIO_DETAIL_PROBES_H_
+
+/// @file
+/// USDT Probes
+/// 10/17/26
+
+// when the library is built with CMA_USDT_PROBES, these are static probes
+// under the "cma" provider, which perf and bpftrace can attach to. a probe
+// is a single nop until something attaches. otherwise they're nothing at
+// all, and their arguments aren't evaluated
+#if CMA_USDT_PROBES
+#include <sys/sdt.h>
+
+#define CMA_PROBE1(name, a) DTRACE_PROBE1(cma, name, a)
+#define CMA_PROBE2(name, a, b) DTRACE_PROBE2(cma, name, a, b)
+#define CMA_PROBE3(name, a, b, c) DTRACE_PROBE3(cma, name, a, b, c)
+#define CMA_PROBE4(name, a, b, c, d) DTRACE_PROBE4(cma, name, a, b, c, d)
+#else
+#define CMA_PROBE1(name, a) do {} while (false)
+#define CMA_PROBE2(name, a, b) do {} while (false)
+#define CMA_PROBE3(name, a, b, c) do {} while (false)
+#define CMA_PROBE4(name, a, b, c, d) do {} while (false)
+#endif
+
+#endif
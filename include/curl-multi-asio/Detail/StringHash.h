@@ -0,0 +1,31 @@
+#ifndef CURLMULTIASIO_DETAIL_STRINGHASH_H_
+#define CURLMULTIASIO_DETAIL_STRINGHASH_H_
+
+/// @file
+/// Transparent String Hash
+/// 10/17/26
+
+// STL includes
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief Hashes strings of any kind as string views, so that maps
+		/// keyed by std::string can be searched without making one
+		struct StringHash
+		{
+			using is_transparent = void;
+
+			inline size_t operator()(std::string_view key) const noexcept
+			{
+				return std::hash<std::string_view>{}(key);
+			}
+		};
+	}
+}
+
+#endif
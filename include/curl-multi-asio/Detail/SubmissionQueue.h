@@ -0,0 +1,53 @@
+#ifndef CURLMULTIASIO_DETAIL_SUBMISSIONQUEUE_H_
+#define CURLMULTIASIO_DETAIL_SUBMISSIONQUEUE_H_
+
+/// @file
+/// Lock-free Submission Queue
+/// 10/17/26
+
+// STL includes
+#include <atomic>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief Something waiting in a SubmissionQueue. Nodes are
+		/// intrusive, they are embedded in whatever is being submitted
+		struct SubmissionNode
+		{
+			SubmissionNode* next = nullptr;
+		};
+
+		/// @brief A lock-free queue with any number of producers and a
+		/// single consumer. Producers push nodes one at a time with a single
+		/// compare and swap, and the consumer takes everything pushed so far
+		/// at once, so it is never contended by more than one producer per
+		/// push, and never by the consumer more than once per batch
+		class SubmissionQueue
+		{
+		public:
+			SubmissionQueue() noexcept = default;
+			SubmissionQueue(const SubmissionQueue&) = delete;
+			SubmissionQueue& operator=(const SubmissionQueue&) = delete;
+
+			/// @brief Pushes a node, which may be from any thread
+			/// @param node The node, which belongs to the queue until it is
+			/// taken out again
+			/// @return Whether the queue was empty. Only the push that makes
+			/// it not empty sees this, and it is the one that should wake
+			/// the consumer up
+			bool Push(SubmissionNode* node) noexcept;
+			/// @brief Takes every node pushed so far. Only one thread may
+			/// do this at a time
+			/// @return The first node, linked to the rest in the order they
+			/// were pushed, or nullptr if there are none
+			SubmissionNode* Drain() noexcept;
+		private:
+			/// @brief The last node pushed, linked to the ones before it
+			std::atomic<SubmissionNode*> m_head = nullptr;
+		};
+	}
+}
+
+#endif
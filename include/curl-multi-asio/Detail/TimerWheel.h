@@ -0,0 +1,125 @@
+#ifndef CURLMULTIASIO_DETAIL_TIMERWHEEL_H_
+#define CURLMULTIASIO_DETAIL_TIMERWHEEL_H_
+
+/// @file
+/// Hierarchical Timer Wheel
+/// 10/17/26
+
+// STL includes
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief A timer that can be scheduled on a TimerWheel. Nodes are
+		/// intrusive, they are embedded in whatever state owns the timer so
+		/// that scheduling never allocates. A node must not be destroyed or
+		/// moved while it is scheduled
+		struct TimerNode
+		{
+			/// @brief The function called when the timer expires
+			void (*callback)(void* context) noexcept = nullptr;
+			/// @brief The argument passed to the callback
+			void* context = nullptr;
+
+			/// @return Whether or not the timer is scheduled
+			inline bool Scheduled() const noexcept { return slot != nullptr; }
+
+			TimerNode* prev = nullptr;
+			TimerNode* next = nullptr;
+			TimerNode** slot = nullptr;
+			/// @brief The tick the node expires on
+			uint64_t expiry = 0;
+		};
+
+		/// @brief A hierarchical timer wheel. Each level has 64 slots, and
+		/// each slot of a level spans a whole revolution of the level below
+		/// it, so the wheel covers any delay with a fixed number of slots.
+		/// Nodes sit in the lowest level that tells them apart from the
+		/// current tick, and move down a level when the slot they are in comes
+		/// up. Scheduling and cancelling are O(1), and a node is touched at
+		/// most once per level before it expires. Many timers can be driven by
+		/// a single asio timer waiting on NextExpiry. Resolution is one tick,
+		/// timers never fire early but may fire up to a tick late. It has no
+		/// synchronization of its own.
+		class TimerWheel
+		{
+		public:
+			using clock = std::chrono::steady_clock;
+
+			/// @param tick The resolution of the wheel
+			explicit TimerWheel(clock::duration tick = std::chrono::milliseconds(1)) noexcept;
+			TimerWheel(const TimerWheel&) = delete;
+			TimerWheel& operator=(const TimerWheel&) = delete;
+			TimerWheel(TimerWheel&&) = default;
+			TimerWheel& operator=(TimerWheel&&) = default;
+
+			/// @brief Schedules a node, rescheduling it if it already is
+			/// @param node The node
+			/// @param delay How long from now the node should expire
+			/// @param now The current time
+			void Schedule(TimerNode& node, clock::duration delay,
+				clock::time_point now = clock::now()) noexcept;
+			/// @brief Unschedules a node. Does nothing if it isn't scheduled
+			/// @param node The node
+			void Cancel(TimerNode& node) noexcept;
+			/// @brief Expires every node that is due, calling their callbacks.
+			/// Callbacks may schedule and cancel nodes
+			/// @param now The current time
+			/// @return The number of nodes expired
+			size_t Advance(clock::time_point now = clock::now()) noexcept;
+			/// @return The time at which the wheel next has to advance, if any
+			/// nodes are scheduled. That is either when the next node is due,
+			/// or when nodes further out have to move down a level
+			std::optional<clock::time_point> NextExpiry() const noexcept;
+
+			/// @return The number of nodes scheduled
+			inline size_t Size() const noexcept { return m_size; }
+			/// @return Whether or not no nodes are scheduled
+			inline bool Empty() const noexcept { return m_size == 0; }
+		private:
+			static constexpr unsigned s_slotBits = 6;
+			static constexpr size_t s_slots = size_t(1) << s_slotBits;
+			/// @brief Enough levels to cover every 64-bit tick
+			static constexpr size_t s_levels = (64 + s_slotBits - 1) / s_slotBits;
+
+			/// @param time A time
+			/// @return The tick that time falls in
+			uint64_t TickOf(clock::time_point time) const noexcept;
+			/// @return The next tick on which a node expires or moves
+			/// down a level, if any
+			std::optional<uint64_t> NextTick() const noexcept;
+			/// @brief Inserts a node into the slot for its expiry
+			/// @param node The node
+			void Link(TimerNode& node) noexcept;
+			/// @brief Takes every node out of a slot
+			/// @param level The level
+			/// @param index The slot in the level
+			/// @return The nodes, still linked to each other
+			TimerNode* Take(size_t level, size_t index) noexcept;
+			/// @brief Clears a slot's occupied bit if it emptied
+			/// @param slot The slot, which may be outside of the wheel
+			void Vacate(TimerNode** slot) noexcept;
+
+			clock::duration m_tick;
+			/// @brief The time of tick 0
+			clock::time_point m_origin;
+			/// @brief The last tick that was expired
+			uint64_t m_now = 0;
+			/// @brief Every level's slots, lowest level first. They are on the
+			/// heap so that moving the wheel doesn't move them
+			std::vector<TimerNode*> m_slots;
+			/// @brief A bit per slot of each level, set when it has nodes
+			std::array<uint64_t, s_levels> m_occupied{};
+			size_t m_size = 0;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef CURLMULTIASIO_DETAIL_TIMINGRECORDER_H_
+#define CURLMULTIASIO_DETAIL_TIMINGRECORDER_H_
+
+/// @file
+/// Transfer Timing Recorder
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/LatencyHistogram.h>
+
+// STL includes
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief Records the timing breakdown of completed transfers into
+		/// histograms, for all of them and for each origin. Only one thread
+		/// may record at a time, which for a Multi is whichever is running
+		/// its strand, but snapshots may be taken from any thread. Origins
+		/// are found without locking, in a table they are published to once
+		/// and never leave
+		class TimingRecorder
+		{
+		public:
+			/// @brief The histograms of each phase
+			struct Histograms
+			{
+				LatencyHistogram nameLookup;
+				LatencyHistogram connect;
+				LatencyHistogram appConnect;
+				LatencyHistogram startTransfer;
+				LatencyHistogram total;
+
+				/// @return A copy of the histograms
+				TransferTimings GetSnapshot() const;
+			};
+
+			/// @brief The most origins tracked on their own. Transfers to
+			/// origins past this are only counted in the total
+			static constexpr size_t s_maxOrigins = 256;
+
+			TimingRecorder() noexcept = default;
+			TimingRecorder(const TimingRecorder&) = delete;
+			TimingRecorder& operator=(const TimingRecorder&) = delete;
+			~TimingRecorder() noexcept;
+
+			/// @brief Records a transfer that completed
+			/// @param easy The native handle of the transfer
+			/// @param origin The origin of the transfer, see
+			/// CircuitBreaker::GetOrigin, or an empty string for none
+			void Record(CURL* easy, std::string_view origin) noexcept;
+
+			/// @return The timings of every transfer
+			TransferTimings GetTimings() const;
+			/// @return The timings of the transfers to each origin
+			std::unordered_map<std::string, TransferTimings> GetOriginTimings() const;
+			/// @return The histograms of every transfer
+			inline const Histograms& GetHistograms() const noexcept { return m_all; }
+			/// @brief Visits the histograms of each origin without copying
+			/// them or locking. Origins added while it runs may be missed
+			/// @tparam Visitor The visitor type
+			/// @param visitor Called with each origin and its histograms
+			template<typename Visitor>
+			void ForEachOrigin(Visitor&& visitor) const
+			{
+				for (const auto& slot : m_origins)
+					if (auto origin = slot.load(std::memory_order_acquire); origin != nullptr)
+						visitor(std::string_view(origin->name), origin->histograms);
+			}
+		private:
+			/// @brief An origin and its histograms
+			struct Origin
+			{
+				std::string name;
+				Histograms histograms;
+			};
+
+			/// @brief Finds the histograms of an origin, adding it if there
+			/// is room. Only the recording thread may call this
+			/// @param name The origin
+			/// @return The histograms, or nullptr if there was no room
+			Histograms* FindOrigin(std::string_view name) noexcept;
+
+			Histograms m_all;
+			/// @brief The origins as an open addressing table twice as big
+			/// as it gets, so that probes stay short. Only the recording
+			/// thread adds to it, and a slot never changes once it is set
+			std::array<std::atomic<Origin*>, s_maxOrigins * 2> m_origins{};
+			size_t m_originCount = 0;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef CURLMULTIASIO_DETAIL_TRANSFERARENA_H_
+#define CURLMULTIASIO_DETAIL_TRANSFERARENA_H_
+
+/// @file
+/// Per-transfer Arenas
+/// 10/17/26
+
+// STL includes
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+namespace cma
+{
+	namespace Detail
+	{
+		class ArenaPool;
+
+		/// @brief A monotonic arena holding the state of a single transfer.
+		/// Allocations are carved out of a fixed block, spilling over to
+		/// the heap once it is full, and nothing is freed until the whole
+		/// arena is reset when the transfer is done
+		class TransferArena
+		{
+		public:
+			/// @brief The size of the block most transfers fit in
+			static constexpr size_t s_blockSize = 2048;
+
+			TransferArena() noexcept :
+				m_resource(m_block.data(), m_block.size(), std::pmr::new_delete_resource()) {}
+			TransferArena(const TransferArena&) = delete;
+			TransferArena& operator=(const TransferArena&) = delete;
+
+			/// @return The resource that allocates from the arena
+			inline std::pmr::memory_resource* GetResource() noexcept { return &m_resource; }
+			/// @brief Frees everything at once, and starts over at the
+			/// beginning of the block
+			inline void Reset() noexcept { m_resource.release(); }
+		private:
+			friend class ArenaPool;
+
+			alignas(std::max_align_t) std::array<std::byte, s_blockSize> m_block;
+			std::pmr::monotonic_buffer_resource m_resource;
+			/// @brief The next idle arena, while it is in the pool
+			TransferArena* m_next = nullptr;
+		};
+
+		/// @brief Gives a TransferArena back to its pool when it goes away
+		struct ArenaReturner
+		{
+			std::shared_ptr<ArenaPool> pool;
+
+			void operator()(TransferArena* arena) const noexcept;
+		};
+		/// @brief A TransferArena on loan from an ArenaPool
+		using ArenaLease = std::unique_ptr<TransferArena, ArenaReturner>;
+
+		/// @brief Recycles the arenas of a Multi's transfers, so that once
+		/// it is warm, the state of a transfer is allocated without touching
+		/// the heap. It also pools the nodes of the Multi's transfer maps.
+		/// Leases and PoolAllocators keep the pool alive, so it can't go away
+		/// before the last transfer using it
+		class ArenaPool : public std::enable_shared_from_this<ArenaPool>
+		{
+		public:
+			/// @param maxIdle The most arenas kept for reuse
+			explicit ArenaPool(size_t maxIdle = 256) noexcept : m_maxIdle(maxIdle) {}
+			ArenaPool(const ArenaPool&) = delete;
+			ArenaPool& operator=(const ArenaPool&) = delete;
+			~ArenaPool() noexcept;
+
+			/// @brief Lends an arena, which may be from any thread
+			/// @return The arena
+			ArenaLease Acquire();
+			/// @brief The resource the transfer maps allocate their nodes
+			/// from. It isn't synchronized, so it may only be used where
+			/// the maps are, on the strand
+			/// @return The resource
+			inline std::pmr::memory_resource* GetNodeResource() noexcept { return &m_nodes; }
+		private:
+			friend struct ArenaReturner;
+
+			/// @brief Resets an arena and keeps it, unless there are
+			/// enough kept already
+			/// @param arena The arena
+			void Recycle(TransferArena* arena) noexcept;
+			/// @brief Pushes a list of idle arenas
+			/// @param first The first arena, linked to the rest
+			void PushIdle(TransferArena* first) noexcept;
+
+			size_t m_maxIdle;
+			/// @brief The idle arenas, as a lock-free stack. Transfers start
+			/// on any thread, and may be destroyed off the strand when they
+			/// are cancelled
+			std::atomic<TransferArena*> m_idle = nullptr;
+			/// @brief About how many arenas are idle. It may run over for a
+			/// moment, which only means an arena more is freed
+			std::atomic<size_t> m_idleCount = 0;
+			std::pmr::unsynchronized_pool_resource m_nodes;
+		};
+
+		/// @brief An allocator for the pooled nodes of a Multi's maps. It
+		/// holds on to the pool, and moves along with its map, so nodes are
+		/// always freed into the pool they came from
+		/// @tparam T The type allocated
+		template<typename T>
+		class PoolAllocator
+		{
+		public:
+			using value_type = T;
+			using propagate_on_container_copy_assignment = std::true_type;
+			using propagate_on_container_move_assignment = std::true_type;
+			using propagate_on_container_swap = std::true_type;
+
+			explicit PoolAllocator(std::shared_ptr<ArenaPool> pool) noexcept :
+				m_pool(std::move(pool)) {}
+			// copied when moved too, so a map that was moved from
+			// can still free whatever it has left
+			PoolAllocator(const PoolAllocator&) noexcept = default;
+			template<typename U>
+			PoolAllocator(const PoolAllocator<U>& other) noexcept : m_pool(other.m_pool) {}
+
+			T* allocate(size_t n)
+			{
+				return static_cast<T*>(m_pool->GetNodeResource()->allocate(
+					n * sizeof(T), alignof(T)));
+			}
+			void deallocate(T* p, size_t n) noexcept
+			{
+				m_pool->GetNodeResource()->deallocate(p, n * sizeof(T), alignof(T));
+			}
+
+			template<typename U>
+			bool operator==(const PoolAllocator<U>& other) const noexcept
+			{
+				return m_pool == other.m_pool;
+			}
+		private:
+			template<typename U>
+			friend class PoolAllocator;
+
+			std::shared_ptr<ArenaPool> m_pool;
+		};
+	}
+}
+
+#endif
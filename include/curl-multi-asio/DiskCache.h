@@ -0,0 +1,149 @@
+#ifndef CURLMULTIASIO_DISKCACHE_H_
+#define CURLMULTIASIO_DISKCACHE_H_
+
+/// @file
+/// Persistent Response Store
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/HttpMessage.h>
+#include <curl-multi-asio/ResponseCache.h>
+#include <curl-multi-asio/Detail/MappedFile.h>
+
+// STL includes
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cma
+{
+	/// @brief DiskCache is a CacheStore that persists across restarts. Response
+	/// headers and bodies are appended to segment files, and where each one
+	/// lives is recorded, along with its freshness and validators, in a compact
+	/// index that is itself an append-only log. Opening the cache only replays
+	/// the index; segments are mapped read-only the first time one of their
+	/// responses is found, and the bodies of found responses point straight into
+	/// the mapping, see SharedResponse::GetBody. Revalidating a response only
+	/// appends to the index. Space is reclaimed a whole segment at a time,
+	/// oldest first, so the cache stays within about one segment of its
+	/// capacity. Everything is guarded by one lock, since the disk is the
+	/// bottleneck either way
+	class DiskCache : public CacheStore
+	{
+	public:
+		/// @param directory The directory that holds the cache, created if it
+		/// doesn't exist. Only one DiskCache may use a directory at a time
+		/// @param capacity The number of bytes of segments to keep
+		/// @param segmentSize The size after which a segment is sealed and
+		/// another is started
+		DiskCache(std::filesystem::path directory, uint64_t capacity = 1024 * 1024 * 1024,
+			uint64_t segmentSize = 64 * 1024 * 1024) noexcept;
+		~DiskCache() noexcept;
+		DiskCache(const DiskCache&) = delete;
+		DiskCache& operator=(const DiskCache&) = delete;
+
+		/// @brief Opens the cache, loading its index. Until it is opened,
+		/// the cache is empty and ignores whatever is stored in it
+		/// @return The error, if any
+		error_code Open() noexcept;
+
+		CacheEntryPtr Find(std::string_view key) noexcept override;
+		void Store(std::string_view key, CacheEntryPtr entry) noexcept override;
+		void Refresh(std::string_view key, const CacheEntry& previous,
+			CacheEntryPtr entry) noexcept override;
+		void Erase(std::string_view key) noexcept override;
+
+		/// @return The number of bytes held in segments
+		uint64_t GetSize() const noexcept;
+		/// @return The number of entries held
+		size_t GetCount() const noexcept;
+	private:
+		/// @brief Where a response is stored, and what is known about it
+		struct IndexEntry
+		{
+			uint32_t segment = 0;
+			uint64_t offset = 0;
+			uint64_t headersSize = 0;
+			uint64_t bodySize = 0;
+			long status = 0;
+			std::string etag;
+			std::string lastModified;
+			/// @brief Seconds since the epoch
+			int64_t responseTime = 0;
+			int64_t initialAge = 0;
+			int64_t lifetime = 0;
+			bool noCache = false;
+			std::vector<std::pair<std::string, std::string>> vary;
+		};
+		struct Segment
+		{
+			uint64_t size = 0;
+			/// @brief Shared with every response found in the segment, so a
+			/// remapped or evicted segment stays mapped while they are in use
+			std::shared_ptr<Detail::MappedFile> mapping;
+		};
+
+		/// @param id The id of a segment
+		/// @return The path of its file
+		std::filesystem::path SegmentPath(uint32_t id) const;
+		/// @brief Copies the freshness of an entry into an index entry
+		/// @param entry The entry
+		/// @param indexEntry The index entry
+		static void CopyFreshness(const CacheEntry& entry, IndexEntry& indexEntry) noexcept;
+		/// @brief Serializes a record of the index
+		/// @param key The key
+		/// @param indexEntry The entry, or null to record that the key was erased
+		/// @return The record
+		static std::string Serialize(std::string_view key, const IndexEntry* indexEntry);
+		/// @brief Parses a record of the index
+		/// @param record The record
+		/// @param key The key
+		/// @param indexEntry The entry, if it wasn't erased
+		/// @param erased Whether or not the record erased the key
+		/// @return Whether or not the record was valid
+		static bool Parse(std::string_view record, std::string& key,
+			IndexEntry& indexEntry, bool& erased) noexcept;
+		/// @brief Appends a response to the active segment, starting
+		/// another one if it is full
+		/// @param response The response
+		/// @param indexEntry The index entry to record its location in
+		/// @return The error, if any
+		error_code Append(const SharedResponse& response, IndexEntry& indexEntry) noexcept;
+		/// @brief Appends a record to the index, compacting it if it grew
+		/// too far past what it describes
+		/// @param key The key
+		/// @param indexEntry The entry, or null to record that the key was erased
+		void Record(std::string_view key, const IndexEntry* indexEntry) noexcept;
+		/// @brief Rewrites the index with only the live entries
+		/// @return The error, if any
+		error_code Compact() noexcept;
+		/// @brief Drops the oldest segments until the cache fits its capacity
+		void Evict() noexcept;
+
+		std::filesystem::path m_directory;
+		uint64_t m_capacity;
+		uint64_t m_segmentSize;
+		mutable std::mutex m_mutex;
+		bool m_open = false;
+		std::unordered_map<std::string, IndexEntry> m_index;
+		/// @brief The segments, oldest first. The last one is appended to
+		std::map<uint32_t, Segment> m_segments;
+		uint64_t m_size = 0;
+		std::FILE* m_indexFile = nullptr;
+		std::FILE* m_segmentFile = nullptr;
+		/// @brief The records in the index, live or not
+		size_t m_records = 0;
+	};
+}
+
+#endif
@@ -14,10 +14,14 @@
 #include <tl/expected.hpp>
 
 // STL includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <initializer_list>
 #include <memory>
 #include <ostream>
 #include <span>
+#include <type_traits>
 #include <utility>
 
 /// @brief This concept detects any type, such as std::string,
@@ -47,6 +51,9 @@ namespace cma
 	/// @brief Easy is a wrapper around an easy CURL handle
 	class Easy
 	{
+		// Multi swaps handles when a hedged duplicate wins, and flips the
+		// transfer state to cancel
+		friend class Multi;
 	public:
 		struct Header
 		{
@@ -139,7 +146,29 @@ namespace cma
 			if (const auto err = SetOption(CURLoption::CURLOPT_WRITEDATA,
 				&buffer); err)
 				return err;
-			return SetOption(CURLoption::CURLOPT_WRITEFUNCTION, WriteCb<T>);
+			if (const auto err = SetOption(CURLoption::CURLOPT_WRITEFUNCTION,
+				WriteCb<T>); err)
+				return err;
+			m_buffer = &buffer;
+			m_bufferOps = GetBufferOps<T>();
+			m_bufferMark = 0;
+			return {};
+		}
+		/// @brief Remembers where the buffer set by SetBuffer currently ends,
+		/// so that whatever a failed attempt writes can be dropped again
+		/// by RewindBuffer before the next one
+		inline void MarkBuffer() noexcept
+		{
+			if (m_buffer != nullptr)
+				m_bufferMark = m_bufferOps->tell(m_buffer);
+		}
+		/// @brief Drops everything written to the buffer set by SetBuffer since
+		/// the last MarkBuffer. Containers are truncated, and ostreams are
+		/// sought back to the mark if they support it
+		inline void RewindBuffer() noexcept
+		{
+			if (m_buffer != nullptr)
+				m_bufferOps->rewind(m_buffer, m_bufferMark);
 		}
 		/// @brief Sets an option on the easy handle
 		/// @tparam T The value type
@@ -149,6 +178,7 @@ namespace cma
 		template<typename T>
 		inline error_code SetOption(CURLoption option, T&& value) noexcept
 		{
+			RememberOption(option, value);
 			// weird GCC bug where forward thinks its return value is ignored
 			return curl_easy_setopt(GetNativeHandle(), option, static_cast<T&&>(value));
 		}
@@ -252,6 +282,67 @@ namespace cma
 			return result;
 		}
 
+		/// @brief The operations on the buffer set by SetBuffer, type
+		/// erased so that Multi can rewind and refill it
+		struct BufferOps
+		{
+			/// @brief Gets the current end of the buffer
+			size_t (*tell)(void* buffer) noexcept;
+			/// @brief Drops everything after a previous end of the buffer
+			void (*rewind)(void* buffer, size_t mark) noexcept;
+			/// @brief Writes to the buffer as if cURL had
+			void (*append)(void* buffer, const char* data, size_t size) noexcept;
+			/// @brief Sets the buffer on an easy handle
+			error_code (*install)(Easy& easy, void* buffer) noexcept;
+		};
+		/// @return The current end of the buffer
+		template<typename T>
+		static size_t TellCb(void* buffer) noexcept
+		{
+			if constexpr (IsOstream<T>)
+			{
+				const auto pos = static_cast<std::ostream*>(buffer)->tellp();
+				return (pos < 0) ? 0 : static_cast<size_t>(pos);
+			}
+			else if constexpr (AcceptsCharacters<T>)
+				return static_cast<T*>(buffer)->size();
+			else
+				return 0;
+		}
+		/// @brief Truncates containers, and seeks ostreams back
+		template<typename T>
+		static void RewindCb(void* buffer, size_t mark) noexcept
+		{
+			if constexpr (IsOstream<T>)
+			{
+				auto stream = static_cast<std::ostream*>(buffer);
+				stream->clear();
+				stream->seekp(static_cast<std::streamoff>(mark));
+			}
+			else if constexpr (AcceptsCharacters<T>)
+				static_cast<T*>(buffer)->resize(mark);
+		}
+		/// @brief Writes to the buffer with its write callback
+		template<typename T>
+		static void AppendCb(void* buffer, const char* data, size_t size) noexcept
+		{
+			WriteCb<T>(const_cast<char*>(data), 1, size, static_cast<T*>(buffer));
+		}
+		/// @brief Sets the buffer on an easy handle
+		template<typename T>
+		static error_code InstallCb(Easy& easy, void* buffer) noexcept
+		{
+			return easy.SetBuffer(*static_cast<T*>(buffer));
+		}
+		/// @return The buffer operations for a buffer type
+		template<typename T>
+		static const BufferOps* GetBufferOps() noexcept
+		{
+			static constexpr BufferOps s_ops{ TellCb<T>, RewindCb<T>,
+				AppendCb<T>, InstallCb<T> };
+			return &s_ops;
+		}
+
 		/// @brief The write callback for ostreams. For a
 		/// description of each argument, check cURL docs for
 		/// CURLOPT_WRITEFUNCTION
@@ -291,6 +382,100 @@ namespace cma
 		std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> m_nativeHandle;
 		std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> m_headerList;
 		std::string m_postData;
+		// the buffer set by SetBuffer, if any
+		void* m_buffer = nullptr;
+		const BufferOps* m_bufferOps = nullptr;
+		size_t m_bufferMark = 0;
+		/// @brief The signature of CURLOPT_HEADERFUNCTION
+		using HeaderFunction = size_t(*)(char*, size_t, size_t, void*);
+		// the header callback set by SetOption, if any, which a hedged
+		// transfer holds back until it knows which attempt won
+		HeaderFunction m_headerFunction = nullptr;
+		void* m_headerData = nullptr;
+		// the CURLOPT_TIMEOUT_MS or CURLOPT_TIMEOUT set by SetOption, if any,
+		// which a transfer's deadline may shorten but never lengthens
+		std::chrono::milliseconds m_timeout{ 0 };
+		using DebugFunction = int(*)(CURL*, curl_infotype, char*, size_t, void*);
+		// the CURLOPT_VERBOSE and debug callback set by SetOption, if any,
+		// which a flight recorder chains to rather than replaces
+		bool m_verbose = false;
+		DebugFunction m_debugFunction = nullptr;
+		void* m_debugData = nullptr;
+
+		/// @brief Remembers the options Multi replaces while a transfer
+		/// runs and puts back afterwards, since cURL has no way to read
+		/// options back
+		/// @tparam T The value type
+		/// @param option The option
+		/// @param value The value
+		template<typename T>
+		inline void RememberOption(CURLoption option, const T& value) noexcept
+		{
+			if constexpr (std::is_integral_v<T>)
+			{
+				if (option == CURLoption::CURLOPT_TIMEOUT_MS)
+					m_timeout = std::chrono::milliseconds(value);
+				else if (option == CURLoption::CURLOPT_TIMEOUT)
+					m_timeout = std::chrono::seconds(value);
+				else if (option == CURLoption::CURLOPT_VERBOSE)
+					m_verbose = value != 0;
+			}
+			else if constexpr (std::is_null_pointer_v<T>)
+			{
+				if (option == CURLoption::CURLOPT_HEADERFUNCTION)
+					m_headerFunction = nullptr;
+				else if (option == CURLoption::CURLOPT_HEADERDATA)
+					m_headerData = nullptr;
+				else if (option == CURLoption::CURLOPT_DEBUGFUNCTION)
+					m_debugFunction = nullptr;
+				else if (option == CURLoption::CURLOPT_DEBUGDATA)
+					m_debugData = nullptr;
+			}
+			else if constexpr (std::is_pointer_v<T> &&
+				std::is_function_v<std::remove_pointer_t<T>>)
+			{
+				if (option == CURLoption::CURLOPT_HEADERFUNCTION)
+					// by way of void(), as cURL calls it with a void* anyway
+					m_headerFunction = reinterpret_cast<HeaderFunction>(
+						reinterpret_cast<void(*)()>(value));
+				else if (option == CURLoption::CURLOPT_DEBUGFUNCTION)
+					m_debugFunction = reinterpret_cast<DebugFunction>(
+						reinterpret_cast<void(*)()>(value));
+			}
+			else if constexpr (std::is_pointer_v<T>)
+			{
+				if (option == CURLoption::CURLOPT_HEADERDATA)
+					m_headerData = const_cast<void*>(static_cast<const void*>(value));
+				else if (option == CURLoption::CURLOPT_DEBUGDATA)
+					m_debugData = const_cast<void*>(static_cast<const void*>(value));
+			}
+		}
+
+		/// @brief Where the transfer of the handle is at. It is on the
+		/// handle rather than the transfer because the handle outlives it,
+		/// so any thread can look at it without the transfer going away
+		enum class TransferState : uint8_t
+		{
+			Idle,
+			Active,
+			Cancelling
+		};
+		/// @brief The transfer state, which starts out idle in a copied or
+		/// moved handle, since a handle can't be either while it's performed
+		struct AtomicTransferState
+		{
+			AtomicTransferState() noexcept = default;
+			AtomicTransferState(const AtomicTransferState&) noexcept {}
+			AtomicTransferState& operator=(const AtomicTransferState&) noexcept { return *this; }
+
+			std::atomic<TransferState> value = TransferState::Idle;
+			/// @brief The native handle and generation of the transfer that
+			/// was last submitted, which a cancel finds it by, since the
+			/// handle may be gone by the time the strand gets to it
+			std::atomic<CURL*> handle = nullptr;
+			std::atomic<uint64_t> generation = 0;
+		};
+		mutable AtomicTransferState m_transferState;
 	};
 }
 
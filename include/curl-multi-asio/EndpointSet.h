@@ -0,0 +1,107 @@
+#ifndef CURLMULTIASIO_ENDPOINTSET_H_
+#define CURLMULTIASIO_ENDPOINTSET_H_
+
+/// @file
+/// Client-Side Load Balancing
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cma
+{
+	/// @brief A logical service and the replicas that serve it. Transfers to
+	/// the service are routed to one of the replicas with CURLOPT_CONNECT_TO,
+	/// so URLs keep naming the service, and the Host header and TLS name stay
+	/// the service's. Each replica is picked by the power of two choices: two
+	/// replicas are drawn at random, and the one with the lower load wins,
+	/// where load is the transfers it has in flight times its moving average
+	/// latency. The set is thread safe, and is meant to be shared by every
+	/// transfer to the service, including transfers on different Multis
+	class EndpointSet
+	{
+	public:
+		/// @brief A replica. IPv6 addresses go in brackets
+		struct Endpoint
+		{
+			std::string host;
+			uint16_t port = 0;
+		};
+
+		/// @brief The weight of the newest latency in the moving average
+		double smoothing = 0.2;
+		/// @brief The latency a failed transfer counts as, at the least, so
+		/// that a replica that fails fast doesn't look like a fast one
+		std::chrono::milliseconds failurePenalty{ 1000 };
+
+		/// @param service The host name the service is reached by in URLs
+		/// @param servicePort The port of the service in URLs, or 0 for any
+		/// @param endpoints The replicas
+		EndpointSet(std::string service, uint16_t servicePort,
+			std::vector<Endpoint> endpoints) noexcept;
+		EndpointSet(const EndpointSet&) = delete;
+		EndpointSet& operator=(const EndpointSet&) = delete;
+
+		/// @brief Picks the replica for a new transfer and counts it as in
+		/// flight. Every pick must be followed by a call to Finish
+		/// @return The index of the replica
+		size_t Pick() noexcept;
+		/// @brief Records that a transfer to a replica is done
+		/// @param index The index of the replica
+		/// @param latency How long the transfer took, or nothing if it was
+		/// cancelled and says nothing about the replica
+		/// @param failed Whether or not the transfer failed
+		void Finish(size_t index, std::optional<std::chrono::steady_clock::duration> latency,
+			bool failed) noexcept;
+		/// @param index The index of the replica
+		/// @return The CURLOPT_CONNECT_TO entry that routes the service to it
+		std::string GetConnectTo(size_t index) const;
+
+		/// @return The number of replicas
+		inline size_t GetSize() const noexcept { return m_endpoints.size(); }
+		/// @param index The index of the replica
+		/// @return The replica
+		inline const Endpoint& GetEndpoint(size_t index) const noexcept
+		{
+			return m_endpoints[index];
+		}
+		/// @param index The index of the replica
+		/// @return The transfers it has in flight
+		size_t GetInFlight(size_t index) const noexcept;
+		/// @param index The index of the replica
+		/// @return Its moving average latency
+		std::chrono::microseconds GetLatency(size_t index) const noexcept;
+		/// @param index The index of the replica
+		/// @return The number of times it was picked
+		size_t GetPicks(size_t index) const noexcept;
+	private:
+		struct Stats
+		{
+			std::atomic<size_t> inFlight = 0;
+			/// @brief In microseconds, 0 until the first sample
+			std::atomic<uint64_t> latency = 0;
+			std::atomic<size_t> picks = 0;
+		};
+
+		/// @param index The index of the replica
+		/// @return The load of the replica, lower is better
+		double GetLoad(size_t index) const noexcept;
+
+		std::string m_service;
+		uint16_t m_servicePort;
+		std::vector<Endpoint> m_endpoints;
+		std::unique_ptr<Stats[]> m_stats;
+	};
+}
+
+#endif
@@ -11,6 +11,20 @@
 // STL includes
 #include <string_view>
 
+namespace cma
+{
+	/// @brief Errors raised by the library itself, rather than by cURL
+	enum class Error
+	{
+		/// @brief The circuit breaker of the transfer's origin is open
+		CircuitOpen = 1,
+		/// @brief The deadline of the transfer passed before it completed
+		DeadlineExceeded,
+		/// @brief Too few of the transfers of a fan-out succeeded
+		QuorumNotReached
+	};
+}
+
 // register the error codes
 #ifdef CMA_USE_BOOST
 namespace boost
@@ -25,6 +39,8 @@ namespace std
 	struct is_error_code_enum<CURLcode> : std::true_type {};
 	template<>
 	struct is_error_code_enum<CURLMcode> : std::true_type {};
+	template<>
+	struct is_error_code_enum<cma::Error> : std::true_type {};
 #ifdef CMA_USE_BOOST
 	}
 }
@@ -60,4 +76,15 @@ inline cma::error_code make_error_code(CURLMcode code) noexcept
 	return { static_cast<int>(code), cma::Detail::CURLMcodeErrCategory::Instance() };
 }
 
+namespace cma
+{
+	/// @brief Makes an error code from a library error
+	/// @param code The error
+	/// @return The error code
+	inline error_code make_error_code(Error code) noexcept
+	{
+		return { static_cast<int>(code), Detail::CMAErrCategory::Instance() };
+	}
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef CURLMULTIASIO_FLIGHTRECORDER_H_
+#define CURLMULTIASIO_FLIGHTRECORDER_H_
+
+/// @file
+/// Debug Output Flight Recorder
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+namespace cma
+{
+	/// @brief Keeps the most recent CURLOPT_DEBUGFUNCTION output of the
+	/// transfers on a Multi, see Multi::SetFlightRecorder, so there is
+	/// something to look at when a transfer fails without leaving
+	/// CURLOPT_VERBOSE on. Events go into a fixed ring of slots without
+	/// locking or allocating: info text and headers are kept up to a
+	/// slot's worth, and only the size of data is kept. Nothing is
+	/// formatted until the ring is dumped
+	class FlightRecorder
+	{
+	public:
+		/// @brief The most text kept of an info or header event
+		static constexpr size_t s_textSize = 96;
+
+		/// @param capacity The most events kept, rounded up to a power of
+		/// two. Older ones are overwritten
+		/// @param failures If set, the events of every transfer that fails
+		/// are written to it as it completes
+		explicit FlightRecorder(size_t capacity = 4096, std::ostream* failures = nullptr);
+		FlightRecorder(const FlightRecorder&) = delete;
+		FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+		/// @brief Records a debug event. This can be called from any thread
+		/// @param easy The native handle of the transfer
+		/// @param type The type of event
+		/// @param data The event's data
+		/// @param size The size of the data
+		void Record(CURL* easy, curl_infotype type, const char* data, size_t size) noexcept;
+		/// @brief Writes the events that are kept as text, oldest first, in
+		/// the style of CURLOPT_VERBOSE. Events being overwritten while they
+		/// are read are skipped. This can be called from any thread
+		/// @param out The stream to write to
+		/// @param easy If set, only the events of this transfer are written
+		void Dump(std::ostream& out, const CURL* easy = nullptr) const;
+		/// @brief Writes the events of a failed transfer to the failure
+		/// stream, if there is one
+		/// @param easy The native handle of the transfer
+		/// @param ec Why it failed
+		void DumpFailure(const CURL* easy, const error_code& ec) const;
+		/// @return The events ever recorded
+		inline uint64_t GetRecorded() const noexcept
+		{
+			return m_next.load(std::memory_order_relaxed);
+		}
+	private:
+		struct Slot
+		{
+			/// @brief Odd while the slot is being written, and twice the
+			/// event's number plus two once it is
+			std::atomic<uint64_t> sequence = 0;
+			int64_t time = 0;
+			const void* easy = nullptr;
+			uint64_t size = 0;
+			uint8_t type = 0;
+			uint8_t length = 0;
+			char text[s_textSize];
+		};
+
+		/// @brief When the recorder was created, which event times are from
+		std::chrono::steady_clock::time_point m_epoch;
+		std::unique_ptr<Slot[]> m_slots;
+		size_t m_mask;
+		/// @brief The number of the next event
+		std::atomic<uint64_t> m_next = 0;
+		std::ostream* m_failures;
+		/// @brief Keeps failures from interleaving in the stream
+		mutable std::mutex m_failuresMutex;
+	};
+}
+
+#endif
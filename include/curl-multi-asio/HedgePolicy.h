@@ -0,0 +1,90 @@
+#ifndef CURLMULTIASIO_HEDGEPOLICY_H_
+#define CURLMULTIASIO_HEDGEPOLICY_H_
+
+/// @file
+/// Hedged Request Policy
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace cma
+{
+	/// @brief Describes when a slow transfer is hedged. A hedge is a duplicate
+	/// of the transfer's easy handle, started while the original is still
+	/// running. Whichever finishes successfully first completes the transfer,
+	/// and the other is removed from the multi handle right away. Hedges cost
+	/// extra load, so they are limited to a fraction of all requests. A policy
+	/// tracks the latencies of the transfers that use it and is thread safe,
+	/// so it is meant to be shared by every request to the same backend
+	class HedgePolicy
+	{
+	public:
+		/// @brief How long a transfer runs before it is hedged. This is also
+		/// used while there aren't enough samples for the percentile
+		std::chrono::milliseconds delay{ 50 };
+		/// @brief If between 0 and 1, transfers are hedged once they have been
+		/// running longer than this percentile of recent latencies, e.g. 0.95
+		double percentile = 0.0;
+		/// @brief The latencies recorded before the percentile is used
+		size_t minSamples = 32;
+		/// @brief The hedges allowed per request. Every request earns this
+		/// fraction of a hedge, so 0.05 allows at most 5% extra transfers
+		double maxHedgeRatio = 0.05;
+		/// @brief The most hedges that can be saved up for a burst
+		double maxBurst = 10.0;
+
+		HedgePolicy() noexcept = default;
+		HedgePolicy(const HedgePolicy&) = delete;
+		HedgePolicy& operator=(const HedgePolicy&) = delete;
+
+		/// @return How long a transfer should run before it is hedged
+		std::chrono::milliseconds GetDelay() noexcept;
+		/// @brief Records a new request, which earns part of a hedge
+		void OnRequest() noexcept;
+		/// @brief Spends a hedge from the budget
+		/// @return Whether or not a hedge may be launched
+		bool TryHedge() noexcept;
+		/// @brief Gives back a hedge from TryHedge that couldn't be launched
+		void RefundHedge() noexcept;
+		/// @brief Records a hedge that finished first
+		inline void OnHedgeWon() noexcept { m_won.fetch_add(1, std::memory_order_relaxed); }
+		/// @brief Records the latency of a completed request
+		/// @param latency The time from the start to the completion
+		void RecordLatency(std::chrono::steady_clock::duration latency) noexcept;
+
+		/// @return The number of hedges launched
+		inline size_t GetHedgesLaunched() const noexcept
+		{
+			return m_launched.load(std::memory_order_relaxed);
+		}
+		/// @return The number of hedges that finished before their original
+		inline size_t GetHedgesWon() const noexcept
+		{
+			return m_won.load(std::memory_order_relaxed);
+		}
+	private:
+		static constexpr size_t s_windowSize = 256;
+		// how many new samples there must be before the percentile is recomputed
+		static constexpr size_t s_recomputeEvery = 16;
+
+		// the most recent latencies in microseconds, as a ring
+		std::array<std::atomic<uint32_t>, s_windowSize> m_window{};
+		std::atomic<size_t> m_samples = 0;
+		std::atomic<uint32_t> m_cachedPercentile = 0;
+		std::atomic<size_t> m_cachedAt = 0;
+		// the budget in thousandths of a hedge
+		std::atomic<int64_t> m_milliTokens = 0;
+		std::atomic<size_t> m_launched = 0;
+		std::atomic<size_t> m_won = 0;
+	};
+}
+
+#endif
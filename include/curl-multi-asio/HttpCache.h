@@ -0,0 +1,123 @@
+#ifndef CURLMULTIASIO_HTTPCACHE_H_
+#define CURLMULTIASIO_HTTPCACHE_H_
+
+/// @file
+/// HTTP Response Caching
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/HttpMessage.h>
+#include <curl-multi-asio/Multi.h>
+#include <curl-multi-asio/ResponseCache.h>
+
+// STL includes
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace cma
+{
+	/// @brief HttpCache is a private HTTP cache in front of a Multi, in the
+	/// manner of RFC 9111. GET responses are kept according to their
+	/// Cache-Control, Expires and Vary headers, in a ResponseCache by default,
+	/// or in any other CacheStore such as a DiskCache. A request for a fresh
+	/// response completes from the store without touching curl at all. A stale
+	/// response that has an ETag or Last-Modified header is revalidated with a
+	/// conditional request, and a 304 Not Modified serves the stored body. The
+	/// request's own Cache-Control no-store, no-cache and max-age directives
+	/// are honored. Requests that carry their own conditional or Range headers
+	/// bypass the cache, and a successful unsafe request invalidates the stored
+	/// GET response of its URL. The HttpCache must stay in scope until every
+	/// handler has been called
+	class HttpCache
+	{
+	public:
+		/// @brief Sets any other options on the easy handle of each transfer
+		using Configure = std::function<void(Easy&)>;
+
+		/// @param multi The multi handle that performs the transfers
+		/// @param store The store, which may be shared with other caches
+		/// @param configure Called on each transfer's easy handle before it starts
+		HttpCache(Multi& multi, std::shared_ptr<CacheStore> store =
+			std::make_shared<ResponseCache>(), Configure configure = {}) noexcept;
+		HttpCache(const HttpCache&) = delete;
+		HttpCache& operator=(const HttpCache&) = delete;
+
+		/// @brief Performs a request, or serves it from the store. This can be
+		/// called from multiple threads at once. The completion token signature
+		/// is void(error_code, ResponsePtr), and the response is null on error
+		/// @tparam CompletionToken The completion token type
+		/// @param request The request
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerform(HttpRequest request, CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, HttpRequest request)
+			{
+				Perform(std::move(request), std::make_unique<Detail::ResponseHandler<
+					typename std::decay_t<decltype(handler)>>>(handler));
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, ResponsePtr)>(initiation, token, std::move(request));
+		}
+
+		/// @return The store
+		inline CacheStore& GetStore() noexcept { return *m_store; }
+		/// @return The number of requests served from the store without a transfer
+		inline size_t GetHits() const noexcept
+		{
+			return m_hits.load(std::memory_order_relaxed);
+		}
+		/// @return The number of stored responses that were revalidated by a 304
+		inline size_t GetRevalidations() const noexcept
+		{
+			return m_revalidations.load(std::memory_order_relaxed);
+		}
+		/// @return The number of requests that downloaded a full response
+		inline size_t GetMisses() const noexcept
+		{
+			return m_misses.load(std::memory_order_relaxed);
+		}
+	private:
+		/// @brief A request that went to the network
+		struct Transfer
+		{
+			Easy easy;
+			HttpRequest request;
+			std::string key;
+			/// @brief Whether or not the response may be stored
+			bool cacheable = false;
+			/// @brief The stored response being revalidated, if any
+			CacheEntryPtr cached;
+			std::shared_ptr<SharedResponse> response;
+			CacheEntry::Clock::time_point requestTime;
+			std::unique_ptr<Detail::ResponseHandlerBase> handler;
+		};
+
+		/// @brief Serves a request from the store, or starts a transfer for it
+		/// @param request The request
+		/// @param handler The handler
+		void Perform(HttpRequest&& request,
+			std::unique_ptr<Detail::ResponseHandlerBase> handler) noexcept;
+		/// @brief Stores the response of a transfer, and completes its handler.
+		/// Called from the Multi's strand
+		/// @param transfer The transfer
+		/// @param ec The result of the transfer
+		void Finish(std::unique_ptr<Transfer> transfer, error_code ec) noexcept;
+
+		Multi& m_multi;
+		std::shared_ptr<CacheStore> m_store;
+		Configure m_configure;
+		std::atomic<size_t> m_hits = 0;
+		std::atomic<size_t> m_revalidations = 0;
+		std::atomic<size_t> m_misses = 0;
+	};
+}
+
+#endif
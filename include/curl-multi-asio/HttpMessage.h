@@ -0,0 +1,115 @@
+#ifndef CURLMULTIASIO_HTTPMESSAGE_H_
+#define CURLMULTIASIO_HTTPMESSAGE_H_
+
+/// @file
+/// HTTP Requests and Shared Responses
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace cma
+{
+	/// @brief A request described by value, for the layers over Multi
+	/// that decide for themselves whether and how to perform it
+	struct HttpRequest
+	{
+		/// @brief The method, which should be one that is safe to share
+		std::string method = "GET";
+		std::string url;
+		std::vector<std::pair<std::string, std::string>> headers;
+
+		/// @brief Finds a header, compared case insensitively
+		/// @param name The name of the header
+		/// @return The value of the first header with the name, if any
+		std::optional<std::string_view> FindHeader(std::string_view name) const noexcept;
+	};
+
+	/// @brief A response that is shared by every caller it is handed to
+	struct SharedResponse
+	{
+		/// @brief The HTTP status
+		long status = 0;
+		/// @brief The raw header block, one header per line
+		std::string headers;
+		/// @brief The body, when it was downloaded into memory
+		std::string body;
+		/// @brief Keeps the memory behind mappedBody alive, such as a mapped
+		/// file. Null when the body is held in body instead
+		std::shared_ptr<const void> mapping;
+		std::string_view mappedBody;
+
+		/// @return The body, wherever it is held
+		inline std::string_view GetBody() const noexcept
+		{
+			return (mapping != nullptr) ? mappedBody : std::string_view(body);
+		}
+	};
+	using ResponsePtr = std::shared_ptr<const SharedResponse>;
+
+	namespace Detail
+	{
+		/// @brief Compares two strings case insensitively, as header names are
+		/// @param a The first string
+		/// @param b The second string
+		/// @return Whether or not they are equal
+		bool HeaderNameEquals(std::string_view a, std::string_view b) noexcept;
+		/// @brief Finds a header in a raw header block. If the block holds more
+		/// than one response, as it does after redirects, only the last counts
+		/// @param headers The raw header block
+		/// @param name The name of the header
+		/// @return The value of the last header with the name, if any
+		std::optional<std::string_view> FindHeader(std::string_view headers,
+			std::string_view name) noexcept;
+		/// @brief Collects response headers into a string. For a description of
+		/// arguments, check cURL documentation for CURLOPT_HEADERFUNCTION
+		/// @return The number of bytes taken care of
+		size_t HeaderCb(char* buffer, size_t size, size_t nitems,
+			std::string* headers) noexcept;
+
+		/// @brief A caller waiting for a ResponsePtr
+		class ResponseHandlerBase
+		{
+		public:
+			virtual ~ResponseHandlerBase() = default;
+			/// @brief Calls the handler
+			/// @param ec The error code
+			/// @param response The response
+			virtual void Complete(error_code ec, ResponsePtr response) noexcept = 0;
+		};
+		template<typename Handler>
+		class ResponseHandler : public ResponseHandlerBase
+		{
+		public:
+			ResponseHandler(Handler& handler) noexcept : m_handler(std::move(handler)) {}
+			~ResponseHandler() noexcept
+			{
+				// abort if we haven't been handled
+				if (m_handled == false)
+					Complete(asio::error::operation_aborted, nullptr);
+			}
+
+			void Complete(error_code ec, ResponsePtr response) noexcept
+			{
+				if (m_handled == true)
+					return;
+				m_handled = true;
+				m_handler(ec, std::move(response));
+			}
+		private:
+			Handler m_handler;
+			bool m_handled = false;
+		};
+	}
+}
+
+#endif
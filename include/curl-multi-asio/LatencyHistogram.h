@@ -0,0 +1,171 @@
+#ifndef CURLMULTIASIO_LATENCYHISTOGRAM_H_
+#define CURLMULTIASIO_LATENCYHISTOGRAM_H_
+
+/// @file
+/// Latency Histograms
+/// 10/17/26
+
+// STL includes
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cma
+{
+	/// @brief A histogram of latencies in the style of HdrHistogram. Buckets
+	/// are log-linear: every power of two is split into 32 buckets, so any
+	/// latency from a microsecond to about 19 hours is kept to within about
+	/// 3%, in a fixed 8KiB of counters. Recording is a few relaxed atomic
+	/// increments, so it never locks, and any thread may take a snapshot
+	/// while others record. Snapshots can be merged with each other
+	class LatencyHistogram
+	{
+		static constexpr unsigned s_subBits = 5;
+		static constexpr size_t s_subBuckets = size_t(1) << s_subBits;
+		/// @brief Latencies are capped at 2^36 microseconds
+		static constexpr unsigned s_maxBits = 36;
+		static constexpr size_t s_buckets = s_subBuckets * (s_maxBits - s_subBits + 1);
+	public:
+		/// @brief A copy of a histogram at some point in time
+		class Snapshot
+		{
+		public:
+			/// @brief Adds the latencies of another snapshot to this one
+			/// @param other The other snapshot
+			void Merge(const Snapshot& other) noexcept;
+
+			/// @return The number of latencies recorded
+			inline uint64_t GetCount() const noexcept { return m_count; }
+			/// @return The smallest latency, or 0 if there were none
+			std::chrono::microseconds GetMin() const noexcept;
+			/// @return The largest latency
+			inline std::chrono::microseconds GetMax() const noexcept
+			{
+				return std::chrono::microseconds(m_max);
+			}
+			/// @return The sum of every latency
+			inline std::chrono::microseconds GetSum() const noexcept
+			{
+				return std::chrono::microseconds(m_sum);
+			}
+			/// @return The mean latency, or 0 if there were none
+			std::chrono::microseconds GetMean() const noexcept;
+			/// @param percentile The percentile, from 0 to 100
+			/// @return The latency at or below which that percentile of
+			/// latencies fall, or 0 if there were none
+			std::chrono::microseconds GetPercentile(double percentile) const noexcept;
+			/// @brief Visits every bucket that has latencies in it, in order
+			/// @tparam Visitor The visitor type
+			/// @param visitor Called with the bucket's highest latency
+			/// and its count
+			template<typename Visitor>
+			void ForEachBucket(Visitor&& visitor) const
+			{
+				for (size_t i = 0; i < m_counts.size(); ++i)
+				{
+					if (m_counts[i] != 0)
+						visitor(std::chrono::microseconds(UpperBound(i)), m_counts[i]);
+				}
+			}
+			/// @brief Visits every bucket that has latencies in it, in order
+			/// @tparam Visitor The visitor type
+			/// @param visitor Called with the bucket's lowest and highest
+			/// latency and its count
+			template<typename Visitor>
+			void ForEachBucketRange(Visitor&& visitor) const
+			{
+				for (size_t i = 0; i < m_counts.size(); ++i)
+				{
+					if (m_counts[i] != 0)
+						visitor(std::chrono::microseconds(LowerBound(i)),
+							std::chrono::microseconds(UpperBound(i)), m_counts[i]);
+				}
+			}
+		private:
+			friend class LatencyHistogram;
+
+			std::vector<uint64_t> m_counts;
+			uint64_t m_count = 0;
+			uint64_t m_sum = 0;
+			uint64_t m_min = UINT64_MAX;
+			uint64_t m_max = 0;
+		};
+
+		LatencyHistogram() noexcept = default;
+		LatencyHistogram(const LatencyHistogram&) = delete;
+		LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+		/// @brief Records a latency. Negative ones count as 0
+		/// @param latency The latency
+		void Record(std::chrono::microseconds latency) noexcept;
+		/// @return A copy of the histogram
+		Snapshot GetSnapshot() const;
+		/// @brief Copies the histogram into an existing snapshot, which
+		/// only allocates the first time a snapshot is filled
+		/// @param snapshot The snapshot to overwrite
+		void GetSnapshot(Snapshot& snapshot) const;
+	private:
+		/// @param value A latency in microseconds
+		/// @return The bucket it is counted in
+		static size_t BucketOf(uint64_t value) noexcept;
+		/// @param bucket A bucket
+		/// @return The lowest latency counted in it
+		static uint64_t LowerBound(size_t bucket) noexcept;
+		/// @param bucket A bucket
+		/// @return The highest latency counted in it
+		static uint64_t UpperBound(size_t bucket) noexcept;
+
+		std::array<std::atomic<uint64_t>, s_buckets> m_counts{};
+		std::atomic<uint64_t> m_sum = 0;
+		std::atomic<uint64_t> m_min = UINT64_MAX;
+		std::atomic<uint64_t> m_max = 0;
+	};
+
+	/// @brief How long each phase of the transfers took, from cURL's
+	/// CURLINFO_*_TIME_T breakdown. Each phase is the time from the start
+	/// of the transfer until it ended, as cURL reports it
+	struct TransferTimings
+	{
+		/// @brief Until the name was resolved
+		LatencyHistogram::Snapshot nameLookup;
+		/// @brief Until the connection was made
+		LatencyHistogram::Snapshot connect;
+		/// @brief Until the TLS handshake was done. Only transfers that
+		/// made a handshake are counted
+		LatencyHistogram::Snapshot appConnect;
+		/// @brief Until the first byte of the response arrived
+		LatencyHistogram::Snapshot startTransfer;
+		/// @brief Until the transfer was done
+		LatencyHistogram::Snapshot total;
+
+		/// @brief Adds the timings of another set to this one
+		/// @param other The other set
+		void Merge(const TransferTimings& other) noexcept;
+	};
+
+	/// @brief How responsive a Multi's strand is. Everything a Multi does
+	/// runs on its strand, so a slow completion handler or cURL callback
+	/// stalls every other transfer, which shows up here as lag
+	struct LoopHealth
+	{
+		/// @brief From a socket becoming ready until the strand handled it
+		LatencyHistogram::Snapshot readyDelay;
+		/// @brief How long after their expiry timers were handled
+		LatencyHistogram::Snapshot timerLag;
+		/// @brief How long each curl_multi_socket_action call took
+		LatencyHistogram::Snapshot socketAction;
+		/// @brief How long each completion handler ran
+		LatencyHistogram::Snapshot handlers;
+		/// @brief The turns the strand took for socket events and timers
+		uint64_t turns = 0;
+		/// @brief The transfers completed in those turns
+		uint64_t events = 0;
+		/// @brief The most transfers completed in a single turn
+		uint64_t maxEventsPerTurn = 0;
+	};
+}
+
+#endif
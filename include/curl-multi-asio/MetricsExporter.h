@@ -0,0 +1,86 @@
+#ifndef CURLMULTIASIO_METRICSEXPORTER_H_
+#define CURLMULTIASIO_METRICSEXPORTER_H_
+
+/// @file
+/// OpenMetrics Exporter
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/LatencyHistogram.h>
+#include <curl-multi-asio/MultiStats.h>
+
+// STL includes
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cma
+{
+	class Multi;
+
+	/// @brief Renders the counters and histograms of a set of Multis in the
+	/// OpenMetrics text format, which Prometheus scrapes. Every series has a
+	/// multi label with the name it was added under, and the transfer timings
+	/// of each origin have an origin label. Histograms are in seconds, with
+	/// the same fixed buckets for all of them. Once the first scrape is
+	/// done, scrapes never allocate
+	class MetricsExporter
+	{
+	public:
+		MetricsExporter() = default;
+		MetricsExporter(const MetricsExporter&) = delete;
+		MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+		/// @brief Adds a Multi to the scrapes. It must stay alive until
+		/// it is removed
+		/// @param name The value of its multi label
+		/// @param multi The multi handle
+		void Add(std::string name, const Multi& multi);
+		/// @brief Removes a Multi from the scrapes
+		/// @param multi The multi handle
+		void Remove(const Multi& multi) noexcept;
+
+		/// @brief Renders the metrics into a buffer, up to its size. Like
+		/// snprintf, it returns the size of the whole text, so a result
+		/// larger than the buffer means it was cut short, and another try
+		/// needs a buffer at least that big. The text isn't null terminated.
+		/// This can be called from any thread, one scrape at a time, and
+		/// takes no lock a Multi's strand would wait on. A bucket's le
+		/// counts every latency at or below its bound, to within the 3% the
+		/// histograms are kept to
+		/// @param buffer The buffer
+		/// @param size The size of the buffer
+		/// @return The size of the whole text
+		size_t Write(char* buffer, size_t size);
+	private:
+		struct Source
+		{
+			std::string name;
+			const Multi* multi;
+			/// @brief The statistics taken at the start of the scrape
+			MultiStats stats;
+		};
+		class Output;
+
+		/// @brief Writes a histogram's series
+		/// @param out The output
+		/// @param family The name of the histogram
+		/// @param source The Multi it belongs to
+		/// @param origin The origin label, if any
+		/// @param phase The phase label, if any
+		/// @param histogram The histogram
+		void WriteHistogram(Output& out, std::string_view family, const Source& source,
+			std::string_view origin, std::string_view phase, const LatencyHistogram& histogram);
+
+		/// @brief Guards the sources, and the scratch snapshot
+		std::mutex m_mutex;
+		std::vector<Source> m_sources;
+		/// @brief Histograms are copied into here, so that only the
+		/// first scrape allocates it
+		LatencyHistogram::Snapshot m_scratch;
+	};
+}
+
+#endif
@@ -7,14 +7,32 @@
 
 // curl-multi-asio includes
 #include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Detail/BandwidthShaper.h>
+#include <curl-multi-asio/Detail/FanOut.h>
 #include <curl-multi-asio/Detail/Lifetime.h>
+#include <curl-multi-asio/Detail/SubmissionQueue.h>
+#include <curl-multi-asio/Detail/TimerWheel.h>
+#include <curl-multi-asio/Detail/TimingRecorder.h>
+#include <curl-multi-asio/Detail/TransferArena.h>
 #include <curl-multi-asio/Easy.h>
 #include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/FlightRecorder.h>
+#include <curl-multi-asio/LatencyHistogram.h>
+#include <curl-multi-asio/MultiStats.h>
+#include <curl-multi-asio/PerformOptions.h>
+#include <curl-multi-asio/Trace.h>
 
 // STL includes
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 template<typename T>
 concept HasExecutor = requires(T a)
@@ -28,15 +46,128 @@ namespace cma
 	/// all curl_multi calls
 	class Multi
 	{
+		// reads the instruments without copying them
+		friend class MetricsExporter;
+		// cancels and waits for its transfers on the strand
+		friend class RequestGroup;
 	private:
+		struct Instruments;
 		/// @brief These handlers store all of the handler data including
 		/// the raw socket, and the handler itself. They also handle
 		/// unregistration
 		class PerformHandlerBase
 		{
 		public:
-			PerformHandlerBase(CURL* easyHandle, CURLM* multiHandle) noexcept :
-				m_easyHandle(easyHandle), m_multiHandle(multiHandle) {}
+			/// @brief The retry state of the transfer
+			struct RetryState
+			{
+				std::shared_ptr<const RetryPolicy> policy;
+				/// @brief The attempts started so far
+				unsigned attempts = 0;
+				/// @brief The backoff timer between attempts
+				Detail::TimerNode timer;
+			};
+			/// @brief The hedging state of the transfer. Its buffers are
+			/// allocated from the transfer's arena
+			struct HedgeState
+			{
+				/// @brief The sockets one half of the transfer has opened,
+				/// so that those cURL closes without a word can be found
+				/// when that half is stopped
+				struct Sockets
+				{
+					explicit Sockets(std::pmr::memory_resource* resource) noexcept :
+						opened(resource) {}
+
+					Multi* multi = nullptr;
+					std::pmr::vector<curl_socket_t> opened;
+				};
+
+				explicit HedgeState(std::pmr::memory_resource* resource) noexcept :
+					body(resource), primaryHeaders(resource), headers(resource),
+					primarySockets(resource), sockets(resource) {}
+
+				std::shared_ptr<HedgePolicy> policy;
+				/// @brief When the transfer started
+				std::chrono::steady_clock::time_point start;
+				/// @brief The timer that launches the hedge
+				Detail::TimerNode timer;
+				/// @brief The duplicate, while it is running
+				std::unique_ptr<Easy> duplicate;
+				/// @brief What the duplicate has received so far
+				std::pmr::string body;
+				/// @brief The headers the original and the duplicate have
+				/// received, while the header callback is held back
+				std::pmr::string primaryHeaders;
+				std::pmr::string headers;
+				/// @brief Whether the header callback is held back
+				bool holdsHeaders = false;
+				/// @brief The sockets the original and the duplicate have opened
+				Sockets primarySockets;
+				Sockets sockets;
+				/// @brief The result of the original, if it failed
+				/// while the duplicate was still running
+				std::optional<CURLcode> primaryResult;
+				/// @brief Whether the duplicate won, and its native handle
+				/// was swapped into the easy handle
+				bool won = false;
+			};
+
+			/// @brief The circuit breaker state of the transfer
+			struct BreakerState
+			{
+				std::shared_ptr<CircuitBreaker> breaker;
+				/// @brief When the current attempt started
+				std::chrono::steady_clock::time_point start;
+				/// @brief Whether or not the breaker is owed an outcome
+				bool pending = false;
+			};
+
+			/// @brief The load balancing state of the transfer
+			struct RouteState
+			{
+				std::shared_ptr<EndpointSet> endpoints;
+				/// @brief The replica of the current attempt
+				size_t index = 0;
+				/// @brief When the current attempt started
+				std::chrono::steady_clock::time_point start;
+				/// @brief Whether or not the replica still counts the attempt
+				/// as in flight
+				bool active = false;
+				/// @brief The CURLOPT_CONNECT_TO list of the current attempt
+				std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> connectTo{
+					nullptr, curl_slist_free_all };
+			};
+
+			/// @brief The time budget of the transfer
+			struct DeadlineState
+			{
+				std::optional<std::chrono::steady_clock::time_point> deadline;
+				std::optional<std::chrono::milliseconds> attemptTimeout;
+				/// @brief The timer that fails the transfer at its deadline
+				Detail::TimerNode timer;
+			};
+			/// @brief The request group of the transfer
+			struct GroupState
+			{
+				std::shared_ptr<RequestGroup> group;
+				/// @brief The neighbours of the transfer in its group's list
+				/// of started transfers, or in a batch of cancelled ones
+				PerformHandlerBase* prev = nullptr;
+				PerformHandlerBase* next = nullptr;
+				/// @brief Whether it is in its group's list
+				bool linked = false;
+			};
+
+			/// @param multi The multi handle
+			/// @param easy The easy handle
+			/// @param arena The arena the handler lives in
+			PerformHandlerBase(Multi& multi, Easy& easy, Detail::ArenaLease arena) noexcept :
+				m_multi(multi), m_instruments(multi.m_instruments), m_easy(easy),
+				m_easyHandle(easy.GetNativeHandle()), m_generation(m_instruments->
+					generations.fetch_add(1, std::memory_order_relaxed) + 1),
+				m_hedge(arena->GetResource()), m_origin(arena->GetResource()),
+				m_arena(std::move(arena)) {}
 			virtual ~PerformHandlerBase() = default;
 
 			/// @brief Completes the perform, and calls the handler. Must
@@ -45,26 +176,142 @@ namespace cma
 			/// @param e The curl error
 			virtual void Complete(error_code ec) noexcept = 0;
 
+			/// @return The multi handle performing the transfer
+			inline Multi& GetMulti() const noexcept { return m_multi; }
+			/// @return The instruments of the multi handle, which the handler
+			/// keeps alive in case it completes after the handle is gone
+			inline Instruments& GetInstruments() const noexcept { return *m_instruments; }
+			/// @return The easy handle being performed
+			inline Easy& GetEasy() const noexcept { return m_easy; }
 			/// @return The underlying easy handle
 			inline CURL* GetEasyHandle() const noexcept { return m_easyHandle; }
-			/// @return The underlying multi handle
-			inline CURLM* GetMultiHandle() const noexcept { return m_multiHandle; }
+			/// @param easyHandle The underlying easy handle, after it was swapped
+			inline void SetEasyHandle(CURL* easyHandle) noexcept { m_easyHandle = easyHandle; }
+			/// @return The generation of the transfer, which tells it apart from
+			/// the other transfers of the same easy handle
+			inline uint64_t GetGeneration() const noexcept { return m_generation; }
 			/// @return If the handler was considered handled
 			inline bool Handled() const noexcept { return m_handled; }
+			/// @return The bandwidth shaping state of the transfer
+			inline Detail::ShapedTransfer& GetShaping() noexcept { return m_shaping; }
+			/// @return The retry state of the transfer
+			inline RetryState& GetRetry() noexcept { return m_retry; }
+			/// @return The hedging state of the transfer
+			inline HedgeState& GetHedge() noexcept { return m_hedge; }
+			/// @return The circuit breaker state of the transfer
+			inline BreakerState& GetBreaker() noexcept { return m_breaker; }
+			/// @return The origin of the transfer, worked out once as it is
+			/// admitted and kept in its arena, see CircuitBreaker::GetOrigin
+			inline std::pmr::string& GetOrigin() noexcept { return m_origin; }
+			/// @return The load balancing state of the transfer
+			inline RouteState& GetRoute() noexcept { return m_route; }
+			/// @return The time budget of the transfer
+			inline DeadlineState& GetDeadline() noexcept { return m_deadline; }
+			/// @return The request group of the transfer
+			inline GroupState& GetGroup() noexcept { return m_group; }
+			/// @return The flight recorder capturing the transfer's debug
+			/// output, if any
+			inline FlightRecorder* GetRecorder() const noexcept { return m_recorder; }
+			/// @param recorder The flight recorder capturing the transfer's
+			/// debug output
+			inline void SetRecorder(FlightRecorder* recorder) noexcept { m_recorder = recorder; }
+			/// @return The arena the handler lives in, which must outlive it
+			inline Detail::ArenaLease TakeArena() noexcept { return std::move(m_arena); }
+			/// @return The arena the handler lives in
+			inline Detail::TransferArena& GetArena() const noexcept { return *m_arena; }
 		protected:
 			/// @param handled If the handle was considered handled
 			inline void SetHandled(bool handled) noexcept { m_handled = handled; }
 		private:
+			Multi& m_multi;
+			std::shared_ptr<Instruments> m_instruments;
+			Easy& m_easy;
 			CURL* m_easyHandle;
-			CURL* m_multiHandle;
+			uint64_t m_generation;
+			Detail::ShapedTransfer m_shaping;
+			RetryState m_retry;
+			HedgeState m_hedge;
+			BreakerState m_breaker;
+			std::pmr::string m_origin;
+			RouteState m_route;
+			DeadlineState m_deadline;
+			GroupState m_group;
+			FlightRecorder* m_recorder = nullptr;
+			Detail::ArenaLease m_arena;
 			bool m_handled = false;
 		};
+		/// @brief Destroys a handler in place, then gives its arena back
+		struct HandlerDeleter
+		{
+			void operator()(PerformHandlerBase* handler) const noexcept
+			{
+				auto arena = handler->TakeArena();
+				handler->~PerformHandlerBase();
+			}
+		};
+		using HandlerPtr = std::unique_ptr<PerformHandlerBase, HandlerDeleter>;
+		/// @brief Handlers that are completed together with
+		/// asio::error::operation_aborted by a single post. They are
+		/// linked through their group links, which are free once they
+		/// have left their group
+		class CompletionBatch
+		{
+		public:
+			CompletionBatch() noexcept = default;
+			CompletionBatch(CompletionBatch&& other) noexcept :
+				m_head(std::exchange(other.m_head, nullptr)),
+				m_tail(std::exchange(other.m_tail, nullptr)) {}
+			CompletionBatch& operator=(CompletionBatch&&) = delete;
+			// whatever wasn't completed is aborted by its handler
+			~CompletionBatch() noexcept { operator()(); }
+
+			/// @param handler A handler that is no longer tracked
+			void Add(HandlerPtr handler) noexcept
+			{
+				auto released = handler.release();
+				released->GetGroup().next = nullptr;
+				if (m_tail != nullptr)
+					m_tail->GetGroup().next = released;
+				else
+					m_head = released;
+				m_tail = released;
+			}
+			/// @return Whether there are no handlers in the batch
+			inline bool Empty() const noexcept { return m_head == nullptr; }
+			/// @brief Completes and destroys every handler in the batch
+			void operator()() noexcept
+			{
+				while (m_head != nullptr)
+				{
+					HandlerPtr handler(m_head);
+					m_head = m_head->GetGroup().next;
+					handler->Complete(asio::error::operation_aborted);
+				}
+				m_tail = nullptr;
+			}
+		private:
+			PerformHandlerBase* m_head = nullptr;
+			PerformHandlerBase* m_tail = nullptr;
+		};
+		/// @brief A transfer waiting in the submission queue for the strand.
+		/// It lives in the arena of its handler
+		struct Submission : Detail::SubmissionNode
+		{
+			HandlerPtr handler;
+			PerformOptions options;
+		};
+		/// @brief The maps of transfers, whose nodes come from the arena pool
+		template<typename Value>
+		using TransferMap = std::unordered_map<CURL*, Value, std::hash<CURL*>,
+			std::equal_to<CURL*>, Detail::PoolAllocator<std::pair<CURL* const, Value>>>;
+		using SocketMap = std::unordered_map<curl_socket_t, asio::ip::tcp::socket>;
 		template<typename Handler>
 		class PerformHandler : public PerformHandlerBase
 		{
 		public:
-			PerformHandler(CURL* easyHandle, CURLM* multiHandle, Handler& handler) noexcept :
-				PerformHandlerBase(easyHandle, multiHandle), m_handler(std::move(handler)) {}
+			PerformHandler(Multi& multi, Easy& easy, Handler& handler,
+				Detail::ArenaLease arena) noexcept :
+				PerformHandlerBase(multi, easy, std::move(arena)), m_handler(std::move(handler)) {}
 			~PerformHandler() noexcept
 			{
 				// abort if we haven't been handled
@@ -76,10 +323,27 @@ namespace cma
 			{
 				if (Handled() == true)
 					return;
-				// remove the handler from the multi handle
-				curl_multi_remove_handle(GetMultiHandle(), GetEasyHandle());
+				// the multi handle may be gone by now, so only the state the
+				// handler shares with it is touched from here on.
+				// the handle can be performed again from the handler
+				GetEasy().m_transferState.value.store(Easy::TransferState::Idle,
+					std::memory_order_release);
+				auto& instruments = GetInstruments();
+				auto sink = instruments.traceSink.load(std::memory_order_acquire);
+				auto& outcome = (ec == asio::error::operation_aborted) ? instruments.cancelled :
+					(ec) ? instruments.failed : instruments.completed;
+				outcome.fetch_add(1, std::memory_order_relaxed);
+				const auto start = std::chrono::steady_clock::now();
+				if (sink != nullptr)
+					sink->OnEvent({ TraceEventType::HandlerBegin, start, &GetEasy() });
 				m_handler(ec);
 				SetHandled(true);
+				FinishGroupMember(*this, ec);
+				const auto end = std::chrono::steady_clock::now();
+				instruments.handlers.Record(
+					std::chrono::duration_cast<std::chrono::microseconds>(end - start));
+				if (sink != nullptr)
+					sink->OnEvent({ TraceEventType::HandlerEnd, end, &GetEasy() });
 			}
 		private:
 			Handler m_handler;
@@ -107,7 +371,7 @@ namespace cma
 		/// @brief Cancels any outstanding operations, and destroys handles.
 		/// If CMA_MANAGE_CURL is specified when the library is built and
 		/// this is the only instance of Multi, curl_global_cleanup will be called
-		~Multi() noexcept { cma::error_code ignored; Cancel(ignored); }
+		~Multi() noexcept;
 		// we don't allow copies, because multi handles can't be duplicated.
 		// there's not even a reason to do so, multi handles don't really hold
 		// much of a state themselves besides stuff that shouldn't be duplicated
@@ -140,51 +404,277 @@ namespace cma
 		template<typename CompletionToken>
 		auto AsyncPerform(Easy& easyHandle, CompletionToken&& token)
 		{
-			auto initiation = [this](auto&& handler, Easy& easy)
+			return AsyncPerform(easyHandle, PerformOptions{},
+				std::forward<CompletionToken>(token));
+		}
+		/// @brief Launches an asynchronous perform operation with per-transfer
+		/// options, and notifies the completion token either on error or success.
+		/// The same rules as the regular AsyncPerform apply
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandle The easy handle to perform the action on
+		/// @param options The options for this transfer
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerform(Easy& easyHandle, const PerformOptions& options,
+			CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, Easy& easy,
+				const PerformOptions& options)
 			{
-				// do this in a strand so that curl can't be accessed concurrently
-				asio::post(m_executor, asio::bind_executor(m_strand,
-					[this, handler = std::move(handler), &easy]() mutable
-				{
-					// set the open and close socket functions. this allows
-					// us to make them asio sockets for async functionality
-					easy.SetOption(CURLoption::CURLOPT_OPENSOCKETFUNCTION, &Multi::OpenSocketCb);
-					easy.SetOption(CURLoption::CURLOPT_OPENSOCKETDATA, this);
-					easy.SetOption(CURLoption::CURLOPT_CLOSESOCKETFUNCTION, &Multi::CloseSocketCb);
-					easy.SetOption(CURLoption::CURLOPT_CLOSESOCKETDATA, this);
-					// store the handler
-					auto performHandler = std::make_unique<PerformHandler<
-						typename std::decay_t<decltype(handler)>>>(
-							easy.GetNativeHandle(), GetNativeHandle(), handler);
-					// track the socket and initiate the transfer. if this fails
-					if (auto res = curl_multi_add_handle(GetNativeHandle(),
-						easy.GetNativeHandle()); res != CURLM_OK)
-						return performHandler->Complete(res);
-					// track the handler
-					m_easyHandlerMap.emplace(easy.GetNativeHandle(), std::move(performHandler));
-				}));
+				Trace(TraceEventType::Enqueue, &easy);
+				m_instruments->queued.fetch_add(1, std::memory_order_relaxed);
+				auto performHandler = MakeHandler(easy, handler);
+				// published along with the state, for Cancel to find the transfer by
+				auto& state = easy.m_transferState;
+				state.handle.store(easy.GetNativeHandle(), std::memory_order_relaxed);
+				state.generation.store(performHandler->GetGeneration(), std::memory_order_relaxed);
+				state.value.store(Easy::TransferState::Active, std::memory_order_release);
+				// the transfer is started in the strand so that curl can't be
+				// accessed concurrently
+				Submit(std::move(performHandler), options);
 			};
 			return asio::async_initiate<CompletionToken,
-				void(error_code)>(initiation, token, std::ref(easyHandle));
+				void(error_code)>(initiation, token, std::ref(easyHandle), options);
+		}
+		/// @brief Performs every easy handle, and notifies the completion token
+		/// once all of them have completed. The same rules as the AsyncPerformAll
+		/// with options apply
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandles The easy handles to perform
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerformAll(std::span<Easy> easyHandles, CompletionToken&& token)
+		{
+			return AsyncPerformAll(easyHandles, PerformOptions{},
+				std::forward<CompletionToken>(token));
+		}
+		/// @brief Performs every easy handle, and notifies the completion token
+		/// once all of them have completed. The completion token signature is
+		/// void(error_code, std::vector<error_code>), with the error of the
+		/// first handle that failed, and the error of each handle in order
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandles The easy handles to perform
+		/// @param options The options for each transfer
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerformAll(std::span<Easy> easyHandles, const PerformOptions& options,
+			CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, std::span<Easy> easies,
+				const PerformOptions& options)
+			{
+				using Handler = typename std::decay_t<decltype(handler)>;
+				StartFanOut(*new Detail::FanOutAll<Handler>(handler, easies.size()),
+					easies, options);
+			};
+			return asio::async_initiate<CompletionToken, void(error_code,
+				std::vector<error_code>)>(initiation, token, easyHandles, options);
+		}
+		/// @brief Performs the easy handles until one of them succeeds, and
+		/// cancels the rest right away. The same rules as the AsyncPerformAny
+		/// with options apply
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandles The easy handles to perform
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerformAny(std::span<Easy> easyHandles, CompletionToken&& token)
+		{
+			return AsyncPerformAny(easyHandles, PerformOptions{},
+				std::forward<CompletionToken>(token));
+		}
+		/// @brief Performs the easy handles until one of them succeeds, and
+		/// cancels the rest right away. The completion token is notified once
+		/// every transfer has completed, so that the easy handles are free,
+		/// and its signature is void(error_code, size_t), with the index of
+		/// the first handle to succeed. If none did, the error is
+		/// Error::QuorumNotReached and the index is the number of handles.
+		/// PerformOptions::group is replaced by a group of the transfers
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandles The easy handles to perform
+		/// @param options The options for each transfer
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerformAny(std::span<Easy> easyHandles, const PerformOptions& options,
+			CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, std::span<Easy> easies,
+				const PerformOptions& options)
+			{
+				using Handler = typename std::decay_t<decltype(handler)>;
+				StartFanOut(*new Detail::FanOutAny<Handler>(handler, easies.size()),
+					easies, options);
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, size_t)>(initiation, token, easyHandles, options);
+		}
+		/// @brief Performs the easy handles until a quorum of them succeeds,
+		/// and cancels the rest right away. The same rules as the
+		/// AsyncPerformQuorum with options apply
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandles The easy handles to perform
+		/// @param quorum The number of handles that have to succeed
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerformQuorum(std::span<Easy> easyHandles, size_t quorum,
+			CompletionToken&& token)
+		{
+			return AsyncPerformQuorum(easyHandles, quorum, PerformOptions{},
+				std::forward<CompletionToken>(token));
+		}
+		/// @brief Performs the easy handles until a quorum of them succeeds,
+		/// and cancels the rest right away, or until the quorum can't be
+		/// reached anymore. The completion token is notified once every
+		/// transfer has completed, so that the easy handles are free, and
+		/// its signature is void(error_code, std::vector<error_code>), with
+		/// Error::QuorumNotReached if too few succeeded, and the error of each
+		/// handle in order, asio::error::operation_aborted for those cut short.
+		/// PerformOptions::group is replaced by a group of the transfers
+		/// @tparam CompletionToken The completion token type
+		/// @param easyHandles The easy handles to perform
+		/// @param quorum The number of handles that have to succeed
+		/// @param options The options for each transfer
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerformQuorum(std::span<Easy> easyHandles, size_t quorum,
+			const PerformOptions& options, CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, std::span<Easy> easies,
+				size_t quorum, const PerformOptions& options)
+			{
+				using Handler = typename std::decay_t<decltype(handler)>;
+				StartFanOut(*new Detail::FanOutQuorum<Handler>(handler, easies.size(),
+					quorum), easies, options);
+			};
+			return asio::async_initiate<CompletionToken, void(error_code,
+				std::vector<error_code>)>(initiation, token, easyHandles, quorum, options);
 		}
 		/// @brief Cancels all outstanding asynchronous operations,
 		/// and calls handlers with asio::error::operation_aborted.
 		/// The easy handles must stay in scope until their handlers
-		/// have been called.
-		/// @param ec The error code output
+		/// have been called. This may be called from any thread, the
+		/// operations are cancelled in the strand, right away if this
+		/// is called from it
+		/// @param ec The error code output, which is cleared
 		/// @param error The error to send to all open handlers
-		/// @return The number of asynchronous operations canceled
+		/// @return The number of asynchronous operations outstanding
+		/// when they were cancelled
 		size_t Cancel(cma::error_code& ec,
 			CURLMcode error = CURLMcode::CURLM_OK) noexcept;
 		/// @brief Cancels the outstanding asynchronous operation,
 		/// and calls the handler with asio::error::operation_aborted.
 		/// The easy handle must stay in scope until its handler has
-		/// been called
+		/// been called. This may be called from any thread. It flips
+		/// the transfer's state without locking, and the transfer is
+		/// cancelled in the strand, right away if this is called from it.
+		/// Only the call itself touches the easy handle, so the handle
+		/// may be destroyed once the handler has been called even if the
+		/// strand hasn't gotten to the cancel yet
 		/// @param easy The easy handle
 		/// @param error Te error to send to all open handlers
-		/// @return Whether or not the handler was canceled
+		/// @return Whether or not the transfer was outstanding. It is
+		/// canceled unless it completes before the strand gets to it
 		bool Cancel(const Easy& easy, CURLMcode error = CURLMcode::CURLM_OK) noexcept;
 
+		/// @brief Limits the total bandwidth of every transfer on this handle.
+		/// CURLOPT_MAX_RECV_SPEED_LARGE and CURLOPT_MAX_SEND_SPEED_LARGE only
+		/// apply to a single transfer, while this limit is shared among all of
+		/// them by their PerformOptions::weight. Transfers are paused when they
+		/// use up their share and unpaused when the next interval starts, all
+		/// from a single timer. Shaped transfers have their
+		/// CURLOPT_XFERINFOFUNCTION, CURLOPT_XFERINFODATA and
+		/// CURLOPT_NOPROGRESS replaced while they run, and cleared when they
+		/// complete, so a progress callback of your own has to be set again
+		/// before the easy handle is performed again. The limit only
+		/// applies to transfers started after it was set, and a rate of 0
+		/// removes the limit for that direction
+		/// @param limit The limit
+		void SetBandwidthLimit(const BandwidthLimit& limit) noexcept;
+
+		/// @brief Gets the timing breakdown of every transfer this handle
+		/// completed, cancelled ones aside. Each transfer is recorded once as
+		/// it completes, with the timings of its last attempt. This can be
+		/// called from any thread
+		/// @return The timings
+		inline TransferTimings GetTimings() const
+		{
+			return m_instruments->timings.GetTimings();
+		}
+		/// @brief Gets the timing breakdown of the completed transfers to
+		/// each origin, see CircuitBreaker::GetOrigin. A transfer counts
+		/// towards the origin of the URL it was started with, even if it was
+		/// redirected. This can be called from any thread
+		/// @return The timings of each origin
+		inline std::unordered_map<std::string, TransferTimings> GetOriginTimings() const
+		{
+			return m_instruments->timings.GetOriginTimings();
+		}
+		/// @brief Gets how responsive the handle's strand has been. Alert
+		/// on the ready delay and timer lag, which grow when completion
+		/// handlers or cURL callbacks run long. This can be called from
+		/// any thread
+		/// @return The health of the strand
+		LoopHealth GetLoopHealth() const;
+		/// @brief Gets what the handle is doing and has done. The counters
+		/// are read one at a time without entering the strand, so they
+		/// may be slightly out of step with each other. This can be
+		/// called from any thread
+		/// @return The statistics
+		MultiStats GetStats() const noexcept;
+		/// @brief Sends the lifecycle events of every transfer to a sink, see
+		/// TraceEventType. Without a sink, tracing costs a single load and
+		/// branch per event. This can be called from any thread, and the sink
+		/// must stay alive until it is replaced and the events already
+		/// underway have been delivered, or until the handle is destroyed.
+		/// Transfers that complete after that aren't traced
+		/// @param sink The sink, or nullptr to stop tracing
+		inline void SetTraceSink(TraceSink* sink) noexcept
+		{
+			m_instruments->traceSink.store(sink, std::memory_order_release);
+		}
+		/// @return The trace sink, if any
+		inline TraceSink* GetTraceSink() const noexcept
+		{
+			return m_instruments->traceSink.load(std::memory_order_acquire);
+		}
+		/// @brief Captures the debug output of every transfer started from
+		/// now on into a flight recorder. Those transfers have
+		/// CURLOPT_VERBOSE, CURLOPT_DEBUGFUNCTION and CURLOPT_DEBUGDATA
+		/// replaced while they run, and put back when they complete. A debug
+		/// callback set through Easy::SetOption with CURLOPT_VERBOSE on is
+		/// still called after the recorder has the event, but verbose output
+		/// of your own without one is not written to stderr while recorded.
+		/// This can be called from any thread, and the recorder must stay
+		/// alive until the transfers started with it have completed
+		/// @param recorder The recorder, or nullptr to stop capturing
+		inline void SetFlightRecorder(FlightRecorder* recorder) noexcept
+		{
+			m_instruments->flightRecorder.store(recorder, std::memory_order_release);
+		}
+		/// @brief Turns batching of submissions on or off. A batch is started in
+		/// a single turn of the strand, which holds up the socket events
+		/// behind a burst of submissions. Without batching, each submission
+		/// is posted to the strand on its own and interleaves with them, at
+		/// the cost of a post each, and Cancel(ec) no longer aborts the ones
+		/// that haven't reached the strand. Batching is on by default. This
+		/// can be called from any thread
+		/// @param batching Whether or not to batch submissions
+		inline void SetSubmissionBatching(bool batching) noexcept
+		{
+			m_instruments->batchSubmissions.store(batching, std::memory_order_relaxed);
+		}
+		/// @return The flight recorder, if any
+		inline FlightRecorder* GetFlightRecorder() const noexcept
+		{
+			return m_instruments->flightRecorder.load(std::memory_order_acquire);
+		}
+
 		/// @brief Sets a multi option
 		/// @tparam T The option value type
 		/// @param option The option
@@ -207,6 +697,12 @@ namespace cma
 		/// @return The socket
 		static curl_socket_t OpenSocketCb(Multi* clientp, curlsocktype purpose,
 			curl_sockaddr* address) noexcept;
+		/// @brief Opens an asio socket for one half of a hedged transfer,
+		/// and notes it down. For a description of arguments, check cURL
+		/// documentation for CURLOPT_OPENSOCKETFUNCTION
+		/// @return The socket
+		static curl_socket_t HedgeOpenSocketCb(PerformHandlerBase::HedgeState::Sockets* clientp,
+			curlsocktype purpose, curl_sockaddr* address) noexcept;
 		/// @brief The socket callback called by cURL when a socket should
 		/// read, write, or be destroyed. For a description of arguments,
 		/// check cURL documentation for CURLMOPT_SOCKETFUNCTION
@@ -218,24 +714,308 @@ namespace cma
 		/// CURLMOPT_TIMERFUNCTION
 		/// @return 0 on success, 1 on failure
 		static int TimerCallback(CURLM* multi, long timeout_ms, Multi* userp) noexcept;
+		/// @brief Records debug output into the flight recorder of a
+		/// transfer, then passes it on to the debug callback of its easy
+		/// handle, if any. For a description of arguments, check cURL
+		/// documentation for CURLOPT_DEBUGFUNCTION
+		/// @return 0
+		static int DebugCallback(CURL* easy, curl_infotype type, char* data,
+			size_t size, PerformHandlerBase* handler) noexcept;
 
+		/// @brief Prepares the easy handle and adds it to the multi handle.
+		/// Must be called from within the strand
+		/// @param easy The easy handle
+		/// @param handler The handler of the transfer
+		/// @param options The options of the transfer
+		void StartTransfer(Easy& easy, HandlerPtr handler,
+			const PerformOptions& options) noexcept;
+		/// @brief Submits every transfer of a fan-out, giving it a group to
+		/// cancel them with if it cuts them short. The fan-out lets go of
+		/// itself in a post, so its handler is never called from in here
+		/// @param fanOut The fan-out, which deletes itself once it is done
+		/// @param easies The easy handles of the transfers
+		/// @param options The options for each transfer
+		void StartFanOut(Detail::FanOutBase& fanOut, std::span<Easy> easies,
+			PerformOptions options);
+		/// @brief Runs a function on the strand, right away if this is called
+		/// from it, unless the handle is destroyed before the strand gets to it
+		/// @tparam Function The function type
+		/// @param function The function
+		template<typename Function>
+		void Dispatch(Function&& function)
+		{
+			asio::dispatch(m_strand, [instruments = m_instruments,
+				function = std::forward<Function>(function)]() mutable
+				{
+					if (instruments->closed.load(std::memory_order_acquire) == false)
+						function();
+				});
+		}
+		/// @brief Queues a function for the strand, which is dropped if the
+		/// handle is destroyed before the strand gets to it
+		/// @tparam Function The function type
+		/// @param function The function
+		template<typename Function>
+		void Post(Function&& function)
+		{
+			asio::post(m_executor, asio::bind_executor(m_strand, [instruments = m_instruments,
+				function = std::forward<Function>(function)]() mutable
+				{
+					if (instruments->closed.load(std::memory_order_acquire) == false)
+						function();
+				}));
+		}
+		/// @brief Queues a transfer to be started on the strand, which may
+		/// be from any thread. Only the first submission of a batch posts
+		/// to the strand, and the rest are picked up along with it, unless
+		/// batching is off
+		/// @param handler The handler of the transfer
+		/// @param options The options of the transfer
+		void Submit(HandlerPtr handler, const PerformOptions& options);
+		/// @brief Starts every transfer in the submission queue. Must be
+		/// called from within the strand
+		void DrainSubmissions() noexcept;
+		/// @brief Cancels every transfer, started or queued. Must be called
+		/// from within the strand, or when nothing else uses the handle
+		void CancelAll() noexcept;
+		/// @brief Cancels every started transfer of a group, and completes
+		/// them all with a single post. Must be called from within the strand
+		/// @param group The group
+		void CancelGroup(RequestGroup& group) noexcept;
+		/// @brief Counts a completed transfer out of its group, if it has one,
+		/// and settles the group if it was the last one outstanding. It goes
+		/// through the group alone, as the handle may be gone
+		/// @param handler The handler of the transfer
+		/// @param ec The error code the transfer completed with
+		static void FinishGroupMember(PerformHandlerBase& handler, const error_code& ec) noexcept;
+		/// @brief Cancels a transfer that was asked to cancel, if it hasn't
+		/// completed since. Must be called from within the strand
+		/// @param easy The native handle the transfer was submitted with
+		/// @param generation The generation of the transfer
+		void CancelTransfer(CURL* easy, uint64_t generation) noexcept;
+		/// @brief Creates the handler of a transfer in an arena from the pool,
+		/// which carries all of its state until it is destroyed
+		/// @tparam Handler The completion handler type
+		/// @param easy The easy handle
+		/// @param handler The completion handler, which is moved from
+		/// @return The handler of the transfer
+		template<typename Handler>
+		HandlerPtr MakeHandler(Easy& easy, Handler& handler)
+		{
+			using Type = PerformHandler<std::decay_t<Handler>>;
+			auto arena = m_arenas->Acquire();
+			auto memory = arena->GetResource()->allocate(sizeof(Type), alignof(Type));
+			return HandlerPtr(new (memory) Type(*this, easy, handler, std::move(arena)));
+		}
+		/// @brief Releases all of the state tracked for a transfer that is
+		/// leaving the handler map, before its handler is completed
+		/// @param handler The handler of the transfer
+		void Untrack(PerformHandlerBase& handler) noexcept;
+		/// @brief Schedules the bandwidth shaper's next interval on the timer
+		/// wheel if it isn't already
+		void StartShaper() noexcept;
+		/// @brief Starts the bandwidth shaper's next interval. Called by its
+		/// interval timer
+		/// @param context The multi handle
+		static void ShaperTimerCb(void* context) noexcept;
+		/// @brief Schedules a timer on the timer wheel shared by every
+		/// transfer. Must be called from within the strand
+		/// @param node The timer
+		/// @param delay How long until it expires
+		void ScheduleTimer(Detail::TimerNode& node,
+			std::chrono::steady_clock::duration delay) noexcept;
+		/// @brief Makes sure the asio timer driving the timer wheel
+		/// wakes up in time for the next timer
+		void ArmTimerWheel() noexcept;
+		/// @brief Asks the circuit breaker of a transfer, if any, whether
+		/// an attempt may start
+		/// @param handler The handler of the transfer
+		/// @return Whether or not the attempt may start
+		bool AdmitAttempt(PerformHandlerBase& handler) noexcept;
+		/// @brief Tells the circuit breaker of a transfer, if any, how
+		/// an attempt went
+		/// @param handler The handler of the transfer
+		/// @param result The result of the attempt
+		void RecordAttempt(PerformHandlerBase& handler, CURLcode result) noexcept;
+		/// @brief Picks the replica of an attempt, if the transfer is load
+		/// balanced, and routes the easy handle to it
+		/// @param handler The handler of the transfer
+		void RouteAttempt(PerformHandlerBase& handler) noexcept;
+		/// @brief Tells the replica of an attempt, if any, that it's done
+		/// @param handler The handler of the transfer
+		/// @param result The result of the attempt, or nothing if it was cancelled
+		void FinishRoute(PerformHandlerBase& handler,
+			std::optional<CURLcode> result) noexcept;
+		/// @brief Gives an attempt whatever is left of the transfer's time
+		/// budget as its CURLOPT_TIMEOUT_MS
+		/// @param handler The handler of the transfer
+		/// @return Whether or not there was any time left
+		bool BudgetAttempt(PerformHandlerBase& handler) noexcept;
+		/// @brief Checks whether a finished attempt should be retried, and
+		/// if so takes it out of the multi handle and schedules the next one
+		/// @param handler The handler of the transfer
+		/// @param result The result of the attempt
+		/// @return Whether or not the transfer will be retried
+		bool RetryTransfer(PerformHandlerBase& handler, CURLcode result) noexcept;
+		/// @brief Finds the handler of a transfer by its native handle, which
+		/// may be the handle of a hedge
+		/// @param easy The native handle
+		/// @return The handler, or nullptr if it isn't tracked
+		PerformHandlerBase* FindHandler(CURL* easy) const noexcept;
+		/// @brief Settles a transfer that finished while it was hedged. If the
+		/// duplicate succeeded, it replaces the original, and if one failed
+		/// while the other is still running, the other keeps going
+		/// @param handler The handler of the transfer
+		/// @param easy The native handle that finished
+		/// @param result The result, replaced if the original failed first
+		/// @return Whether or not the transfer is still running
+		bool ResolveHedge(PerformHandlerBase& handler, CURL* easy,
+			CURLcode& result) noexcept;
+		/// @brief Stops and destroys the duplicate of a transfer, if any
+		/// @param handler The handler of the transfer
+		/// @param finished Whether cURL already reported the duplicate as done
+		void DropHedge(PerformHandlerBase& handler, bool finished = false) noexcept;
+		/// @brief Gives the header callback held back from a hedged transfer
+		/// its easy handle again, and the headers of the attempt that completed
+		/// @param handler The handler of the transfer
+		void ReleaseHeaders(PerformHandlerBase& handler) noexcept;
+		/// @brief The header callback of a hedged transfer's halves while
+		/// the easy handle's own is held back. For a description of each
+		/// argument, check cURL docs for CURLOPT_HEADERFUNCTION
+		/// @return The number of bytes taken care of
+		static size_t HedgeHeaderCb(char* buffer, size_t size, size_t nitems,
+			std::pmr::string* headers) noexcept;
+		/// @brief Stops tracking a socket without closing its descriptor,
+		/// which cURL closed already, or which is another socket's by now
+		/// @param socketIt The socket
+		/// @return The socket after it
+		SocketMap::iterator ForgetSocket(SocketMap::iterator socketIt) noexcept;
+		/// @brief Stops tracking the sockets one half of a hedged transfer
+		/// opened whose descriptors were closed. cURL doesn't call
+		/// CloseSocketCb for the connection of a transfer that is removed
+		/// while it is still connecting, so this is needed after stopping
+		/// that half. Those it kept open for a connection that is still
+		/// cached are left alone
+		/// @param sockets The sockets of the half
+		void ForgetClosedSockets(PerformHandlerBase::HedgeState::Sockets& sockets) noexcept;
+		/// @brief Launches the duplicate of a transfer that has been running
+		/// longer than its hedge delay. Called by its hedge timer
+		/// @param context The handler of the transfer
+		static void HedgeTimerCb(void* context) noexcept;
+		/// @brief Adds a transfer that was waiting to be retried back
+		/// to the multi handle. Called by its backoff timer
+		/// @param context The handler of the transfer
+		static void RetryTimerCb(void* context) noexcept;
+		/// @brief Fails a transfer whose deadline passed, wherever it is.
+		/// Called by its deadline timer
+		/// @param context The handler of the transfer
+		static void DeadlineTimerCb(void* context) noexcept;
+		/// @brief Takes a tracked transfer out of the handler map and
+		/// completes it with an error
+		/// @param handler The handler of the transfer
+		/// @param ec The error
+		void FailTransfer(PerformHandlerBase& handler, const error_code& ec) noexcept;
+		/// @brief Sends an event to the trace sink, if any
+		/// @param type The type of event
+		/// @param transfer The easy handle of the transfer, if any
+		/// @param socket The socket, if any
+		/// @param result The result, if any
+		/// @param time When it happened, or now if it isn't set
+		void Trace(TraceEventType type, const Easy* transfer,
+			curl_socket_t socket = CURL_SOCKET_BAD, CURLcode result = CURLE_OK,
+			std::chrono::steady_clock::time_point time = {}) const noexcept;
+		/// @brief Traces when the connection and first byte of a finished
+		/// attempt happened, from cURL's timings of it
+		/// @param transfer The easy handle of the transfer
+		/// @param easy The native handle of the attempt
+		/// @param done When it finished
+		void TraceTimings(const Easy* transfer, CURL* easy,
+			std::chrono::steady_clock::time_point done) const noexcept;
 		/// @brief Checks the handle for completed handles and calls any
 		/// completion handlers for finished transfers, before removing them
-		void CheckTransfers() noexcept;
+		/// @return The number of transfers completed
+		size_t CheckTransfers() noexcept;
+		/// @brief Calls curl_multi_socket_action and completes whatever
+		/// transfers it finished, as one turn of the strand. Cancels
+		/// everything if cURL fails
+		/// @param s The socket, or CURL_SOCKET_TIMEOUT
+		/// @param what The events on the socket
+		/// @return The number of transfers still running, or nothing if
+		/// cURL failed
+		std::optional<int> SocketAction(curl_socket_t s, int what) noexcept;
+		/// @brief Waits for a socket to be ready, and handles it on the strand
+		/// @param socket The socket
+		/// @param s The native socket
+		/// @param what CURL_POLL_IN or CURL_POLL_OUT
+		void WaitSocket(asio::ip::tcp::socket& socket, curl_socket_t s,
+			int what) noexcept;
 		/// @brief Handles socket events for reads and writes
 		/// @param ec The error code
 		/// @param s The socket
 		/// @param what The type of event
+		/// @param ready When the socket was ready
 		void EventCallback(const cma::error_code& ec, curl_socket_t s,
-			int what, int* last) noexcept;
+			int what, std::chrono::steady_clock::time_point ready) noexcept;
 		asio::any_io_executor m_executor;
 #ifdef CMA_MANAGE_CURL
 		Detail::Lifetime s_lifetime;
 #endif
+		// the arenas transfers live in, and the nodes of the maps below
+		std::shared_ptr<Detail::ArenaPool> m_arenas;
+		// the transfers submitted but not started yet. it is on the heap
+		// so that the handle can still be moved
+		std::unique_ptr<Detail::SubmissionQueue> m_submissions;
 		// when the handlers are destructed, their curl handle must be untracked
-		std::unordered_map<CURL*, std::unique_ptr<PerformHandlerBase>> m_easyHandlerMap;
-		std::unordered_map<curl_socket_t, asio::ip::tcp::socket> m_easySocketMap;
+		TransferMap<HandlerPtr> m_easyHandlerMap;
+		// the duplicates of hedged transfers, to the handler of their original
+		TransferMap<PerformHandlerBase*> m_hedgeMap;
+		// the tracked transfers keyed by the native handle of a hedge that won,
+		// rather than the one they were submitted with
+		size_t m_swappedTransfers = 0;
+		SocketMap m_easySocketMap;
+		// the last action cURL wanted on each socket
+		std::unordered_map<curl_socket_t, int> m_socketActions;
 		asio::system_timer m_timer;
+		Detail::BandwidthShaper m_shaper;
+		Detail::TimerNode m_shaperNode;
+		Detail::TimerWheel m_timerWheel;
+		asio::steady_timer m_timerWheelTimer;
+		std::optional<std::chrono::steady_clock::time_point> m_timerWheelArmedFor;
+		/// @brief What the handle measures about itself. It is on the heap so
+		/// that other threads have something stable to read, and shared with
+		/// the transfers, which may complete after the handle is gone
+		struct Instruments
+		{
+			Detail::TimingRecorder timings;
+			std::atomic<TraceSink*> traceSink = nullptr;
+			std::atomic<FlightRecorder*> flightRecorder = nullptr;
+			std::atomic<bool> batchSubmissions = true;
+			LatencyHistogram readyDelay;
+			LatencyHistogram timerLag;
+			LatencyHistogram socketAction;
+			LatencyHistogram handlers;
+			std::atomic<uint64_t> turns = 0;
+			std::atomic<uint64_t> events = 0;
+			std::atomic<uint64_t> maxEventsPerTurn = 0;
+			std::atomic<uint64_t> queued = 0;
+			std::atomic<uint64_t> inFlight = 0;
+			std::atomic<uint64_t> completed = 0;
+			std::atomic<uint64_t> failed = 0;
+			std::atomic<uint64_t> cancelled = 0;
+			std::atomic<uint64_t> openSockets = 0;
+			std::atomic<uint64_t> bytesDown = 0;
+			std::atomic<uint64_t> bytesUp = 0;
+			std::atomic<uint64_t> connectionsOpened = 0;
+			std::atomic<uint64_t> connectionsReused = 0;
+			std::atomic<uint64_t> timerRearms = 0;
+			std::atomic<bool> timerArmed = false;
+			// hands out the generation of each transfer, starting at 1
+			std::atomic<uint64_t> generations = 0;
+			// set once the handle is destroyed, so that the work it left
+			// queued for the strand knows to leave it alone
+			std::atomic<bool> closed = false;
+		};
+		std::shared_ptr<Instruments> m_instruments;
 		asio::strand<asio::any_io_executor> m_strand;
 		std::unique_ptr<CURLM, decltype(&curl_multi_cleanup)> m_nativeHandle;
 	};
@@ -0,0 +1,46 @@
+#ifndef CURLMULTIASIO_MULTISTATS_H_
+#define CURLMULTIASIO_MULTISTATS_H_
+
+/// @file
+/// Multi Statistics
+/// 10/17/26
+
+// STL includes
+#include <cstdint>
+
+namespace cma
+{
+	/// @brief What a Multi is doing and has done, see Multi::GetStats.
+	/// Every transfer ends up completed, failed or cancelled
+	struct MultiStats
+	{
+		/// @brief Transfers posted to the strand that it hasn't picked up yet
+		uint64_t queued = 0;
+		/// @brief Transfers on the handle, including those waiting to be retried
+		uint64_t inFlight = 0;
+		/// @brief Transfers whose handler was called without an error
+		uint64_t completed = 0;
+		/// @brief Transfers whose handler was called with an error, other
+		/// than being cancelled
+		uint64_t failed = 0;
+		/// @brief Transfers whose handler was called with
+		/// asio::error::operation_aborted
+		uint64_t cancelled = 0;
+		/// @brief Sockets cURL has open
+		uint64_t openSockets = 0;
+		/// @brief The bytes received by finished attempts, hedges included
+		uint64_t bytesDown = 0;
+		/// @brief The bytes sent by finished attempts, hedges included
+		uint64_t bytesUp = 0;
+		/// @brief The connections finished attempts made
+		uint64_t connectionsOpened = 0;
+		/// @brief The attempts that succeeded on a connection they reused
+		uint64_t connectionsReused = 0;
+		/// @brief The times cURL's timer or the timer wheel's timer was armed
+		uint64_t timerRearms = 0;
+		/// @brief Whether or not cURL's timer is armed
+		bool timerArmed = false;
+	};
+}
+
+#endif
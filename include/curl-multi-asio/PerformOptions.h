@@ -0,0 +1,86 @@
+#ifndef CURLMULTIASIO_PERFORMOPTIONS_H_
+#define CURLMULTIASIO_PERFORMOPTIONS_H_
+
+/// @file
+/// Per-transfer Multi Options
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/CircuitBreaker.h>
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/EndpointSet.h>
+#include <curl-multi-asio/HedgePolicy.h>
+#include <curl-multi-asio/RetryPolicy.h>
+
+// STL includes
+#include <chrono>
+#include <memory>
+#include <optional>
+
+namespace cma
+{
+	class RequestGroup;
+
+	/// @brief Options that apply to a single asynchronous perform,
+	/// on top of the options already set on the easy handle
+	struct PerformOptions
+	{
+		/// @brief The share of the Multi's bandwidth limit this transfer
+		/// gets relative to the others. Only used when a limit is set
+		double weight = 1.0;
+		/// @brief If set, failed attempts are performed again on the same
+		/// easy handle according to the policy, and the completion handler
+		/// only sees the final attempt. Anything the failed attempts wrote to
+		/// the buffer set by Easy::SetBuffer is dropped before the next one
+		std::shared_ptr<const RetryPolicy> retry;
+		/// @brief If set, the transfer is duplicated when it runs long according
+		/// to the policy, and the first of the two to succeed completes it. The
+		/// duplicate writes to a private buffer that is copied into the one set
+		/// by Easy::SetBuffer if it wins, and its native handle is swapped into
+		/// the easy handle so that GetInfo describes the winner. Transfers whose
+		/// buffer wasn't set with Easy::SetBuffer are never hedged, and neither
+		/// are requests whose method isn't GET or HEAD, as told by
+		/// CURLINFO_EFFECTIVE_METHOD. Those send a body or may not be safe to
+		/// send twice, and the duplicate would share the original's
+		/// CURLOPT_READFUNCTION. A method set with CURLOPT_CUSTOMREQUEST is
+		/// taken at its word. Nothing is hedged with cURL older than 7.72.0.
+		/// A header callback set with Easy::SetOption only gets the headers
+		/// of the attempt that completed the transfer, all at once as it
+		/// completes. One set on the native handle directly can't be held
+		/// back, and gets the headers of both
+		std::shared_ptr<HedgePolicy> hedge;
+		/// @brief If set, the transfer fails right away with Error::CircuitOpen
+		/// while the breaker has its origin's circuit open, without touching
+		/// the network, and its outcome is recorded by the breaker otherwise.
+		/// Every attempt of a retried transfer goes through the breaker
+		std::shared_ptr<CircuitBreaker> breaker;
+		/// @brief If set, each attempt of the transfer is routed to one of the
+		/// set's replicas through CURLOPT_CONNECT_TO, which replaces whatever
+		/// CURLOPT_CONNECT_TO the easy handle had, and is cleared when the
+		/// transfer completes. The Multi keeps the set's in-flight counts and
+		/// latencies up to date
+		std::shared_ptr<EndpointSet> endpoints;
+		/// @brief If set, the transfer fails with Error::DeadlineExceeded once
+		/// this time passes, including while it waits to start or to be
+		/// retried, and a transfer whose deadline passed before it started
+		/// never touches the network. Whatever is left of it when each attempt
+		/// starts becomes the attempt's CURLOPT_TIMEOUT_MS, unless the easy
+		/// handle's own timeout is shorter, and retries that couldn't start
+		/// before it aren't made
+		std::optional<std::chrono::steady_clock::time_point> deadline;
+		/// @brief If set, bounds each attempt on its own, even when the
+		/// deadline leaves it more time. When either this or the deadline is
+		/// set, each attempt's CURLOPT_TIMEOUT_MS is the shortest of them and
+		/// of the timeout set on the easy handle with Easy::SetOption, which
+		/// is put back when the transfer completes. A timeout set on the
+		/// native handle directly can't be known, and is cleared instead
+		std::optional<std::chrono::milliseconds> attemptTimeout;
+		/// @brief If set, the transfer is a member of the group, which can
+		/// cancel it along with the rest of its members, and completes its
+		/// waiters once all of them have completed. The group must have been
+		/// made for the Multi the transfer is performed on
+		std::shared_ptr<RequestGroup> group;
+	};
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef CURLMULTIASIO_REQUESTGRAPH_H_
+#define CURLMULTIASIO_REQUESTGRAPH_H_
+
+/// @file
+/// Dependent Request Graphs
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/Multi.h>
+#include <curl-multi-asio/PerformOptions.h>
+
+// expected includes
+#include <tl/expected.hpp>
+
+// STL includes
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief A caller waiting for a RequestGraph to finish
+		class GraphHandlerBase
+		{
+		public:
+			virtual ~GraphHandlerBase() = default;
+			/// @brief Calls the handler
+			/// @param ec The error code
+			virtual void Complete(error_code ec) noexcept = 0;
+		};
+		template<typename Handler>
+		class GraphHandler : public GraphHandlerBase
+		{
+		public:
+			GraphHandler(Handler& handler) noexcept : m_handler(std::move(handler)) {}
+			~GraphHandler() noexcept
+			{
+				// abort if we haven't been handled
+				if (m_handled == false)
+					Complete(asio::error::operation_aborted);
+			}
+
+			void Complete(error_code ec) noexcept
+			{
+				if (m_handled == true)
+					return;
+				m_handled = true;
+				m_handler(ec);
+			}
+		private:
+			Handler m_handler;
+			bool m_handled = false;
+		};
+	}
+
+	/// @brief RequestGraph runs a small graph of dependent requests on a
+	/// Multi, such as fetching a token, then several resources with it, and
+	/// then posting what they returned. Each node is a factory that sets up
+	/// an easy handle once every node it depends on has succeeded, from
+	/// their results. A node is performed as soon as it is ready, so
+	/// independent nodes, and separate graphs, run side by side. When a
+	/// node fails, the nodes downstream of it are never performed, and
+	/// complete with asio::error::operation_aborted, while the rest of the
+	/// graph carries on. The nodes, their edges and their response bodies
+	/// are all allocated from a single arena owned by the graph. A graph
+	/// runs once, and is shared with its transfers, so it must be made with
+	/// std::make_shared
+	class RequestGraph : public std::enable_shared_from_this<RequestGraph>
+	{
+	public:
+		using NodeId = size_t;
+		/// @brief What a node that succeeded passes to the nodes that
+		/// depend on it
+		struct Result
+		{
+			/// @brief The easy handle it was performed with
+			const Easy* easy;
+			/// @brief Its response body, unless its factory set a buffer
+			/// of its own
+			std::string_view body;
+		};
+		/// @brief Sets up the easy handle of a node. It is given the results
+		/// of the nodes the node depends on, in the order they were given in,
+		/// and the node fails with the error it returns without being performed
+		using Factory = std::function<error_code(Easy& easy, std::span<const Result> inputs)>;
+
+		/// @param multi The multi handle that performs the requests
+		/// @param options The options for each request. PerformOptions::group
+		/// is replaced by a group of the graph's requests
+		explicit RequestGraph(Multi& multi, PerformOptions options = {});
+		RequestGraph(const RequestGraph&) = delete;
+		RequestGraph& operator=(const RequestGraph&) = delete;
+
+		/// @brief Adds a node. Nodes can only depend on nodes added before
+		/// them, so the graph can't have cycles. Nodes can't be added once
+		/// the graph was run
+		/// @param factory The factory of the node
+		/// @param dependencies The nodes it depends on
+		/// @return The node, or asio::error::invalid_argument if it depends
+		/// on a node that doesn't exist, or asio::error::already_started
+		tl::expected<NodeId, error_code> AddNode(Factory factory,
+			std::initializer_list<NodeId> dependencies = {});
+		/// @brief Runs the graph, and notifies the completion token once
+		/// every node has either completed or been skipped. The completion
+		/// token signature is void(error_code), with the error of the first
+		/// node that failed. The graph can only be run once, and running it
+		/// again fails with asio::error::already_started
+		/// @tparam CompletionToken The completion token type
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncRun(CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler)
+			{
+				Run(std::make_unique<Detail::GraphHandler<
+					typename std::decay_t<decltype(handler)>>>(handler));
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code)>(initiation, token);
+		}
+		/// @brief Cancels the requests in flight, and skips the nodes that
+		/// haven't started. A graph cancelled before it runs skips every node
+		/// once it does. This can be called from any thread
+		void Cancel() noexcept;
+
+		/// @param node The node
+		/// @return The result of the node, which is only valid once the graph
+		/// has finished, and if the node succeeded
+		Result GetResult(NodeId node) const noexcept;
+		/// @param node The node
+		/// @return The error the node completed with, which is only valid once
+		/// the graph has finished
+		error_code GetError(NodeId node) const noexcept;
+	private:
+		/// @brief Where a node is at
+		enum class NodeState
+		{
+			Waiting,
+			Running,
+			Done
+		};
+		/// @brief A node and its edges
+		struct Node
+		{
+			Node(Factory factory, std::pmr::memory_resource* arena) :
+				factory(std::move(factory)), dependencies(arena), dependents(arena),
+				body(arena) {}
+
+			Factory factory;
+			std::pmr::vector<NodeId> dependencies;
+			std::pmr::vector<NodeId> dependents;
+			/// @brief The dependencies that haven't succeeded yet
+			size_t waiting = 0;
+			NodeState state = NodeState::Waiting;
+			error_code ec;
+			Easy easy;
+			std::pmr::string body;
+		};
+
+		/// @brief Starts every node without dependencies
+		/// @param handler The handler of the run
+		void Run(std::unique_ptr<Detail::GraphHandlerBase> handler);
+		/// @brief Sets up a node from its inputs and performs it. Must be
+		/// called from within the strand
+		/// @param node The node
+		void Launch(NodeId node) noexcept;
+		/// @brief Records the outcome of a node, and launches the nodes it
+		/// made ready, or skips those downstream of it if it failed. Must be
+		/// called from within the strand
+		/// @param node The node
+		/// @param ec The error code it completed with
+		void Land(NodeId node, error_code ec) noexcept;
+		/// @brief Completes a node that never ran, and every node downstream
+		/// of it. Must be called from within the strand
+		/// @param node The node
+		void Skip(NodeId node) noexcept;
+		/// @brief Marks a node as done, and finishes the run after the last
+		/// one. Must be called from within the strand
+		/// @param node The node
+		/// @param ec The error code it completed with
+		void Settle(NodeId node, error_code ec) noexcept;
+
+		Multi& m_multi;
+		PerformOptions m_options;
+		asio::strand<asio::any_io_executor> m_strand;
+		// everything the graph allocates comes from here, and is freed at once.
+		// it isn't synchronized, and once the graph runs, only the bodies
+		// allocate from it, as they are written on the Multi's strand
+		std::pmr::monotonic_buffer_resource m_arena;
+		// a deque, so that nodes stay put while more are added
+		std::pmr::deque<Node> m_nodes;
+		size_t m_remaining = 0;
+		bool m_started = false;
+		bool m_cancelled = false;
+		error_code m_firstError;
+		std::unique_ptr<Detail::GraphHandlerBase> m_handler;
+	};
+}
+
+#endif
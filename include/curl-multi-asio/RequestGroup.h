@@ -0,0 +1,146 @@
+#ifndef CURLMULTIASIO_REQUESTGROUP_H_
+#define CURLMULTIASIO_REQUESTGROUP_H_
+
+/// @file
+/// Request Groups
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/Multi.h>
+
+// STL includes
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief A caller waiting for a RequestGroup to finish
+		class GroupWaiterBase
+		{
+		public:
+			virtual ~GroupWaiterBase() = default;
+			/// @brief Calls the handler
+			/// @param ec The error code
+			/// @param failed The number of transfers that failed
+			virtual void Complete(error_code ec, size_t failed) noexcept = 0;
+		};
+		template<typename Handler>
+		class GroupWaiter : public GroupWaiterBase
+		{
+		public:
+			GroupWaiter(Handler& handler) noexcept : m_handler(std::move(handler)) {}
+			~GroupWaiter() noexcept
+			{
+				// abort if we haven't been handled
+				if (m_handled == false)
+					Complete(asio::error::operation_aborted, 0);
+			}
+
+			void Complete(error_code ec, size_t failed) noexcept
+			{
+				if (m_handled == true)
+					return;
+				m_handled = true;
+				m_handler(ec, failed);
+			}
+		private:
+			Handler m_handler;
+			bool m_handled = false;
+		};
+	}
+
+	/// @brief RequestGroup ties together the transfers of a fan-out, which
+	/// are tagged with it through PerformOptions::group. The whole group can
+	/// be cancelled at once, and waited on until every transfer in it has
+	/// completed. Cancelling a group is final, transfers tagged with it after
+	/// it was cancelled are aborted without starting. Every transfer of a
+	/// group must be performed on the Multi it was made for. The group may
+	/// outlive it, and settles as the Multi aborts its transfers on the way
+	/// out, but must not be used while the Multi is being destroyed. Groups
+	/// are shared with their transfers, so they must be made with
+	/// std::make_shared
+	class RequestGroup : public std::enable_shared_from_this<RequestGroup>
+	{
+	public:
+		/// @param multi The multi handle that performs the transfers
+		explicit RequestGroup(Multi& multi) noexcept :
+			m_multi(multi), m_instruments(multi.m_instruments), m_strand(multi.m_strand) {}
+		RequestGroup(const RequestGroup&) = delete;
+		RequestGroup& operator=(const RequestGroup&) = delete;
+
+		/// @brief Cancels every transfer of the group, started or not, and
+		/// calls their handlers with asio::error::operation_aborted. The
+		/// Multi aborts them all in one pass through its strand, and calls
+		/// their handlers together. This can be called from any thread
+		void Cancel() noexcept;
+		/// @brief Waits until every transfer tagged with the group so far
+		/// has completed, right away if none are outstanding. This can be
+		/// called from any thread. The completion token signature is
+		/// void(error_code, size_t). The error is asio::error::operation_aborted
+		/// if the group was cancelled, and the size is the number of its
+		/// transfers that have failed, cancelled ones included
+		/// @tparam CompletionToken The completion token type
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncWait(CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler)
+			{
+				Wait(std::make_unique<Detail::GroupWaiter<
+					typename std::decay_t<decltype(handler)>>>(handler));
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, size_t)>(initiation, token);
+		}
+
+		/// @return Whether or not the group was cancelled
+		inline bool Cancelled() const noexcept
+		{
+			return m_cancelled.load(std::memory_order_acquire);
+		}
+		/// @return The number of transfers of the group that haven't completed
+		inline size_t GetOutstanding() const noexcept
+		{
+			return m_outstanding.load(std::memory_order_relaxed);
+		}
+		/// @return The number of transfers of the group that have failed
+		inline size_t GetFailed() const noexcept
+		{
+			return m_failed.load(std::memory_order_relaxed);
+		}
+	private:
+		// links the transfers into the group, and counts them
+		friend class Multi;
+
+		/// @brief Adds a waiter, to be completed once the group has no
+		/// outstanding transfers
+		/// @param waiter The waiter
+		void Wait(std::unique_ptr<Detail::GroupWaiterBase> waiter);
+		/// @brief Completes the waiters if the group has no outstanding
+		/// transfers. Must be called from within the Multi's strand
+		void Settle() noexcept;
+
+		Multi& m_multi;
+		// tells whether the Multi is still around
+		std::shared_ptr<Multi::Instruments> m_instruments;
+		// a copy of the Multi's strand, which works without the Multi
+		asio::strand<asio::any_io_executor> m_strand;
+		std::atomic<bool> m_cancelled = false;
+		std::atomic<size_t> m_outstanding = 0;
+		std::atomic<size_t> m_failed = 0;
+		// the started transfers of the group, only touched by the Multi's strand
+		Multi::PerformHandlerBase* m_members = nullptr;
+		// the waiters, only touched by the Multi's strand
+		std::vector<std::unique_ptr<Detail::GroupWaiterBase>> m_waiters;
+	};
+}
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef CURLMULTIASIO_RESPONSECACHE_H_
+#define CURLMULTIASIO_RESPONSECACHE_H_
+
+/// @file
+/// In-Memory Response Store
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/HttpMessage.h>
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief The directives of a Cache-Control header that the cache acts on
+		struct CacheControl
+		{
+			bool noStore = false;
+			bool noCache = false;
+			std::optional<std::chrono::seconds> maxAge;
+
+			/// @brief Parses the value of a Cache-Control header. Unknown
+			/// directives are ignored
+			/// @param value The value
+			/// @return The directives
+			static CacheControl Parse(std::string_view value) noexcept;
+		};
+	}
+
+	/// @brief A stored response, along with what is needed to decide whether
+	/// it can still be used as is, or has to be revalidated first
+	struct CacheEntry
+	{
+		using Clock = std::chrono::system_clock;
+
+		ResponsePtr response;
+		/// @brief The validators, empty if the response had none
+		std::string etag;
+		std::string lastModified;
+		/// @brief When the response was received, and how old it already was
+		/// at that point, as in RFC 9111 section 4.2.3
+		Clock::time_point responseTime;
+		std::chrono::seconds initialAge{ 0 };
+		/// @brief How long the response stays fresh for after it was generated
+		std::chrono::seconds lifetime{ 0 };
+		/// @brief Whether or not the response must be revalidated every time
+		bool noCache = false;
+		/// @brief The request headers named by Vary, lowercased, and the
+		/// values they had in the request that got the response
+		std::vector<std::pair<std::string, std::string>> vary;
+
+		/// @brief Builds an entry from a response, if the response may be stored
+		/// @param request The request that got the response
+		/// @param response The response
+		/// @param requestTime When the request was sent
+		/// @param responseTime When the response was received
+		/// @return The entry, or nothing if the response must not be stored
+		static std::optional<CacheEntry> FromResponse(const HttpRequest& request,
+			ResponsePtr response, Clock::time_point requestTime,
+			Clock::time_point responseTime) noexcept;
+		/// @brief Updates the freshness of the entry from a 304 Not Modified
+		/// response to a conditional request. The stored response is kept
+		/// @param headers The raw header block of the 304 response
+		/// @param requestTime When the conditional request was sent
+		/// @param responseTime When the 304 response was received
+		void Refresh(std::string_view headers, Clock::time_point requestTime,
+			Clock::time_point responseTime) noexcept;
+		/// @param now The current time
+		/// @return The current age of the response
+		std::chrono::seconds Age(Clock::time_point now) const noexcept;
+		/// @param now The current time
+		/// @return Whether or not the response can be used without revalidating
+		bool Fresh(Clock::time_point now) const noexcept;
+		/// @param request A request for the same URL
+		/// @return Whether or not the entry was stored for a request like it,
+		/// going by the headers named by Vary
+		bool Matches(const HttpRequest& request) const noexcept;
+		/// @return Whether or not the entry can be revalidated
+		inline bool HasValidators() const noexcept
+		{
+			return etag.empty() == false || lastModified.empty() == false;
+		}
+	};
+	using CacheEntryPtr = std::shared_ptr<const CacheEntry>;
+
+	/// @brief Where an HttpCache keeps its responses. Implementations must
+	/// be thread-safe
+	class CacheStore
+	{
+	public:
+		virtual ~CacheStore() = default;
+		/// @brief Looks up an entry
+		/// @param key The key
+		/// @return The entry, or null if there is none
+		virtual CacheEntryPtr Find(std::string_view key) noexcept = 0;
+		/// @brief Stores an entry, replacing any entry with the same key
+		/// @param key The key
+		/// @param entry The entry
+		virtual void Store(std::string_view key, CacheEntryPtr entry) noexcept = 0;
+		/// @brief Replaces an entry that was revalidated. The response is the
+		/// same as the one it replaces, only its freshness changed, which lets
+		/// stores that keep responses elsewhere avoid writing them again
+		/// @param key The key
+		/// @param previous The entry that was revalidated, as it was found
+		/// @param entry The revalidated entry
+		virtual void Refresh(std::string_view key, const CacheEntry& /*previous*/,
+			CacheEntryPtr entry) noexcept
+		{
+			Store(key, std::move(entry));
+		}
+		/// @brief Removes an entry
+		/// @param key The key
+		virtual void Erase(std::string_view key) noexcept = 0;
+	};
+
+	/// @brief ResponseCache is a thread-safe, size-bounded store of responses.
+	/// Keys are hashed into shards that each have their own lock and their own
+	/// least-recently-used list, so lookups on different keys rarely contend.
+	/// Entries are charged for their key, headers, body and validators, and
+	/// the least recently used entries of a shard are evicted once it goes over
+	/// its share of the capacity. Entries are shared, so an evicted entry stays
+	/// alive for as long as someone is still using its response
+	class ResponseCache : public CacheStore
+	{
+	public:
+		/// @param capacity The number of bytes to hold at most
+		/// @param shards The number of shards
+		explicit ResponseCache(size_t capacity = 64 * 1024 * 1024, size_t shards = 16) noexcept;
+		ResponseCache(const ResponseCache&) = delete;
+		ResponseCache& operator=(const ResponseCache&) = delete;
+
+		/// @brief Looks up an entry, marking it as the most recently used
+		/// @param key The key
+		/// @return The entry, or null if there is none
+		CacheEntryPtr Find(std::string_view key) noexcept override;
+		/// @brief Stores an entry, replacing any entry with the same key. An
+		/// entry that is larger than a shard's share of the capacity is not
+		/// stored at all
+		/// @param key The key
+		/// @param entry The entry
+		void Store(std::string_view key, CacheEntryPtr entry) noexcept override;
+		/// @brief Removes an entry
+		/// @param key The key
+		void Erase(std::string_view key) noexcept override;
+		/// @brief Removes every entry
+		void Clear() noexcept;
+
+		/// @return The number of bytes held
+		size_t GetSize() const noexcept;
+		/// @return The number of entries held
+		size_t GetCount() const noexcept;
+		inline size_t GetCapacity() const noexcept { return m_capacity; }
+		/// @return The number of entries that were evicted to make room
+		inline size_t GetEvictions() const noexcept
+		{
+			return m_evictions.load(std::memory_order_relaxed);
+		}
+	private:
+		struct Node
+		{
+			std::string key;
+			CacheEntryPtr entry;
+			size_t bytes = 0;
+		};
+		struct Shard
+		{
+			mutable std::mutex mutex;
+			/// @brief The most recently used entry is at the front
+			std::list<Node> lru;
+			/// @brief Keys point into the nodes, which never move
+			std::unordered_map<std::string_view, std::list<Node>::iterator> index;
+			size_t bytes = 0;
+		};
+
+		/// @param key The key
+		/// @return The shard the key belongs to
+		Shard& GetShard(std::string_view key) noexcept;
+		/// @param key The key
+		/// @param entry The entry
+		/// @return The number of bytes an entry is charged for
+		static size_t Charge(std::string_view key, const CacheEntry& entry) noexcept;
+
+		size_t m_capacity;
+		size_t m_shardCapacity;
+		size_t m_shardCount;
+		std::unique_ptr<Shard[]> m_shards;
+		std::atomic<size_t> m_evictions = 0;
+	};
+}
+
+#endif
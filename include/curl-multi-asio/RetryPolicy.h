@@ -0,0 +1,102 @@
+#ifndef CURLMULTIASIO_RETRYPOLICY_H_
+#define CURLMULTIASIO_RETRYPOLICY_H_
+
+/// @file
+/// Retry Policy
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Error.h>
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+namespace cma
+{
+	/// @brief A token bucket that bounds how many retries a group of
+	/// requests may make, so that a struggling upstream isn't buried under
+	/// retries. Every failure that would be retried costs a token, and every
+	/// success earns back a fraction of one. Retries are only allowed while
+	/// the bucket is more than half full. It is thread safe, and is usually
+	/// shared by every policy that talks to the same upstream
+	class RetryBudget
+	{
+	public:
+		/// @param maxTokens The size of the bucket
+		/// @param tokenRatio The tokens earned back by each success
+		explicit RetryBudget(double maxTokens = 10.0, double tokenRatio = 0.1) noexcept;
+
+		/// @brief Records a successful attempt
+		void OnSuccess() noexcept;
+		/// @brief Records a failed attempt that would be retried
+		/// @return Whether or not the retry is allowed
+		bool OnFailure() noexcept;
+		/// @return The tokens currently in the bucket
+		double GetTokens() const noexcept;
+	private:
+		// tokens are stored in thousandths so they can be atomic
+		std::atomic<int64_t> m_milliTokens;
+		const int64_t m_maxMilliTokens;
+		const int64_t m_ratioMilliTokens;
+	};
+
+	/// @brief Describes when and how often a failed transfer is performed again
+	/// on the same easy handle. Transfers are retried when they fail with a
+	/// transient CURLcode, or finish with a transient HTTP status. Requests
+	/// are retried regardless of their method, so only attach a policy to
+	/// requests that are safe to repeat
+	struct RetryPolicy
+	{
+		/// @brief The most attempts made in total, including the first
+		unsigned maxAttempts = 3;
+		/// @brief The delay before the first retry, which doubles on
+		/// every retry after that
+		std::chrono::milliseconds baseDelay{ 100 };
+		/// @brief The longest delay between attempts
+		std::chrono::milliseconds maxDelay{ 10'000 };
+		/// @brief The fraction of each delay that is randomized. 1 is full
+		/// jitter, which spreads retries the most, and 0 is none
+		double jitter = 1.0;
+		/// @brief Whether or not to wait as long as a Retry-After header
+		/// on a 429 or 503 asks
+		bool honorRetryAfter = true;
+		/// @brief The longest Retry-After that will be waited for. If the
+		/// server asks for longer, the transfer is not retried
+		std::chrono::milliseconds maxRetryAfter{ 30'000 };
+		/// @brief If set, bounds the retries of every transfer that shares it
+		std::shared_ptr<RetryBudget> budget;
+		/// @brief If set, replaces the default classification. It receives the
+		/// error of the attempt and the HTTP status, which is 0 if there was none
+		std::function<bool(const error_code&, long)> isRetryable;
+
+		/// @brief The default classification. Connection failures, timeouts,
+		/// resets, and empty replies are retryable, as are HTTP 408, 429, 500,
+		/// 502, 503, and 504
+		/// @param ec The error of the attempt
+		/// @param httpStatus The HTTP status of the attempt, or 0
+		/// @return Whether or not the attempt should be retried
+		static bool IsTransient(const error_code& ec, long httpStatus) noexcept;
+		/// @brief Decides whether an attempt that just finished should be retried
+		/// @param ec The error of the attempt
+		/// @param httpStatus The HTTP status of the attempt, or 0
+		/// @param attempt The number of attempts made so far, starting at 1
+		/// @param retryAfter The Retry-After the server sent, if any
+		/// @param remaining The time left until the transfer's deadline, if it
+		/// has one. A retry that couldn't start before then isn't made, and
+		/// doesn't cost the budget anything
+		/// @return How long to wait before the next attempt, or nothing if
+		/// the transfer should complete now
+		std::optional<std::chrono::milliseconds> NextDelay(const error_code& ec,
+			long httpStatus, unsigned attempt,
+			std::optional<std::chrono::seconds> retryAfter,
+			std::optional<std::chrono::milliseconds> remaining = std::nullopt) const noexcept;
+	};
+}
+
+#endif
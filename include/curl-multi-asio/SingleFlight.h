@@ -0,0 +1,123 @@
+#ifndef CURLMULTIASIO_SINGLEFLIGHT_H_
+#define CURLMULTIASIO_SINGLEFLIGHT_H_
+
+/// @file
+/// Request Coalescing
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/HttpMessage.h>
+#include <curl-multi-asio/Multi.h>
+
+// STL includes
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cma
+{
+	/// @brief SingleFlight coalesces identical requests that are in flight at the
+	/// same time. The first request for a key starts a transfer on the Multi, and
+	/// every request for the same key that arrives before it finishes waits for
+	/// that transfer instead of starting its own. All of them receive the same
+	/// reference-counted response. Only GET and HEAD requests are coalesced, and
+	/// any other method is performed on its own, since it may change something
+	/// on the server. Requests are keyed on their method, URL, and
+	/// the values of a chosen set of headers. Headers outside of that set are
+	/// sent as the first request had them, so only choose to leave out headers
+	/// that don't change the response. The SingleFlight must stay in scope until
+	/// every handler has been called
+	class SingleFlight
+	{
+	public:
+		using Request = HttpRequest;
+		using ResponsePtr = cma::ResponsePtr;
+		/// @brief Sets any other options on the easy handle of each transfer
+		using Configure = std::function<void(Easy&)>;
+
+		/// @param multi The multi handle that performs the transfers
+		/// @param keyHeaders The names of the headers that are part of the
+		/// key, compared case insensitively
+		/// @param configure Called on each transfer's easy handle before it starts
+		SingleFlight(Multi& multi, std::vector<std::string> keyHeaders = {},
+			Configure configure = {}) noexcept;
+		SingleFlight(const SingleFlight&) = delete;
+		SingleFlight& operator=(const SingleFlight&) = delete;
+
+		/// @brief Performs a request, or joins the transfer of an identical
+		/// one that is already in flight. This can be called from multiple
+		/// threads at once. The completion token signature is
+		/// void(error_code, ResponsePtr), and the response is null on error
+		/// @tparam CompletionToken The completion token type
+		/// @param request The request
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncPerform(Request request, CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler, Request request)
+			{
+				asio::post(m_strand, [this, handler = std::move(handler),
+					request = std::move(request)]() mutable
+				{
+					Join(std::move(request), std::make_unique<Detail::ResponseHandler<
+						typename std::decay_t<decltype(handler)>>>(handler));
+				});
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, ResponsePtr)>(initiation, token, std::move(request));
+		}
+
+		/// @return The number of requests that joined a transfer that was
+		/// already in flight, instead of starting their own
+		inline size_t GetCoalesced() const noexcept
+		{
+			return m_coalesced.load(std::memory_order_relaxed);
+		}
+	private:
+		/// @brief A transfer and everyone waiting for it
+		struct Flight
+		{
+			Easy easy;
+			std::shared_ptr<SharedResponse> response;
+			std::vector<std::unique_ptr<Detail::ResponseHandlerBase>> waiters;
+		};
+
+		/// @brief Builds the key of a request
+		/// @param request The request
+		/// @return The key
+		std::string MakeKey(const Request& request) const;
+		/// @brief Adds a waiter to the flight for its request, starting the
+		/// flight if there is none. Must be called from within the strand
+		/// @param request The request
+		/// @param waiter The waiter
+		void Join(Request&& request,
+			std::unique_ptr<Detail::ResponseHandlerBase> waiter) noexcept;
+		/// @brief Completes every waiter of a flight that finished. Must be
+		/// called from within the strand
+		/// @param key The key of the flight
+		/// @param ec The result of the transfer
+		void Land(const std::string& key, error_code ec) noexcept;
+		/// @brief Completes every waiter of a flight that finished, once it
+		/// is no longer tracked. Must be called from within the strand
+		/// @param flight The flight
+		/// @param ec The result of the transfer
+		void Land(std::unique_ptr<Flight> flight, error_code ec) noexcept;
+
+		Multi& m_multi;
+		std::vector<std::string> m_keyHeaders;
+		Configure m_configure;
+		asio::strand<asio::any_io_executor> m_strand;
+		std::unordered_map<std::string, std::unique_ptr<Flight>> m_flights;
+		std::atomic<size_t> m_coalesced = 0;
+	};
+}
+
+#endif
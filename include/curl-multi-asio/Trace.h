@@ -0,0 +1,115 @@
+#ifndef CURLMULTIASIO_TRACE_H_
+#define CURLMULTIASIO_TRACE_H_
+
+/// @file
+/// Transfer Lifecycle Tracing
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+
+// STL includes
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace cma
+{
+	class Easy;
+
+	/// @brief The points in a transfer's life that are traced
+	enum class TraceEventType
+	{
+		/// @brief AsyncPerform posted the transfer to the strand
+		Enqueue,
+		/// @brief The strand picked the transfer up
+		Admit,
+		/// @brief An attempt, or a hedge, was added to the multi handle. A
+		/// hedge is traced under its own duplicate easy handle
+		Start,
+		/// @brief cURL opened a socket. Sockets aren't tied to a transfer
+		SocketOpen,
+		/// @brief cURL closed a socket. Sockets aren't tied to a transfer
+		SocketClose,
+		/// @brief The connection of an attempt was made, as cURL timed it
+		Connect,
+		/// @brief The first byte of an attempt's response arrived, as
+		/// cURL timed it
+		FirstByte,
+		/// @brief cURL reported an attempt, or a hedge, as done. A hedge
+		/// stopped before it finished, and an original stopped because its
+		/// hedge won, are done with CURLE_ABORTED_BY_CALLBACK
+		Done,
+		/// @brief The completion handler is about to be called
+		HandlerBegin,
+		/// @brief The completion handler returned
+		HandlerEnd
+	};
+
+	/// @brief A single traced event
+	struct TraceEvent
+	{
+		TraceEventType type = TraceEventType::Enqueue;
+		std::chrono::steady_clock::time_point time;
+		/// @brief The easy handle of the transfer, which identifies it,
+		/// or nullptr for socket events
+		const Easy* transfer = nullptr;
+		/// @brief The socket of socket events
+		curl_socket_t socket = CURL_SOCKET_BAD;
+		/// @brief The result of Done events
+		CURLcode result = CURLE_OK;
+	};
+
+	/// @brief Receives the events of every transfer on a Multi, see
+	/// Multi::SetTraceSink. Events are delivered from whichever thread they
+	/// happen on, so sinks must be thread safe, and they should be quick
+	class TraceSink
+	{
+	public:
+		virtual ~TraceSink() = default;
+
+		/// @brief Receives an event
+		/// @param event The event
+		virtual void OnEvent(const TraceEvent& event) noexcept = 0;
+	};
+
+	/// @brief A TraceSink that keeps the most recent events in a ring buffer,
+	/// and writes them out in the Chrome trace event format, which can be
+	/// loaded into chrome://tracing or Perfetto. Each transfer gets its own
+	/// track, with its time in the queue, its attempts and its handler as spans
+	class TraceRecorder : public TraceSink
+	{
+	public:
+		/// @param capacity The most events kept. Older ones are overwritten
+		explicit TraceRecorder(size_t capacity = 65536);
+
+		void OnEvent(const TraceEvent& event) noexcept override;
+
+		/// @brief Writes the events that are kept as Chrome trace JSON
+		/// @param out The stream to write to
+		void WriteChromeTrace(std::ostream& out) const;
+		/// @return The number of events kept
+		size_t GetSize() const noexcept;
+		/// @brief Drops every event that is kept
+		void Clear() noexcept;
+	private:
+		struct Record
+		{
+			TraceEvent event;
+			std::thread::id thread;
+		};
+
+		/// @brief When the recorder was created, which trace times are from
+		std::chrono::steady_clock::time_point m_epoch;
+		mutable std::mutex m_mutex;
+		std::vector<Record> m_records;
+		/// @brief The events ever recorded. The next one goes in at this
+		/// modulo the capacity
+		size_t m_recorded = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef CURLMULTIASIO_TRANSFERSTREAM_H_
+#define CURLMULTIASIO_TRANSFERSTREAM_H_
+
+/// @file
+/// Bounded Result Streams
+/// 10/17/26
+
+// curl-multi-asio includes
+#include <curl-multi-asio/Common.h>
+#include <curl-multi-asio/Easy.h>
+#include <curl-multi-asio/Error.h>
+#include <curl-multi-asio/Multi.h>
+#include <curl-multi-asio/PerformOptions.h>
+
+// STL includes
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace cma
+{
+	namespace Detail
+	{
+		/// @brief A caller waiting for the next result of a TransferStream
+		class StreamReceiverBase
+		{
+		public:
+			virtual ~StreamReceiverBase() = default;
+			/// @brief Calls the handler
+			/// @param ec The error code of the receive
+			/// @param index The index of the easy handle
+			/// @param result The error code of its transfer
+			virtual void Complete(error_code ec, size_t index, error_code result) noexcept = 0;
+		};
+		template<typename Handler>
+		class StreamReceiver : public StreamReceiverBase
+		{
+		public:
+			StreamReceiver(Handler& handler) noexcept : m_handler(std::move(handler)) {}
+			~StreamReceiver() noexcept
+			{
+				// abort if we haven't been handled
+				if (m_handled == false)
+					Complete(asio::error::operation_aborted, 0, error_code());
+			}
+
+			void Complete(error_code ec, size_t index, error_code result) noexcept
+			{
+				if (m_handled == true)
+					return;
+				m_handled = true;
+				m_handler(ec, index, result);
+			}
+		private:
+			Handler m_handler;
+			bool m_handled = false;
+		};
+	}
+
+	/// @brief The order a TransferStream delivers its results in
+	enum class StreamOrder
+	{
+		/// @brief As the transfers complete
+		Completion,
+		/// @brief In the order of the easy handles
+		Submission
+	};
+
+	/// @brief TransferStream performs a large batch of easy handles on a
+	/// Multi, and hands their results to a single consumer one at a time as
+	/// it receives them, like a bounded channel. Only a window of transfers
+	/// is ever in flight or waiting to be received, so when the consumer
+	/// lags, no more transfers are started until it catches up. In
+	/// submission order, a result that completes early waits until every
+	/// one before it was received, and the window is also how far ahead of
+	/// the consumer transfers may run. Streams are shared with their
+	/// transfers, so they must be made with std::make_shared
+	class TransferStream : public std::enable_shared_from_this<TransferStream>
+	{
+	public:
+		/// @param multi The multi handle that performs the transfers
+		/// @param easyHandles The easy handles to perform, which must stay in
+		/// scope until every result was received, or a receive failed with
+		/// asio::error::operation_aborted after the stream was cancelled
+		/// @param window The most transfers that may be in flight or have a
+		/// result waiting to be received at once
+		/// @param order The order the results are delivered in
+		/// @param options The options for each transfer. PerformOptions::group
+		/// is replaced by a group of the stream's transfers
+		TransferStream(Multi& multi, std::span<Easy> easyHandles, size_t window,
+			StreamOrder order = StreamOrder::Completion, PerformOptions options = {});
+		TransferStream(const TransferStream&) = delete;
+		TransferStream& operator=(const TransferStream&) = delete;
+
+		/// @brief Starts as many transfers as the window allows. This can
+		/// be called from any thread
+		void Start();
+		/// @brief Stops starting transfers, and cancels those in flight. Once
+		/// it is cancelled, every receive fails with asio::error::operation_aborted,
+		/// but not before every transfer the stream started has completed, so
+		/// from then on the easy handles are free again. This can be called
+		/// from any thread
+		void Cancel() noexcept;
+		/// @brief Receives the next result. There may only be one receive at
+		/// a time. The completion token signature is
+		/// void(error_code, size_t, error_code), with asio::error::eof once
+		/// every result was received, the index of the easy handle, and the
+		/// error code its transfer completed with
+		/// @tparam CompletionToken The completion token type
+		/// @param token The completion token
+		/// @return DEDUCED
+		template<typename CompletionToken>
+		auto AsyncReceive(CompletionToken&& token)
+		{
+			auto initiation = [this](auto&& handler)
+			{
+				Receive(std::make_unique<Detail::StreamReceiver<
+					typename std::decay_t<decltype(handler)>>>(handler));
+			};
+			return asio::async_initiate<CompletionToken,
+				void(error_code, size_t, error_code)>(initiation, token);
+		}
+	private:
+		/// @brief A result waiting to be received
+		struct Slot
+		{
+			size_t index = 0;
+			error_code result;
+			bool ready = false;
+		};
+
+		/// @brief Sets the receiver, and delivers a result to it if one is
+		/// ready. It is posted, so that receiving from a handler doesn't
+		/// recurse
+		/// @param receiver The receiver
+		void Receive(std::unique_ptr<Detail::StreamReceiverBase> receiver);
+		/// @brief Starts transfers until the window is full. Must be called
+		/// from within the strand
+		void Admit() noexcept;
+		/// @brief Stores the result of a transfer. Must be called from within
+		/// the strand
+		/// @param index The index of the easy handle
+		/// @param result The error code its transfer completed with
+		void Land(size_t index, error_code result) noexcept;
+		/// @brief Hands the next result to the receiver, if there are both.
+		/// Must be called from within the strand
+		void Deliver() noexcept;
+
+		Multi& m_multi;
+		std::span<Easy> m_easies;
+		size_t m_window;
+		StreamOrder m_order;
+		PerformOptions m_options;
+		asio::strand<asio::any_io_executor> m_strand;
+		// in completion order, a ring starting at m_head. in submission order,
+		// each transfer has the slot of its index modulo the window
+		std::vector<Slot> m_slots;
+		size_t m_head = 0;
+		size_t m_ready = 0;
+		size_t m_started = 0;
+		size_t m_received = 0;
+		bool m_cancelled = false;
+		// whether every transfer has completed since it was cancelled
+		bool m_settled = false;
+		std::unique_ptr<Detail::StreamReceiverBase> m_receiver;
+	};
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include <curl-multi-asio/CircuitBreaker.h>
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+
+using cma::CircuitBreaker;
+
+namespace
+{
+	/// @brief Writes the origin of a URL into a string of any kind
+	/// @tparam String The string type
+	/// @param url The URL
+	/// @param origin The string, which is left empty if the URL couldn't
+	/// be parsed
+	template<typename String>
+	void ParseOrigin(const char* url, String& origin) noexcept
+	{
+		origin.clear();
+		if (url == nullptr)
+			return;
+		std::unique_ptr<CURLU, decltype(&curl_url_cleanup)> handle(curl_url(), curl_url_cleanup);
+		if (handle == nullptr || curl_url_set(handle.get(), CURLUPART_URL, url, 0) != CURLUE_OK)
+			return;
+		// the default port is filled in, so that http://host and
+		// http://host:80 are the same origin
+		for (const auto part : { CURLUPART_SCHEME, CURLUPART_HOST, CURLUPART_PORT })
+		{
+			char* value = nullptr;
+			if (curl_url_get(handle.get(), part, &value, CURLU_DEFAULT_PORT) != CURLUE_OK)
+				return origin.clear();
+			origin += value;
+			origin += (part == CURLUPART_SCHEME) ? "://" : (part == CURLUPART_HOST) ? ":" : "";
+			curl_free(value);
+		}
+		std::transform(origin.begin(), origin.end(), origin.begin(), [](unsigned char c)
+			{
+				return static_cast<char>(std::tolower(c));
+			});
+	}
+}
+
+bool CircuitBreaker::Allow(std::string_view origin) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	auto originIt = m_origins.find(origin);
+	if (originIt == m_origins.end())
+		originIt = m_origins.emplace(origin, Origin()).first;
+	auto& state = originIt->second;
+	if (state.state == State::Open)
+	{
+		if (std::chrono::steady_clock::now() < state.openUntil)
+		{
+			m_rejected.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		state.state = State::HalfOpen;
+		state.probes = 0;
+		state.probeSuccesses = 0;
+	}
+	if (state.state == State::HalfOpen)
+	{
+		if (state.probes >= std::max(halfOpenProbes, 1u))
+		{
+			m_rejected.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		++state.probes;
+	}
+	return true;
+}
+
+void CircuitBreaker::Record(std::string_view origin, bool failed) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	auto originIt = m_origins.find(origin);
+	if (originIt == m_origins.end())
+		originIt = m_origins.emplace(origin, Origin()).first;
+	auto& state = originIt->second;
+	if (state.state == State::HalfOpen)
+	{
+		if (state.probes > 0)
+			--state.probes;
+		if (failed == true)
+			return Open(state);
+		// enough probes got through, so the origin is back
+		if (++state.probeSuccesses >= std::max(halfOpenProbes, 1u))
+			state = Origin();
+		return;
+	}
+	// late outcomes of transfers that started before the circuit
+	// opened don't tell us anything new
+	if (state.state == State::Open)
+		return;
+	state.consecutive = (failed == true) ? state.consecutive + 1 : 0;
+	if (window > 0)
+	{
+		if (state.outcomes.size() != window)
+		{
+			state.outcomes.assign(window, 0);
+			state.next = state.recorded = state.failures = 0;
+		}
+		// the oldest outcome drops out of the window
+		state.failures -= state.outcomes[state.next];
+		state.outcomes[state.next] = (failed == true) ? 1 : 0;
+		state.failures += state.outcomes[state.next];
+		state.next = (state.next + 1) % window;
+		state.recorded = std::min(state.recorded + 1, window);
+	}
+	if ((consecutiveFailures > 0 && state.consecutive >= consecutiveFailures) ||
+		(window > 0 && state.recorded == window && failureRate <= 1.0 &&
+			static_cast<double>(state.failures) >= failureRate * static_cast<double>(window)))
+		Open(state);
+}
+
+void CircuitBreaker::Release(std::string_view origin) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	auto originIt = m_origins.find(origin);
+	if (originIt != m_origins.end() && originIt->second.state == State::HalfOpen &&
+		originIt->second.probes > 0)
+		--originIt->second.probes;
+}
+
+bool CircuitBreaker::IsFailure(const error_code& ec, long status,
+	std::chrono::steady_clock::duration latency) const noexcept
+{
+	if (ec || status >= 500)
+		return true;
+	return slowCallThreshold.count() > 0 && latency > slowCallThreshold;
+}
+
+CircuitBreaker::State CircuitBreaker::GetState(std::string_view origin) const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	auto originIt = m_origins.find(origin);
+	if (originIt == m_origins.end())
+		return State::Closed;
+	// an open circuit whose time is up only turns half-open on the next call
+	if (originIt->second.state == State::Open &&
+		std::chrono::steady_clock::now() >= originIt->second.openUntil)
+		return State::HalfOpen;
+	return originIt->second.state;
+}
+
+std::string CircuitBreaker::GetOrigin(const char* url) noexcept
+{
+	std::string origin;
+	ParseOrigin(url, origin);
+	return origin;
+}
+
+void CircuitBreaker::GetOrigin(const char* url, std::pmr::string& origin) noexcept
+{
+	ParseOrigin(url, origin);
+}
+
+void CircuitBreaker::Open(Origin& origin) noexcept
+{
+	// each opening in a row lasts twice as long as the one before it
+	auto duration = openDuration;
+	for (unsigned i = 0; i < origin.ejections && duration < maxOpenDuration; ++i)
+		duration *= 2;
+	duration = std::min(duration, maxOpenDuration);
+	origin.state = State::Open;
+	origin.openUntil = std::chrono::steady_clock::now() + duration;
+	++origin.ejections;
+	origin.consecutive = 0;
+	origin.probes = 0;
+	origin.probeSuccesses = 0;
+	// the next closed period starts with a clean window
+	std::fill(origin.outcomes.begin(), origin.outcomes.end(), 0);
+	origin.next = origin.recorded = origin.failures = 0;
+}
@@ -0,0 +1,126 @@
+#include <curl-multi-asio/CurlAllocator.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+
+using cma::CurlAllocator;
+using cma::ThreadCachingAllocator;
+
+namespace
+{
+	/// @brief The smallest size class is 2^4 bytes
+	constexpr unsigned s_minClassBits = 4;
+	/// @brief The largest size class is 2^12 bytes
+	constexpr unsigned s_maxClassBits = 12;
+	constexpr size_t s_classes = s_maxClassBits - s_minClassBits + 1;
+
+	/// @param size The size of a block
+	/// @return The size class it is rounded up to, or s_classes if
+	/// it is too large to be cached
+	size_t ClassOf(size_t size) noexcept
+	{
+		if (size > (size_t(1) << s_maxClassBits))
+			return s_classes;
+		return std::max<size_t>(std::bit_width(std::max<size_t>(size, 1) - 1),
+			s_minClassBits) - s_minClassBits;
+	}
+
+	/// @brief Set once the calling thread's cache is destroyed, after which
+	/// its blocks go straight to malloc and free
+	thread_local bool t_cacheGone = false;
+
+	/// @brief The blocks a thread has freed, which it allocates from first
+	struct ThreadCache
+	{
+		/// @brief Each list is linked through the first bytes of its blocks
+		std::array<void*, s_classes> heads{};
+		std::array<size_t, s_classes> counts{};
+
+		~ThreadCache()
+		{
+			t_cacheGone = true;
+			for (auto head : heads)
+			{
+				while (head != nullptr)
+				{
+					auto next = *static_cast<void**>(head);
+					std::free(head);
+					head = next;
+				}
+			}
+		}
+	};
+
+	/// @return The cache of the calling thread
+	ThreadCache& GetThreadCache() noexcept
+	{
+		thread_local ThreadCache cache;
+		return cache;
+	}
+}
+
+void* CurlAllocator::Allocate(size_t size) noexcept
+{
+	return std::malloc(size);
+}
+
+void CurlAllocator::Deallocate(void* block, size_t) noexcept
+{
+	std::free(block);
+}
+
+void* CurlAllocator::Reallocate(void* block, size_t size, size_t newSize) noexcept
+{
+	auto moved = Allocate(newSize);
+	if (moved == nullptr)
+		return nullptr;
+	std::memcpy(moved, block, std::min(size, newSize));
+	Deallocate(block, size);
+	return moved;
+}
+
+void* ThreadCachingAllocator::Allocate(size_t size) noexcept
+{
+	const auto sizeClass = ClassOf(size);
+	if (sizeClass == s_classes)
+		return std::malloc(size);
+	if (t_cacheGone == true)
+		return std::malloc(size_t(1) << (sizeClass + s_minClassBits));
+	auto& cache = GetThreadCache();
+	if (auto block = cache.heads[sizeClass]; block != nullptr)
+	{
+		cache.heads[sizeClass] = *static_cast<void**>(block);
+		--cache.counts[sizeClass];
+		return block;
+	}
+	// every block of a class is as big as the class, wherever it's reused
+	return std::malloc(size_t(1) << (sizeClass + s_minClassBits));
+}
+
+void ThreadCachingAllocator::Deallocate(void* block, size_t size) noexcept
+{
+	const auto sizeClass = ClassOf(size);
+	if (sizeClass == s_classes || t_cacheGone == true)
+		return std::free(block);
+	auto& cache = GetThreadCache();
+	if (cache.counts[sizeClass] >= m_cachedPerClass)
+		return std::free(block);
+	*static_cast<void**>(block) = cache.heads[sizeClass];
+	cache.heads[sizeClass] = block;
+	++cache.counts[sizeClass];
+}
+
+void* ThreadCachingAllocator::Reallocate(void* block, size_t size, size_t newSize) noexcept
+{
+	const auto sizeClass = ClassOf(size);
+	const auto newSizeClass = ClassOf(newSize);
+	// a block already has room for anything in its class
+	if (sizeClass == newSizeClass && sizeClass != s_classes)
+		return block;
+	if (sizeClass == s_classes && newSizeClass == s_classes)
+		return std::realloc(block, newSize);
+	return CurlAllocator::Reallocate(block, size, newSize);
+}
@@ -0,0 +1,172 @@
+#include <curl-multi-asio/Detail/BandwidthShaper.h>
+
+#include <algorithm>
+#include <limits>
+
+using cma::Detail::BandwidthShaper;
+using cma::Detail::ShapedTransfer;
+
+void BandwidthShaper::SetLimit(const BandwidthLimit& limit) noexcept
+{
+	m_limit = limit;
+	if (m_limit.interval.count() <= 0)
+		m_limit.interval = std::chrono::milliseconds(1);
+	// release anything held back by a direction that is no longer limited
+	int released = 0;
+	if (m_limit.recvBytesPerSecond <= 0)
+		released |= CURLPAUSE_RECV;
+	if (m_limit.sendBytesPerSecond <= 0)
+		released |= CURLPAUSE_SEND;
+	for (auto transfer : m_transfers)
+	{
+		if (transfer->pausedMask & released)
+			ApplyPause(*transfer, transfer->pausedMask & ~released);
+	}
+}
+
+void BandwidthShaper::Add(ShapedTransfer& transfer, CURL* easy, double weight) noexcept
+{
+	transfer.shaper = this;
+	transfer.easy = easy;
+	transfer.weight = (weight > 0.0) ? weight : 1.0;
+	transfer.index = m_transfers.size();
+	transfer.active = true;
+	transfer.pausedMask = 0;
+	transfer.recv = {};
+	transfer.send = {};
+	m_transfers.push_back(&transfer);
+	// start with an even share of the interval, the next tick will
+	// correct it once we know how much the transfer can actually use
+	const auto millis = m_limit.interval.count();
+	const auto shares = static_cast<curl_off_t>(m_transfers.size());
+	transfer.recv.credit = m_limit.recvBytesPerSecond * millis / 1000 / shares;
+	transfer.send.credit = m_limit.sendBytesPerSecond * millis / 1000 / shares;
+	curl_easy_setopt(easy, CURLoption::CURLOPT_XFERINFOFUNCTION, &BandwidthShaper::XferInfoCb);
+	curl_easy_setopt(easy, CURLoption::CURLOPT_XFERINFODATA, &transfer);
+	curl_easy_setopt(easy, CURLoption::CURLOPT_NOPROGRESS, 0L);
+}
+
+void BandwidthShaper::Remove(ShapedTransfer& transfer) noexcept
+{
+	if (transfer.active == false)
+		return;
+	// swap the last transfer into this one's place
+	auto last = m_transfers.back();
+	m_transfers[transfer.index] = last;
+	last->index = transfer.index;
+	m_transfers.pop_back();
+	transfer.active = false;
+	// don't leave the handle paused or pointing at us
+	if (transfer.pausedMask != 0)
+		ApplyPause(transfer, CURLPAUSE_CONT);
+	curl_easy_setopt(transfer.easy, CURLoption::CURLOPT_NOPROGRESS, 1L);
+	curl_easy_setopt(transfer.easy, CURLoption::CURLOPT_XFERINFOFUNCTION, nullptr);
+	curl_easy_setopt(transfer.easy, CURLoption::CURLOPT_XFERINFODATA, nullptr);
+}
+
+void BandwidthShaper::OnProgress(ShapedTransfer& transfer, curl_off_t dlnow,
+	curl_off_t ulnow) noexcept
+{
+	if (transfer.active == false)
+		return;
+	int mask = transfer.pausedMask;
+	const auto charge = [&mask](ShapedTransfer::Direction& dir, curl_off_t now,
+		curl_off_t rate, int bit)
+	{
+		// the counters restart on redirects
+		const auto delta = (now >= dir.last) ? now - dir.last : 0;
+		dir.last = now;
+		if (rate <= 0)
+			return;
+		dir.used += delta;
+		dir.credit -= delta;
+		if (dir.credit <= 0)
+		{
+			dir.throttled = true;
+			mask |= bit;
+		}
+	};
+	charge(transfer.recv, dlnow, m_limit.recvBytesPerSecond, CURLPAUSE_RECV);
+	charge(transfer.send, ulnow, m_limit.sendBytesPerSecond, CURLPAUSE_SEND);
+	if (mask != transfer.pausedMask)
+		ApplyPause(transfer, mask);
+}
+
+void BandwidthShaper::Tick() noexcept
+{
+	if (m_limit.recvBytesPerSecond > 0)
+		Apportion(&ShapedTransfer::recv, m_limit.recvBytesPerSecond, CURLPAUSE_RECV);
+	if (m_limit.sendBytesPerSecond > 0)
+		Apportion(&ShapedTransfer::send, m_limit.sendBytesPerSecond, CURLPAUSE_SEND);
+	// unpausing may hand buffered data to the write callback, which charges
+	// and possibly pauses the transfer again. that only touches the transfer
+	// itself, so iterating here is safe
+	for (auto transfer : m_transfers)
+	{
+		int mask = transfer->pausedMask;
+		if ((mask & CURLPAUSE_RECV) && transfer->recv.credit > 0)
+			mask &= ~CURLPAUSE_RECV;
+		if ((mask & CURLPAUSE_SEND) && transfer->send.credit > 0)
+			mask &= ~CURLPAUSE_SEND;
+		if (mask != transfer->pausedMask)
+			ApplyPause(*transfer, mask);
+	}
+}
+
+int BandwidthShaper::XferInfoCb(ShapedTransfer* clientp, curl_off_t,
+	curl_off_t dlnow, curl_off_t, curl_off_t ulnow) noexcept
+{
+	clientp->shaper->OnProgress(*clientp, dlnow, ulnow);
+	return 0;
+}
+
+void BandwidthShaper::Apportion(ShapedTransfer::Direction ShapedTransfer::* direction,
+	curl_off_t bytesPerSecond, int pauseBit) noexcept
+{
+	auto remaining = static_cast<double>(bytesPerSecond) *
+		static_cast<double>(m_limit.interval.count()) / 1000.0;
+	// estimate what each transfer could use. a throttled or still paused
+	// transfer could use anything, one that wasn't is assumed to be able
+	// to double its usage
+	m_demand.clear();
+	double totalWeight = 0.0;
+	for (auto transfer : m_transfers)
+	{
+		auto& dir = transfer->*direction;
+		const auto hungry = dir.throttled == true ||
+			(transfer->pausedMask & pauseBit) != 0;
+		const auto demand = (hungry == true) ?
+			std::numeric_limits<double>::infinity() :
+			static_cast<double>(dir.used) * 2.0 + 1.0;
+		const auto weight = (transfer->weight > 0.0) ? transfer->weight : 1.0;
+		m_demand.emplace_back(demand / weight, transfer);
+		totalWeight += weight;
+	}
+	// water-fill: satisfy the smallest demands per weight first, and split
+	// what remains among the rest by weight
+	std::sort(m_demand.begin(), m_demand.end(), [](const auto& a, const auto& b)
+		{
+			return a.first < b.first;
+		});
+	for (auto& [demandPerWeight, transfer] : m_demand)
+	{
+		auto& dir = transfer->*direction;
+		const auto weight = (transfer->weight > 0.0) ? transfer->weight : 1.0;
+		const auto perWeight = (totalWeight > 0.0) ? remaining / totalWeight : 0.0;
+		const auto grant = std::min(demandPerWeight, perWeight) * weight;
+		remaining -= grant;
+		totalWeight -= weight;
+		// debt carries over, but unused credit does not, or an idle
+		// transfer could burst far past the limit
+		dir.credit = std::min<curl_off_t>(dir.credit, 0) +
+			static_cast<curl_off_t>(grant);
+		dir.used = 0;
+		dir.throttled = false;
+	}
+}
+
+void BandwidthShaper::ApplyPause(ShapedTransfer& transfer, int mask) noexcept
+{
+	transfer.pausedMask = mask;
+	curl_easy_pause(transfer.easy, mask);
+}
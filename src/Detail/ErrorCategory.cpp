@@ -0,0 +1,18 @@
+#include <curl-multi-asio/Error.h>
+
+using cma::Detail::CMAErrCategory;
+
+std::string CMAErrCategory::message(int ev) const
+{
+	switch (static_cast<cma::Error>(ev))
+	{
+	case cma::Error::CircuitOpen:
+		return "The circuit breaker of the origin is open";
+	case cma::Error::DeadlineExceeded:
+		return "The deadline of the transfer passed";
+	case cma::Error::QuorumNotReached:
+		return "Too few of the transfers succeeded";
+	default:
+		return "Unknown error";
+	}
+}
@@ -0,0 +1,35 @@
+#include <curl-multi-asio/Detail/FanOut.h>
+
+#include <curl-multi-asio/RequestGroup.h>
+
+using cma::Detail::FanOutBase;
+
+void FanOutBase::Complete(size_t index, const error_code& ec) noexcept
+{
+	// each transfer has a slot of its own, and the last one to release
+	// sees all of them
+	m_results[index] = ec;
+	if (!ec)
+	{
+		auto none = s_none;
+		m_first.compare_exchange_strong(none, index, std::memory_order_relaxed);
+		if (m_succeeded.fetch_add(1, std::memory_order_relaxed) + 1 == m_needed &&
+			m_group != nullptr)
+			m_group->Cancel();
+	}
+	// once too many have failed, there is no point in the rest either.
+	// cancelling again does nothing, so there is no need to only do it once
+	else if (m_failed.fetch_add(1, std::memory_order_relaxed) + 1 + m_needed >
+		m_results.size() && m_group != nullptr)
+		m_group->Cancel();
+	Release();
+}
+
+void FanOutBase::Release() noexcept
+{
+	if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+	Finish(std::move(m_results), m_succeeded.load(std::memory_order_relaxed),
+		m_first.load(std::memory_order_relaxed));
+	delete this;
+}
@@ -1,15 +1,100 @@
 #include <curl-multi-asio/Detail/Lifetime.h>
 
+#include <cstring>
 #include <exception>
+#include <limits>
 
 using cma::Detail::Lifetime;
 
+namespace
+{
+	/// @brief Every block cURL gets is prefixed with its size, since free
+	/// doesn't get one. It is as big as malloc's alignment
+	struct alignas(std::max_align_t) BlockHeader
+	{
+		size_t size;
+	};
+
+	cma::CurlAllocator* s_allocator = nullptr;
+	std::atomic<uint64_t> s_liveBytes = 0;
+	std::atomic<uint64_t> s_liveAllocations = 0;
+	std::atomic<uint64_t> s_allocations = 0;
+	std::atomic<uint64_t> s_reallocations = 0;
+
+	void* Malloc(size_t size) noexcept
+	{
+		if (size > std::numeric_limits<size_t>::max() - sizeof(BlockHeader))
+			return nullptr;
+		auto header = static_cast<BlockHeader*>(
+			s_allocator->Allocate(size + sizeof(BlockHeader)));
+		if (header == nullptr)
+			return nullptr;
+		header->size = size;
+		s_liveBytes.fetch_add(size, std::memory_order_relaxed);
+		s_liveAllocations.fetch_add(1, std::memory_order_relaxed);
+		s_allocations.fetch_add(1, std::memory_order_relaxed);
+		return header + 1;
+	}
+
+	void Free(void* block) noexcept
+	{
+		if (block == nullptr)
+			return;
+		auto header = static_cast<BlockHeader*>(block) - 1;
+		s_liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+		s_liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+		s_allocator->Deallocate(header, header->size + sizeof(BlockHeader));
+	}
+
+	void* Realloc(void* block, size_t size) noexcept
+	{
+		if (block == nullptr)
+			return Malloc(size);
+		if (size > std::numeric_limits<size_t>::max() - sizeof(BlockHeader))
+			return nullptr;
+		auto header = static_cast<BlockHeader*>(block) - 1;
+		const auto oldSize = header->size;
+		header = static_cast<BlockHeader*>(s_allocator->Reallocate(header,
+			oldSize + sizeof(BlockHeader), size + sizeof(BlockHeader)));
+		if (header == nullptr)
+			return nullptr;
+		header->size = size;
+		s_liveBytes.fetch_add(size - oldSize, std::memory_order_relaxed);
+		s_reallocations.fetch_add(1, std::memory_order_relaxed);
+		return header + 1;
+	}
+
+	char* Strdup(const char* str) noexcept
+	{
+		const auto size = std::strlen(str) + 1;
+		auto copy = static_cast<char*>(Malloc(size));
+		if (copy != nullptr)
+			std::memcpy(copy, str, size);
+		return copy;
+	}
+
+	void* Calloc(size_t count, size_t size) noexcept
+	{
+		if (size != 0 && count > std::numeric_limits<size_t>::max() / size)
+			return nullptr;
+		auto block = Malloc(count * size);
+		if (block != nullptr)
+			std::memset(block, 0, count * size);
+		return block;
+	}
+}
+
 std::atomic_size_t Lifetime::s_refCount = 0;
 
 Lifetime::Lifetime() noexcept
 {
 	if (s_refCount++ == 0)
-		curl_global_init(CURL_GLOBAL_ALL);
+	{
+		if (s_allocator != nullptr)
+			curl_global_init_mem(CURL_GLOBAL_ALL, &Malloc, &Free, &Realloc, &Strdup, &Calloc);
+		else
+			curl_global_init(CURL_GLOBAL_ALL);
+	}
 }
 
 Lifetime::~Lifetime() noexcept
@@ -26,4 +111,22 @@ Lifetime::Lifetime(const Lifetime&) noexcept
 Lifetime::Lifetime(Lifetime&&) noexcept
 {
 	++s_refCount;
+}
+
+bool Lifetime::SetAllocator(CurlAllocator* allocator) noexcept
+{
+	if (s_refCount != 0)
+		return false;
+	s_allocator = allocator;
+	return true;
+}
+
+cma::CurlMemoryStats Lifetime::GetMemoryStats() noexcept
+{
+	CurlMemoryStats stats;
+	stats.liveBytes = s_liveBytes.load(std::memory_order_relaxed);
+	stats.liveAllocations = s_liveAllocations.load(std::memory_order_relaxed);
+	stats.allocations = s_allocations.load(std::memory_order_relaxed);
+	stats.reallocations = s_reallocations.load(std::memory_order_relaxed);
+	return stats;
 }
\ No newline at end of file
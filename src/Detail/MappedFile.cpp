@@ -0,0 +1,94 @@
+#include <curl-multi-asio/Detail/MappedFile.h>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using cma::Detail::MappedFile;
+
+MappedFile::~MappedFile() noexcept
+{
+	Unmap();
+}
+
+cma::error_code MappedFile::Map(const std::filesystem::path& path) noexcept
+{
+	Unmap();
+#ifdef _WIN32
+	const auto file = CreateFileW(path.c_str(), GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return error_code(static_cast<int>(GetLastError()), asio::error::get_system_category());
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size) == FALSE)
+	{
+		const auto err = GetLastError();
+		CloseHandle(file);
+		return error_code(static_cast<int>(err), asio::error::get_system_category());
+	}
+	// an empty file can't be mapped, but there's nothing to map anyway
+	if (size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return error_code();
+	}
+	const auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const auto err = GetLastError();
+	// the view keeps the mapping alive, and the mapping keeps the file alive
+	CloseHandle(file);
+	if (mapping == nullptr)
+		return error_code(static_cast<int>(err), asio::error::get_system_category());
+	const auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	const auto viewErr = GetLastError();
+	CloseHandle(mapping);
+	if (data == nullptr)
+		return error_code(static_cast<int>(viewErr), asio::error::get_system_category());
+	m_data = static_cast<const char*>(data);
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return error_code(errno, asio::error::get_system_category());
+	struct stat st;
+	if (fstat(fd, &st) == -1)
+	{
+		const auto err = errno;
+		close(fd);
+		return error_code(err, asio::error::get_system_category());
+	}
+	// an empty file can't be mapped, but there's nothing to map anyway
+	if (st.st_size == 0)
+	{
+		close(fd);
+		return error_code();
+	}
+	const auto data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+		MAP_SHARED, fd, 0);
+	const auto err = errno;
+	// the mapping keeps the file alive
+	close(fd);
+	if (data == MAP_FAILED)
+		return error_code(err, asio::error::get_system_category());
+	m_data = static_cast<const char*>(data);
+	m_size = static_cast<size_t>(st.st_size);
+#endif
+	return error_code();
+}
+
+void MappedFile::Unmap() noexcept
+{
+	if (m_data == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+#else
+	munmap(const_cast<char*>(m_data), m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,31 @@
+#include <curl-multi-asio/Detail/SubmissionQueue.h>
+
+using cma::Detail::SubmissionNode;
+using cma::Detail::SubmissionQueue;
+
+bool SubmissionQueue::Push(SubmissionNode* node) noexcept
+{
+	auto head = m_head.load(std::memory_order_relaxed);
+	do
+		node->next = head;
+	while (m_head.compare_exchange_weak(head, node,
+		std::memory_order_release, std::memory_order_relaxed) == false);
+	return head == nullptr;
+}
+
+SubmissionNode* SubmissionQueue::Drain() noexcept
+{
+	// taking the whole list means a node is never popped while it's
+	// being pushed onto, so there is no ABA to worry about
+	auto head = m_head.exchange(nullptr, std::memory_order_acquire);
+	// it was pushed newest first, so turn it around
+	SubmissionNode* first = nullptr;
+	while (head != nullptr)
+	{
+		auto next = head->next;
+		head->next = first;
+		first = head;
+		head = next;
+	}
+	return first;
+}
@@ -0,0 +1,179 @@
+#include <curl-multi-asio/Detail/TimerWheel.h>
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+
+using cma::Detail::TimerNode;
+using cma::Detail::TimerWheel;
+
+namespace
+{
+	/// @brief Pushes a node to the front of a list
+	/// @param node The node
+	/// @param head The head of the list
+	void PushFront(TimerNode& node, TimerNode** head) noexcept
+	{
+		node.prev = nullptr;
+		node.next = *head;
+		if (node.next != nullptr)
+			node.next->prev = &node;
+		*head = &node;
+		node.slot = head;
+	}
+	/// @brief Removes a node from whatever list it is in
+	/// @param node The node
+	void Unlink(TimerNode& node) noexcept
+	{
+		if (node.prev != nullptr)
+			node.prev->next = node.next;
+		else
+			*node.slot = node.next;
+		if (node.next != nullptr)
+			node.next->prev = node.prev;
+		node.prev = node.next = nullptr;
+		node.slot = nullptr;
+	}
+}
+
+TimerWheel::TimerWheel(clock::duration tick) noexcept :
+	m_tick((tick.count() > 0) ? tick : clock::duration(1)),
+	m_origin(clock::now()), m_slots(s_levels * s_slots, nullptr) {}
+
+void TimerWheel::Schedule(TimerNode& node, clock::duration delay,
+	clock::time_point now) noexcept
+{
+	Cancel(node);
+	// an idle wheel doesn't tick, so catch it up to now
+	if (m_size == 0)
+		m_now = std::max(m_now, TickOf(now));
+	// round up, so that the node never fires early
+	const auto due = now + delay;
+	node.expiry = TickOf(due);
+	if (m_origin + m_tick * node.expiry < due)
+		++node.expiry;
+	node.expiry = std::max(node.expiry, m_now + 1);
+	Link(node);
+	++m_size;
+}
+
+void TimerWheel::Cancel(TimerNode& node) noexcept
+{
+	if (node.Scheduled() == false)
+		return;
+	auto slot = node.slot;
+	Unlink(node);
+	Vacate(slot);
+	--m_size;
+}
+
+size_t TimerWheel::Advance(clock::time_point now) noexcept
+{
+	size_t expired = 0;
+	const auto target = TickOf(now);
+	while (m_now < target)
+	{
+		// skip the ticks on which nothing happens
+		const auto next = NextTick();
+		if (next.has_value() == false || *next > target)
+		{
+			m_now = target;
+			break;
+		}
+		m_now = *next;
+		// move the nodes of every level whose slot just came up down,
+		// starting at the highest, so they can fall more than one level
+		size_t level = 1;
+		while (level < s_levels && (m_now & ((uint64_t(1) << (s_slotBits * level)) - 1)) == 0)
+			++level;
+		while (--level > 0)
+		{
+			for (auto node = Take(level, (m_now >> (s_slotBits * level)) & (s_slots - 1));
+				node != nullptr;)
+			{
+				auto next = node->next;
+				Link(*node);
+				node = next;
+			}
+		}
+		// move the due nodes out first. they keep pointing at the local
+		// list, so callbacks can still cancel or reschedule any of them
+		TimerNode* due = Take(0, m_now & (s_slots - 1));
+		for (auto node = due; node != nullptr; node = node->next)
+			node->slot = &due;
+		while (due != nullptr)
+		{
+			auto& node = *due;
+			Cancel(node);
+			++expired;
+			node.callback(node.context);
+		}
+	}
+	return expired;
+}
+
+std::optional<TimerWheel::clock::time_point> TimerWheel::NextExpiry() const noexcept
+{
+	const auto next = NextTick();
+	if (next.has_value() == false)
+		return std::nullopt;
+	return m_origin + m_tick * *next;
+}
+
+uint64_t TimerWheel::TickOf(clock::time_point time) const noexcept
+{
+	if (time <= m_origin)
+		return 0;
+	return static_cast<uint64_t>((time - m_origin) / m_tick);
+}
+
+std::optional<uint64_t> TimerWheel::NextTick() const noexcept
+{
+	if (m_size == 0)
+		return std::nullopt;
+	// a node is only ever in a slot after the current one of its level,
+	// and the nodes of a level all come before those of the levels above
+	for (size_t level = 0; level < s_levels; ++level)
+	{
+		const auto shift = s_slotBits * level;
+		const auto current = (m_now >> shift) & (s_slots - 1);
+		const auto later = m_occupied[level] & ~((uint64_t(2) << current) - 1);
+		if (later == 0)
+			continue;
+		// the start of the first occupied slot's span
+		const auto span = shift + s_slotBits;
+		const auto base = (span >= 64) ? 0 : (m_now >> span) << span;
+		return base | (static_cast<uint64_t>(std::countr_zero(later)) << shift);
+	}
+	return std::nullopt;
+}
+
+void TimerWheel::Link(TimerNode& node) noexcept
+{
+	// the lowest level in which the expiry and the current tick differ
+	const auto differ = node.expiry ^ m_now;
+	const size_t level = (differ == 0) ? 0 :
+		static_cast<size_t>(63 - std::countl_zero(differ)) / s_slotBits;
+	const auto index = (node.expiry >> (s_slotBits * level)) & (s_slots - 1);
+	PushFront(node, &m_slots[level * s_slots + index]);
+	m_occupied[level] |= uint64_t(1) << index;
+}
+
+TimerNode* TimerWheel::Take(size_t level, size_t index) noexcept
+{
+	auto& slot = m_slots[level * s_slots + index];
+	auto nodes = slot;
+	slot = nullptr;
+	m_occupied[level] &= ~(uint64_t(1) << index);
+	return nodes;
+}
+
+void TimerWheel::Vacate(TimerNode** slot) noexcept
+{
+	// due nodes are in a list of their own
+	if (*slot != nullptr || std::less<>()(slot, m_slots.data()) == true ||
+		std::less<>()(slot, m_slots.data() + m_slots.size()) == false)
+		return;
+	const auto position = static_cast<size_t>(slot - m_slots.data());
+	m_occupied[position / s_slots] &= ~(uint64_t(1) << (position % s_slots));
+}
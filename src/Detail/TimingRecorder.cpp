@@ -0,0 +1,85 @@
+#include <curl-multi-asio/Detail/TimingRecorder.h>
+
+#include <functional>
+#include <new>
+
+using cma::Detail::TimingRecorder;
+
+TimingRecorder::~TimingRecorder() noexcept
+{
+	for (auto& slot : m_origins)
+		delete slot.load(std::memory_order_relaxed);
+}
+
+void TimingRecorder::Record(CURL* easy, std::string_view origin) noexcept
+{
+	// every phase is read once, then recorded wherever it belongs
+	curl_off_t nameLookup = 0, connect = 0, appConnect = 0, startTransfer = 0, total = 0;
+	curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup);
+	curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME_T, &appConnect);
+	curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer);
+	curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &total);
+	auto originHistograms = (origin.empty() == false) ? FindOrigin(origin) : nullptr;
+	for (auto histograms : { &m_all, originHistograms })
+	{
+		if (histograms == nullptr)
+			continue;
+		histograms->nameLookup.Record(std::chrono::microseconds(nameLookup));
+		histograms->connect.Record(std::chrono::microseconds(connect));
+		if (appConnect > 0)
+			histograms->appConnect.Record(std::chrono::microseconds(appConnect));
+		histograms->startTransfer.Record(std::chrono::microseconds(startTransfer));
+		histograms->total.Record(std::chrono::microseconds(total));
+	}
+}
+
+cma::TransferTimings TimingRecorder::GetTimings() const
+{
+	return m_all.GetSnapshot();
+}
+
+std::unordered_map<std::string, cma::TransferTimings> TimingRecorder::GetOriginTimings() const
+{
+	std::unordered_map<std::string, TransferTimings> timings;
+	ForEachOrigin([&timings](std::string_view origin, const Histograms& histograms)
+		{
+			timings.emplace(origin, histograms.GetSnapshot());
+		});
+	return timings;
+}
+
+TimingRecorder::Histograms* TimingRecorder::FindOrigin(std::string_view name) noexcept
+{
+	// the recording thread is the only one that sets slots, so it can
+	// read them relaxed, and a slot it finds empty stays empty
+	auto index = std::hash<std::string_view>{}(name) % m_origins.size();
+	for (;; index = (index + 1) % m_origins.size())
+	{
+		auto origin = m_origins[index].load(std::memory_order_relaxed);
+		if (origin == nullptr)
+			break;
+		if (origin->name == name)
+			return &origin->histograms;
+	}
+	if (m_originCount == s_maxOrigins)
+		return nullptr;
+	auto origin = new (std::nothrow) Origin{ std::string(name), {} };
+	if (origin == nullptr)
+		return nullptr;
+	// published along with its name, for the readers on other threads
+	m_origins[index].store(origin, std::memory_order_release);
+	++m_originCount;
+	return &origin->histograms;
+}
+
+cma::TransferTimings TimingRecorder::Histograms::GetSnapshot() const
+{
+	TransferTimings timings;
+	timings.nameLookup = nameLookup.GetSnapshot();
+	timings.connect = connect.GetSnapshot();
+	timings.appConnect = appConnect.GetSnapshot();
+	timings.startTransfer = startTransfer.GetSnapshot();
+	timings.total = total.GetSnapshot();
+	return timings;
+}
@@ -0,0 +1,63 @@
+#include <curl-multi-asio/Detail/TransferArena.h>
+
+#include <utility>
+
+using cma::Detail::ArenaPool;
+using cma::Detail::ArenaReturner;
+
+ArenaPool::~ArenaPool() noexcept
+{
+	for (auto arena = m_idle.load(std::memory_order_acquire); arena != nullptr;)
+		delete std::exchange(arena, arena->m_next);
+}
+
+void ArenaReturner::operator()(TransferArena* arena) const noexcept
+{
+	pool->Recycle(arena);
+}
+
+cma::Detail::ArenaLease ArenaPool::Acquire()
+{
+	// the whole stack is taken, so no other thread can pop the arena under
+	// it while its link is read, and there is no ABA to worry about. one
+	// that finds it empty meanwhile just makes a new arena
+	auto arena = m_idle.exchange(nullptr, std::memory_order_acquire);
+	if (arena != nullptr)
+	{
+		m_idleCount.fetch_sub(1, std::memory_order_relaxed);
+		if (auto rest = std::exchange(arena->m_next, nullptr); rest != nullptr)
+			PushIdle(rest);
+	}
+	else
+		arena = new TransferArena();
+	return ArenaLease(arena, ArenaReturner{ shared_from_this() });
+}
+
+void ArenaPool::Recycle(TransferArena* arena) noexcept
+{
+	arena->Reset();
+	if (m_idleCount.fetch_add(1, std::memory_order_relaxed) >= m_maxIdle)
+	{
+		m_idleCount.fetch_sub(1, std::memory_order_relaxed);
+		delete arena;
+		return;
+	}
+	PushIdle(arena);
+}
+
+void ArenaPool::PushIdle(TransferArena* first) noexcept
+{
+	// the end of the list is only looked for once it has to be linked
+	// to something, which is rare when there are no other pushes
+	TransferArena* last = nullptr;
+	auto head = m_idle.load(std::memory_order_relaxed);
+	do
+	{
+		if (head != nullptr && last == nullptr)
+			for (last = first; last->m_next != nullptr; last = last->m_next);
+		if (last != nullptr)
+			last->m_next = head;
+	}
+	while (m_idle.compare_exchange_weak(head, first,
+		std::memory_order_release, std::memory_order_relaxed) == false);
+}
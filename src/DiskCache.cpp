@@ -0,0 +1,476 @@
+#include <curl-multi-asio/DiskCache.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using cma::DiskCache;
+
+namespace
+{
+	/// @brief What the index file starts with
+	constexpr std::string_view s_indexMagic = "CMAIDX1\n";
+	constexpr std::string_view s_segmentPrefix = "segment-";
+
+	enum class RecordType : uint8_t
+	{
+		Store = 1,
+		Erase = 2
+	};
+
+	/// @brief Appends a value in its in-memory representation. The index
+	/// is not meant to be moved between machines
+	/// @param out The buffer
+	/// @param value The value
+	template<typename T>
+	void Write(std::string& out, T value)
+	{
+		out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+	/// @brief Appends a length-prefixed string
+	/// @param out The buffer
+	/// @param str The string
+	void WriteString(std::string& out, std::string_view str)
+	{
+		Write<uint32_t>(out, static_cast<uint32_t>(str.size()));
+		out.append(str);
+	}
+
+	/// @brief Reads what Write and WriteString wrote. Reading past the end
+	/// fails the reader instead of reading garbage
+	class Reader
+	{
+	public:
+		explicit Reader(std::string_view data) noexcept : m_data(data) {}
+
+		template<typename T>
+		T Read() noexcept
+		{
+			T value{};
+			if (m_data.size() < sizeof(T))
+			{
+				m_ok = false;
+				return value;
+			}
+			std::memcpy(&value, m_data.data(), sizeof(T));
+			m_data.remove_prefix(sizeof(T));
+			return value;
+		}
+		std::string_view ReadBytes(size_t size) noexcept
+		{
+			if (m_data.size() < size)
+			{
+				m_ok = false;
+				return {};
+			}
+			const auto bytes = m_data.substr(0, size);
+			m_data.remove_prefix(size);
+			return bytes;
+		}
+		std::string ReadString() noexcept
+		{
+			return std::string(ReadBytes(Read<uint32_t>()));
+		}
+
+		inline bool Ok() const noexcept { return m_ok; }
+		inline bool Empty() const noexcept { return m_data.empty(); }
+	private:
+		std::string_view m_data;
+		bool m_ok = true;
+	};
+
+	/// @return The last system error
+	cma::error_code LastError() noexcept
+	{
+		return cma::error_code(errno, asio::error::get_system_category());
+	}
+}
+
+DiskCache::DiskCache(std::filesystem::path directory, uint64_t capacity,
+	uint64_t segmentSize) noexcept :
+	m_directory(std::move(directory)), m_capacity(capacity),
+	m_segmentSize(std::max<uint64_t>(segmentSize, 1)) {}
+
+DiskCache::~DiskCache() noexcept
+{
+	if (m_indexFile != nullptr)
+		std::fclose(m_indexFile);
+	if (m_segmentFile != nullptr)
+		std::fclose(m_segmentFile);
+}
+
+cma::error_code DiskCache::Open() noexcept
+{
+	std::lock_guard lock(m_mutex);
+	if (m_open == true)
+		return error_code();
+	std::error_code fsEc;
+	std::filesystem::create_directories(m_directory, fsEc);
+	if (fsEc)
+		return error_code(fsEc.value(), asio::error::get_system_category());
+	// the segments are only sized, they are mapped when they're first needed
+	for (const auto& file : std::filesystem::directory_iterator(m_directory, fsEc))
+	{
+		const auto name = file.path().filename().string();
+		uint32_t id = 0;
+		if (name.starts_with(s_segmentPrefix) == false || std::from_chars(
+			name.data() + s_segmentPrefix.size(), name.data() + name.size(), id).ec != std::errc())
+			continue;
+		const auto size = file.file_size(fsEc);
+		m_segments[id].size = (fsEc) ? 0 : size;
+		m_size += m_segments[id].size;
+	}
+	// replay the index, stopping at the first record that's torn or damaged
+	std::ifstream indexStream(m_directory / "index", std::ios::binary);
+	const std::string data((std::istreambuf_iterator<char>(indexStream)),
+		std::istreambuf_iterator<char>());
+	if (std::string_view(data).starts_with(s_indexMagic) == true)
+	{
+		Reader reader(std::string_view(data).substr(s_indexMagic.size()));
+		while (reader.Empty() == false)
+		{
+			const auto record = reader.ReadBytes(reader.Read<uint32_t>());
+			std::string key;
+			IndexEntry indexEntry;
+			bool erased = false;
+			if (reader.Ok() == false || Parse(record, key, indexEntry, erased) == false)
+				break;
+			if (erased == true)
+				m_index.erase(key);
+			else
+				m_index.insert_or_assign(std::move(key), std::move(indexEntry));
+		}
+	}
+	// entries in segments that were evicted, or cut short, are gone
+	std::erase_if(m_index, [this](const auto& pair)
+		{
+			const auto segmentIt = m_segments.find(pair.second.segment);
+			return segmentIt == m_segments.end() || segmentIt->second.size <
+				pair.second.offset + pair.second.headersSize + pair.second.bodySize;
+		});
+	// the replayed index is rewritten right away, which also drops any torn tail
+	if (const auto err = Compact(); err)
+		return err;
+	// keep appending to the newest segment, unless it is full
+	uint32_t active = 0;
+	if (m_segments.empty() == false)
+	{
+		active = m_segments.rbegin()->first;
+		if (m_segments.rbegin()->second.size >= m_segmentSize)
+			++active;
+	}
+	m_segmentFile = std::fopen(SegmentPath(active).string().c_str(), "ab");
+	if (m_segmentFile == nullptr)
+		return LastError();
+	m_segments.try_emplace(active);
+	m_open = true;
+	Evict();
+	return error_code();
+}
+
+cma::CacheEntryPtr DiskCache::Find(std::string_view key) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	const auto indexIt = m_index.find(std::string(key));
+	if (indexIt == m_index.end())
+		return nullptr;
+	const auto& indexEntry = indexIt->second;
+	auto segmentIt = m_segments.find(indexEntry.segment);
+	if (segmentIt == m_segments.end())
+		return nullptr;
+	// a segment that was appended to since it was mapped needs a fresh mapping,
+	// but responses that are still using the old one keep it alive
+	auto& segment = segmentIt->second;
+	const auto end = indexEntry.offset + indexEntry.headersSize + indexEntry.bodySize;
+	if (segment.mapping == nullptr || segment.mapping->GetSize() < end)
+	{
+		auto mapping = std::make_shared<Detail::MappedFile>();
+		if (mapping->Map(SegmentPath(indexEntry.segment)) || mapping->GetSize() < end)
+			return nullptr;
+		segment.mapping = std::move(mapping);
+	}
+	const auto view = segment.mapping->GetView();
+	auto response = std::make_shared<SharedResponse>();
+	response->status = indexEntry.status;
+	response->headers = view.substr(indexEntry.offset, indexEntry.headersSize);
+	response->mapping = segment.mapping;
+	response->mappedBody = view.substr(indexEntry.offset + indexEntry.headersSize,
+		indexEntry.bodySize);
+	auto entry = std::make_shared<CacheEntry>();
+	entry->response = std::move(response);
+	entry->etag = indexEntry.etag;
+	entry->lastModified = indexEntry.lastModified;
+	entry->responseTime = CacheEntry::Clock::time_point(
+		std::chrono::seconds(indexEntry.responseTime));
+	entry->initialAge = std::chrono::seconds(indexEntry.initialAge);
+	entry->lifetime = std::chrono::seconds(indexEntry.lifetime);
+	entry->noCache = indexEntry.noCache;
+	entry->vary = indexEntry.vary;
+	return entry;
+}
+
+void DiskCache::Store(std::string_view key, CacheEntryPtr entry) noexcept
+{
+	if (entry == nullptr || entry->response == nullptr)
+		return;
+	std::lock_guard lock(m_mutex);
+	if (m_open == false)
+		return;
+	const auto& response = *entry->response;
+	IndexEntry indexEntry;
+	indexEntry.status = response.status;
+	CopyFreshness(*entry, indexEntry);
+	// a response that can never fit, or can't be written, also can't
+	// leave the one it replaces behind
+	if (response.headers.size() + response.GetBody().size() > m_capacity ||
+		Append(response, indexEntry))
+	{
+		if (m_index.erase(std::string(key)) != 0)
+			Record(key, nullptr);
+		return;
+	}
+	Record(key, &indexEntry);
+	m_index.insert_or_assign(std::string(key), std::move(indexEntry));
+	Evict();
+}
+
+void DiskCache::Refresh(std::string_view key, const CacheEntry& previous,
+	CacheEntryPtr entry) noexcept
+{
+	if (entry == nullptr)
+		return;
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_open == false)
+			return;
+		// if the entry wasn't replaced since it was found, the response on
+		// disk is still the right one, and only the index needs to change
+		const auto indexIt = m_index.find(std::string(key));
+		if (indexIt != m_index.end() && indexIt->second.etag == previous.etag &&
+			indexIt->second.lastModified == previous.lastModified &&
+			indexIt->second.responseTime == std::chrono::duration_cast<std::chrono::seconds>(
+				previous.responseTime.time_since_epoch()).count())
+		{
+			CopyFreshness(*entry, indexIt->second);
+			Record(key, &indexIt->second);
+			return;
+		}
+	}
+	Store(key, std::move(entry));
+}
+
+void DiskCache::Erase(std::string_view key) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	// the response itself stays in its segment until the segment is evicted
+	if (m_open == true && m_index.erase(std::string(key)) != 0)
+		Record(key, nullptr);
+}
+
+uint64_t DiskCache::GetSize() const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	return m_size;
+}
+
+size_t DiskCache::GetCount() const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	return m_index.size();
+}
+
+std::filesystem::path DiskCache::SegmentPath(uint32_t id) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%.*s%08u", static_cast<int>(s_segmentPrefix.size()),
+		s_segmentPrefix.data(), static_cast<unsigned>(id));
+	return m_directory / name;
+}
+
+void DiskCache::CopyFreshness(const CacheEntry& entry, IndexEntry& indexEntry) noexcept
+{
+	indexEntry.etag = entry.etag;
+	indexEntry.lastModified = entry.lastModified;
+	indexEntry.responseTime = std::chrono::duration_cast<std::chrono::seconds>(
+		entry.responseTime.time_since_epoch()).count();
+	indexEntry.initialAge = entry.initialAge.count();
+	indexEntry.lifetime = entry.lifetime.count();
+	indexEntry.noCache = entry.noCache;
+	indexEntry.vary = entry.vary;
+}
+
+std::string DiskCache::Serialize(std::string_view key, const IndexEntry* indexEntry)
+{
+	std::string record;
+	Write(record, (indexEntry != nullptr) ? RecordType::Store : RecordType::Erase);
+	WriteString(record, key);
+	if (indexEntry == nullptr)
+		return record;
+	Write(record, indexEntry->segment);
+	Write(record, indexEntry->offset);
+	Write(record, indexEntry->headersSize);
+	Write(record, indexEntry->bodySize);
+	Write<int64_t>(record, indexEntry->status);
+	WriteString(record, indexEntry->etag);
+	WriteString(record, indexEntry->lastModified);
+	Write(record, indexEntry->responseTime);
+	Write(record, indexEntry->initialAge);
+	Write(record, indexEntry->lifetime);
+	Write<uint8_t>(record, indexEntry->noCache);
+	Write<uint32_t>(record, static_cast<uint32_t>(indexEntry->vary.size()));
+	for (const auto& [name, value] : indexEntry->vary)
+	{
+		WriteString(record, name);
+		WriteString(record, value);
+	}
+	return record;
+}
+
+bool DiskCache::Parse(std::string_view record, std::string& key,
+	IndexEntry& indexEntry, bool& erased) noexcept
+{
+	Reader reader(record);
+	const auto type = reader.Read<RecordType>();
+	key = reader.ReadString();
+	erased = type == RecordType::Erase;
+	if (erased == true)
+		return reader.Ok() && type == RecordType::Erase;
+	if (type != RecordType::Store)
+		return false;
+	indexEntry.segment = reader.Read<uint32_t>();
+	indexEntry.offset = reader.Read<uint64_t>();
+	indexEntry.headersSize = reader.Read<uint64_t>();
+	indexEntry.bodySize = reader.Read<uint64_t>();
+	indexEntry.status = static_cast<long>(reader.Read<int64_t>());
+	indexEntry.etag = reader.ReadString();
+	indexEntry.lastModified = reader.ReadString();
+	indexEntry.responseTime = reader.Read<int64_t>();
+	indexEntry.initialAge = reader.Read<int64_t>();
+	indexEntry.lifetime = reader.Read<int64_t>();
+	indexEntry.noCache = reader.Read<uint8_t>() != 0;
+	const auto varyCount = reader.Read<uint32_t>();
+	for (uint32_t i = 0; i < varyCount && reader.Ok() == true; ++i)
+	{
+		auto name = reader.ReadString();
+		indexEntry.vary.emplace_back(std::move(name), reader.ReadString());
+	}
+	return reader.Ok();
+}
+
+cma::error_code DiskCache::Append(const SharedResponse& response,
+	IndexEntry& indexEntry) noexcept
+{
+	const auto body = response.GetBody();
+	const auto total = response.headers.size() + body.size();
+	auto segmentIt = std::prev(m_segments.end());
+	// seal the active segment once it's full. a response larger than a
+	// segment gets one to itself
+	if (segmentIt->second.size > 0 && segmentIt->second.size + total > m_segmentSize)
+	{
+		std::fclose(m_segmentFile);
+		const auto id = segmentIt->first + 1;
+		m_segmentFile = std::fopen(SegmentPath(id).string().c_str(), "ab");
+		segmentIt = m_segments.try_emplace(id).first;
+	}
+	// try again if the active segment couldn't be opened before
+	if (m_segmentFile == nullptr)
+		m_segmentFile = std::fopen(SegmentPath(segmentIt->first).string().c_str(), "ab");
+	if (m_segmentFile == nullptr)
+		return LastError();
+	auto& segment = segmentIt->second;
+	indexEntry.segment = segmentIt->first;
+	indexEntry.offset = segment.size;
+	indexEntry.headersSize = response.headers.size();
+	indexEntry.bodySize = body.size();
+	const auto written = std::fwrite(response.headers.data(), 1, response.headers.size(),
+		m_segmentFile) + std::fwrite(body.data(), 1, body.size(), m_segmentFile);
+	const auto flushed = std::fflush(m_segmentFile) == 0;
+	if (written != total || flushed == false)
+	{
+		const auto err = LastError();
+		// we no longer know where the segment ends, so don't append to it again
+		m_size += m_segmentSize - std::min(segment.size, m_segmentSize);
+		segment.size = std::max(segment.size, m_segmentSize);
+		return err;
+	}
+	segment.size += total;
+	m_size += total;
+	return error_code();
+}
+
+void DiskCache::Record(std::string_view key, const IndexEntry* indexEntry) noexcept
+{
+	if (m_indexFile == nullptr)
+		return;
+	const auto record = Serialize(key, indexEntry);
+	std::string framed;
+	Write<uint32_t>(framed, static_cast<uint32_t>(record.size()));
+	framed += record;
+	std::fwrite(framed.data(), 1, framed.size(), m_indexFile);
+	std::fflush(m_indexFile);
+	// rewrite the index once most of it describes entries that are gone
+	if (++m_records > 2 * m_index.size() + 1024)
+		Compact();
+}
+
+cma::error_code DiskCache::Compact() noexcept
+{
+	const auto indexPath = m_directory / "index";
+	const auto tempPath = m_directory / "index.tmp";
+	auto file = std::fopen(tempPath.string().c_str(), "wb");
+	if (file == nullptr)
+		return LastError();
+	bool ok = std::fwrite(s_indexMagic.data(), 1, s_indexMagic.size(), file) ==
+		s_indexMagic.size();
+	std::string framed;
+	for (const auto& [key, indexEntry] : m_index)
+	{
+		const auto record = Serialize(key, &indexEntry);
+		framed.clear();
+		Write<uint32_t>(framed, static_cast<uint32_t>(record.size()));
+		framed += record;
+		ok = ok && std::fwrite(framed.data(), 1, framed.size(), file) == framed.size();
+	}
+	ok = std::fflush(file) == 0 && ok;
+	const auto err = LastError();
+	std::fclose(file);
+	if (ok == false)
+	{
+		std::remove(tempPath.string().c_str());
+		return err;
+	}
+	// swap in the new index in one step, so that a crash leaves one or the other
+	if (m_indexFile != nullptr)
+		std::fclose(m_indexFile);
+	std::error_code fsEc;
+	std::filesystem::rename(tempPath, indexPath, fsEc);
+	m_indexFile = std::fopen(indexPath.string().c_str(), "ab");
+	m_records = m_index.size();
+	if (fsEc)
+		return error_code(fsEc.value(), asio::error::get_system_category());
+	return (m_indexFile == nullptr) ? LastError() : error_code();
+}
+
+void DiskCache::Evict() noexcept
+{
+	// the active segment is never evicted, it's the last one
+	while (m_size > m_capacity && m_segments.size() > 1)
+	{
+		const auto oldest = m_segments.begin();
+		const auto id = oldest->first;
+		m_size -= oldest->second.size;
+		// responses still using the segment keep their mapping of it
+		std::error_code fsEc;
+		std::filesystem::remove(SegmentPath(id), fsEc);
+		m_segments.erase(oldest);
+		// no records needed, entries pointing at missing segments are
+		// dropped when the index is replayed
+		std::erase_if(m_index, [id](const auto& pair)
+			{
+				return pair.second.segment == id;
+			});
+	}
+}
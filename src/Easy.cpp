@@ -9,7 +9,13 @@ Easy::Easy() noexcept :
 // just duplicate the raw handle
 Easy::Easy(const Easy& other) noexcept :
 	m_nativeHandle(curl_easy_duphandle(other.GetNativeHandle()), curl_easy_cleanup),
-	m_headerList(nullptr, curl_slist_free_all) 
+	m_headerList(nullptr, curl_slist_free_all),
+	// the duplicate writes to the same buffer
+	m_buffer(other.m_buffer), m_bufferOps(other.m_bufferOps),
+	m_bufferMark(other.m_bufferMark), m_headerFunction(other.m_headerFunction),
+	m_headerData(other.m_headerData), m_timeout(other.m_timeout),
+	m_verbose(other.m_verbose), m_debugFunction(other.m_debugFunction),
+	m_debugData(other.m_debugData)
 {
 	// add each header manually
 	for (auto node = other.m_headerList.get(); node != nullptr;
@@ -22,6 +28,15 @@ Easy& Easy::operator=(const Easy& other) noexcept
 	if (this == &other)
 		return *this;
 	m_nativeHandle.reset(curl_easy_duphandle(other.GetNativeHandle()));
+	m_buffer = other.m_buffer;
+	m_bufferOps = other.m_bufferOps;
+	m_bufferMark = other.m_bufferMark;
+	m_headerFunction = other.m_headerFunction;
+	m_headerData = other.m_headerData;
+	m_timeout = other.m_timeout;
+	m_verbose = other.m_verbose;
+	m_debugFunction = other.m_debugFunction;
+	m_debugData = other.m_debugData;
 	return *this;
 }
 
@@ -50,6 +65,7 @@ bool Easy::AddHeader(std::pair<std::string_view, std::string_view> header) noexc
 
 cma::error_code Easy::SetBuffer(DefaultBuffer) noexcept
 {
+	m_buffer = nullptr;
 	return SetOption(CURLoption::CURLOPT_WRITEFUNCTION, nullptr);
 }
 
@@ -59,5 +75,11 @@ cma::error_code Easy::SetBuffer(NullBuffer) noexcept
 	if (auto res = SetOption(CURLoption::CURLOPT_WRITEFUNCTION,
 		Easy::WriteCb<NullBuffer>); res)
 		return res;
-	return SetOption(CURLoption::CURLOPT_WRITEDATA, &s_nb);
+	if (auto res = SetOption(CURLoption::CURLOPT_WRITEDATA, &s_nb); res)
+		return res;
+	// a null buffer can be rewound and refilled too, it just does nothing
+	m_buffer = &s_nb;
+	m_bufferOps = GetBufferOps<NullBuffer>();
+	m_bufferMark = 0;
+	return {};
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include <curl-multi-asio/EndpointSet.h>
+
+#include <algorithm>
+#include <random>
+
+using cma::EndpointSet;
+
+EndpointSet::EndpointSet(std::string service, uint16_t servicePort,
+	std::vector<Endpoint> endpoints) noexcept :
+	m_service(std::move(service)), m_servicePort(servicePort),
+	m_endpoints(std::move(endpoints)),
+	m_stats(std::make_unique<Stats[]>(m_endpoints.size())) {}
+
+size_t EndpointSet::Pick() noexcept
+{
+	size_t index = 0;
+	if (m_endpoints.size() > 1)
+	{
+		// two distinct replicas at random, the less loaded one wins
+		thread_local std::minstd_rand rng(std::random_device{}());
+		const auto first = std::uniform_int_distribution<size_t>(
+			0, m_endpoints.size() - 1)(rng);
+		auto second = std::uniform_int_distribution<size_t>(
+			0, m_endpoints.size() - 2)(rng);
+		if (second >= first)
+			++second;
+		index = (GetLoad(second) < GetLoad(first)) ? second : first;
+	}
+	m_stats[index].inFlight.fetch_add(1, std::memory_order_relaxed);
+	m_stats[index].picks.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
+
+void EndpointSet::Finish(size_t index,
+	std::optional<std::chrono::steady_clock::duration> latency, bool failed) noexcept
+{
+	auto& stats = m_stats[index];
+	stats.inFlight.fetch_sub(1, std::memory_order_relaxed);
+	if (latency.has_value() == false)
+		return;
+	auto sample = std::chrono::duration_cast<std::chrono::microseconds>(*latency);
+	if (failed == true)
+		sample = std::max<std::chrono::microseconds>(sample, failurePenalty);
+	const auto sampleUs = static_cast<double>(std::max<int64_t>(sample.count(), 1));
+	auto current = stats.latency.load(std::memory_order_relaxed);
+	uint64_t next;
+	do
+	{
+		// the first sample starts the average
+		next = (current == 0) ? static_cast<uint64_t>(sampleUs) :
+			static_cast<uint64_t>(smoothing * sampleUs +
+				(1.0 - smoothing) * static_cast<double>(current));
+		next = std::max<uint64_t>(next, 1);
+	} while (stats.latency.compare_exchange_weak(current, next,
+		std::memory_order_relaxed) == false);
+}
+
+std::string EndpointSet::GetConnectTo(size_t index) const
+{
+	const auto& endpoint = m_endpoints[index];
+	std::string connectTo = m_service;
+	connectTo += ':';
+	if (m_servicePort != 0)
+		connectTo += std::to_string(m_servicePort);
+	connectTo += ':';
+	connectTo += endpoint.host;
+	connectTo += ':';
+	connectTo += std::to_string(endpoint.port);
+	return connectTo;
+}
+
+size_t EndpointSet::GetInFlight(size_t index) const noexcept
+{
+	return m_stats[index].inFlight.load(std::memory_order_relaxed);
+}
+
+std::chrono::microseconds EndpointSet::GetLatency(size_t index) const noexcept
+{
+	return std::chrono::microseconds(m_stats[index].latency.load(std::memory_order_relaxed));
+}
+
+size_t EndpointSet::GetPicks(size_t index) const noexcept
+{
+	return m_stats[index].picks.load(std::memory_order_relaxed);
+}
+
+double EndpointSet::GetLoad(size_t index) const noexcept
+{
+	auto latency = static_cast<double>(m_stats[index].latency.load(std::memory_order_relaxed));
+	// a replica without samples yet is assumed to be as fast as the average
+	// of the others, so it gets its share of traffic but isn't flooded
+	if (latency == 0.0)
+	{
+		double sum = 0.0;
+		size_t known = 0;
+		for (size_t i = 0; i < m_endpoints.size(); ++i)
+		{
+			if (const auto other = m_stats[i].latency.load(std::memory_order_relaxed); other != 0)
+			{
+				sum += static_cast<double>(other);
+				++known;
+			}
+		}
+		latency = (known == 0) ? 1.0 : sum / static_cast<double>(known);
+	}
+	return static_cast<double>(GetInFlight(index) + 1) * latency;
+}
@@ -0,0 +1,111 @@
+#include <curl-multi-asio/FlightRecorder.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+using cma::FlightRecorder;
+
+FlightRecorder::FlightRecorder(size_t capacity, std::ostream* failures) :
+	m_epoch(std::chrono::steady_clock::now()),
+	m_slots(std::make_unique<Slot[]>(std::bit_ceil(std::max<size_t>(capacity, 1)))),
+	m_mask(std::bit_ceil(std::max<size_t>(capacity, 1)) - 1), m_failures(failures) {}
+
+void FlightRecorder::Record(CURL* easy, curl_infotype type, const char* data,
+	size_t size) noexcept
+{
+	const auto number = m_next.fetch_add(1, std::memory_order_relaxed);
+	auto& slot = m_slots[number & m_mask];
+	// readers that see the slot odd, or see it change, skip it
+	slot.sequence.store(number * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.time = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - m_epoch).count();
+	slot.easy = easy;
+	slot.size = size;
+	slot.type = static_cast<uint8_t>(type);
+	slot.length = 0;
+	// data is only worth its size, the rest is kept up to a slot's worth
+	if (type == CURLINFO_TEXT || type == CURLINFO_HEADER_IN || type == CURLINFO_HEADER_OUT)
+	{
+		slot.length = static_cast<uint8_t>(std::min(size, s_textSize));
+		std::memcpy(slot.text, data, slot.length);
+	}
+	slot.sequence.store(number * 2 + 2, std::memory_order_release);
+}
+
+void FlightRecorder::Dump(std::ostream& out, const CURL* easy) const
+{
+	const auto next = m_next.load(std::memory_order_acquire);
+	const auto capacity = static_cast<uint64_t>(m_mask) + 1;
+	char line[64 + s_textSize];
+	for (auto number = (next > capacity) ? next - capacity : 0; number < next; ++number)
+	{
+		const auto& slot = m_slots[number & m_mask];
+		const auto sequence = number * 2 + 2;
+		if (slot.sequence.load(std::memory_order_acquire) != sequence)
+			continue;
+		// copy it out, then make sure it wasn't overwritten meanwhile
+		const auto time = slot.time;
+		const auto transfer = slot.easy;
+		const auto size = slot.size;
+		const auto type = static_cast<curl_infotype>(slot.type);
+		auto length = static_cast<size_t>(slot.length);
+		char text[s_textSize];
+		std::memcpy(text, slot.text, length);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+			continue;
+		if (easy != nullptr && transfer != easy)
+			continue;
+		while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r'))
+			--length;
+		const char* prefix = nullptr;
+		const char* what = nullptr;
+		switch (type)
+		{
+		case CURLINFO_TEXT:
+			prefix = "*";
+			break;
+		case CURLINFO_HEADER_IN:
+			prefix = "<";
+			break;
+		case CURLINFO_HEADER_OUT:
+			prefix = ">";
+			break;
+		case CURLINFO_DATA_IN:
+			prefix = "{", what = "data";
+			break;
+		case CURLINFO_DATA_OUT:
+			prefix = "}", what = "data";
+			break;
+		case CURLINFO_SSL_DATA_IN:
+			prefix = "{", what = "SSL data";
+			break;
+		default:
+			prefix = "}", what = "SSL data";
+			break;
+		}
+		int written = 0;
+		if (what != nullptr)
+			written = std::snprintf(line, sizeof(line), "%10.3fms %p %s [%llu bytes %s]\n",
+				time / 1000.0, transfer, prefix, static_cast<unsigned long long>(size), what);
+		else
+			written = std::snprintf(line, sizeof(line), "%10.3fms %p %s %.*s%s\n",
+				time / 1000.0, transfer, prefix, static_cast<int>(length), text,
+				(size > s_textSize) ? "..." : "");
+		out.write(line, std::min<size_t>(written, sizeof(line) - 1));
+	}
+}
+
+void FlightRecorder::DumpFailure(const CURL* easy, const error_code& ec) const
+{
+	if (m_failures == nullptr)
+		return;
+	std::lock_guard lock(m_failuresMutex);
+	*m_failures << "transfer " << static_cast<const void*>(easy) << " failed: "
+		<< ec.message() << '\n';
+	Dump(*m_failures, easy);
+	m_failures->flush();
+}
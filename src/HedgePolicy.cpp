@@ -0,0 +1,69 @@
+#include <curl-multi-asio/HedgePolicy.h>
+
+#include <algorithm>
+
+using cma::HedgePolicy;
+
+std::chrono::milliseconds HedgePolicy::GetDelay() noexcept
+{
+	const auto samples = m_samples.load(std::memory_order_relaxed);
+	if (percentile <= 0.0 || percentile >= 1.0 || samples < std::max<size_t>(minSamples, 1))
+		return delay;
+	// sorting the window on every request would be wasteful, so
+	// only recompute once enough new samples came in
+	if (samples - m_cachedAt.load(std::memory_order_relaxed) >= s_recomputeEvery ||
+		m_cachedPercentile.load(std::memory_order_relaxed) == 0)
+	{
+		const auto count = std::min(samples, s_windowSize);
+		std::array<uint32_t, s_windowSize> sorted;
+		for (size_t i = 0; i < count; ++i)
+			sorted[i] = m_window[i].load(std::memory_order_relaxed);
+		const auto nth = sorted.begin() + static_cast<ptrdiff_t>(
+			percentile * static_cast<double>(count - 1));
+		std::nth_element(sorted.begin(), nth, sorted.begin() + count);
+		m_cachedPercentile.store(std::max<uint32_t>(*nth, 1), std::memory_order_relaxed);
+		m_cachedAt.store(samples, std::memory_order_relaxed);
+	}
+	// round up, hedging a little late is better than too early
+	return std::chrono::milliseconds((m_cachedPercentile.load(
+		std::memory_order_relaxed) + 999) / 1000);
+}
+
+void HedgePolicy::OnRequest() noexcept
+{
+	const auto earned = static_cast<int64_t>(maxHedgeRatio * 1000.0);
+	const auto cap = static_cast<int64_t>(maxBurst * 1000.0);
+	auto tokens = m_milliTokens.load(std::memory_order_relaxed);
+	while (tokens < cap && m_milliTokens.compare_exchange_weak(tokens,
+		std::min(tokens + earned, cap), std::memory_order_relaxed) == false);
+}
+
+bool HedgePolicy::TryHedge() noexcept
+{
+	auto tokens = m_milliTokens.load(std::memory_order_relaxed);
+	do
+	{
+		if (tokens < 1000)
+			return false;
+	} while (m_milliTokens.compare_exchange_weak(tokens, tokens - 1000,
+		std::memory_order_relaxed) == false);
+	m_launched.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void HedgePolicy::RefundHedge() noexcept
+{
+	const auto cap = static_cast<int64_t>(maxBurst * 1000.0);
+	auto tokens = m_milliTokens.load(std::memory_order_relaxed);
+	while (tokens < cap && m_milliTokens.compare_exchange_weak(tokens,
+		std::min<int64_t>(tokens + 1000, cap), std::memory_order_relaxed) == false);
+	m_launched.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void HedgePolicy::RecordLatency(std::chrono::steady_clock::duration latency) noexcept
+{
+	const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+	const auto clamped = static_cast<uint32_t>(std::clamp<int64_t>(micros, 1, UINT32_MAX));
+	const auto index = m_samples.fetch_add(1, std::memory_order_relaxed) % s_windowSize;
+	m_window[index].store(clamped, std::memory_order_relaxed);
+}
@@ -0,0 +1,110 @@
+#include <curl-multi-asio/HttpCache.h>
+
+using cma::HttpCache;
+
+HttpCache::HttpCache(Multi& multi, std::shared_ptr<CacheStore> store,
+	Configure configure) noexcept :
+	m_multi(multi), m_store(std::move(store)), m_configure(std::move(configure))
+{
+}
+
+void HttpCache::Perform(HttpRequest&& request,
+	std::unique_ptr<Detail::ResponseHandlerBase> handler) noexcept
+{
+	auto transfer = std::make_unique<Transfer>();
+	const auto cacheControl = Detail::CacheControl::Parse(
+		request.FindHeader("cache-control").value_or(""));
+	// the caller's own conditional requests get the caller's own 304s
+	transfer->cacheable = request.method == "GET" && cacheControl.noStore == false &&
+		request.FindHeader("if-none-match").has_value() == false &&
+		request.FindHeader("if-modified-since").has_value() == false &&
+		request.FindHeader("range").has_value() == false;
+	transfer->key = "GET " + request.url;
+	if (transfer->cacheable == true)
+	{
+		auto cached = m_store->Find(transfer->key);
+		if (cached != nullptr && cached->Matches(request) == true)
+		{
+			const auto now = CacheEntry::Clock::now();
+			if (cacheControl.noCache == false && cached->Fresh(now) == true &&
+				(cacheControl.maxAge.has_value() == false ||
+					cached->Age(now) <= *cacheControl.maxAge))
+			{
+				m_hits.fetch_add(1, std::memory_order_relaxed);
+				asio::post(m_multi.GetExecutor(), [handler = std::move(handler),
+					response = cached->response]() mutable
+					{
+						handler->Complete(error_code(), std::move(response));
+					});
+				return;
+			}
+			if (cached->HasValidators() == true)
+				transfer->cached = std::move(cached);
+		}
+	}
+	auto& easy = transfer->easy;
+	if (m_configure)
+		m_configure(easy);
+	easy.SetURL(request.url.c_str());
+	if (request.method != "GET")
+		easy.SetOption(CURLoption::CURLOPT_CUSTOMREQUEST, request.method.c_str());
+	for (const auto& [name, value] : request.headers)
+		easy.AddHeader({ name, value });
+	if (transfer->cached != nullptr)
+	{
+		if (transfer->cached->etag.empty() == false)
+			easy.AddHeader({ "If-None-Match", transfer->cached->etag });
+		if (transfer->cached->lastModified.empty() == false)
+			easy.AddHeader({ "If-Modified-Since", transfer->cached->lastModified });
+	}
+	transfer->response = std::make_shared<SharedResponse>();
+	easy.SetBuffer(transfer->response->body);
+	easy.SetOption(CURLoption::CURLOPT_HEADERFUNCTION, &Detail::HeaderCb);
+	easy.SetOption(CURLoption::CURLOPT_HEADERDATA, &transfer->response->headers);
+	transfer->request = std::move(request);
+	transfer->handler = std::move(handler);
+	transfer->requestTime = CacheEntry::Clock::now();
+	m_multi.AsyncPerform(easy, [this, transfer = std::move(transfer)](
+		const error_code& ec) mutable
+		{
+			Finish(std::move(transfer), ec);
+		});
+}
+
+void HttpCache::Finish(std::unique_ptr<Transfer> transfer, error_code ec) noexcept
+{
+	if (ec)
+	{
+		transfer->handler->Complete(ec, nullptr);
+		return;
+	}
+	const auto responseTime = CacheEntry::Clock::now();
+	transfer->easy.GetInfo(CURLINFO_RESPONSE_CODE, transfer->response->status);
+	if (transfer->response->status == 304 && transfer->cached != nullptr)
+	{
+		auto refreshed = std::make_shared<CacheEntry>(*transfer->cached);
+		refreshed->Refresh(transfer->response->headers, transfer->requestTime, responseTime);
+		m_store->Refresh(transfer->key, *transfer->cached, refreshed);
+		m_revalidations.fetch_add(1, std::memory_order_relaxed);
+		transfer->handler->Complete(error_code(), refreshed->response);
+		return;
+	}
+	m_misses.fetch_add(1, std::memory_order_relaxed);
+	ResponsePtr response = std::move(transfer->response);
+	if (transfer->cacheable == true)
+	{
+		auto entry = CacheEntry::FromResponse(transfer->request, response,
+			transfer->requestTime, responseTime);
+		// a response that can't be stored still replaces the one that was
+		if (entry.has_value() == true)
+			m_store->Store(transfer->key, std::make_shared<CacheEntry>(std::move(*entry)));
+		else
+			m_store->Erase(transfer->key);
+	}
+	else if (transfer->request.method != "GET" && transfer->request.method != "HEAD" &&
+		response->status < 400)
+	{
+		m_store->Erase(transfer->key);
+	}
+	transfer->handler->Complete(error_code(), std::move(response));
+}
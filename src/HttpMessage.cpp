@@ -0,0 +1,63 @@
+#include <curl-multi-asio/HttpMessage.h>
+
+#include <algorithm>
+#include <cctype>
+
+using cma::HttpRequest;
+
+std::optional<std::string_view> HttpRequest::FindHeader(std::string_view name) const noexcept
+{
+	for (const auto& [headerName, value] : headers)
+	{
+		if (Detail::HeaderNameEquals(headerName, name) == true)
+			return value;
+	}
+	return std::nullopt;
+}
+
+bool cma::Detail::HeaderNameEquals(std::string_view a, std::string_view b) noexcept
+{
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+		[](unsigned char x, unsigned char y)
+		{
+			return std::tolower(x) == std::tolower(y);
+		});
+}
+
+std::optional<std::string_view> cma::Detail::FindHeader(std::string_view headers,
+	std::string_view name) noexcept
+{
+	std::optional<std::string_view> found;
+	while (headers.empty() == false)
+	{
+		auto end = headers.find('\n');
+		auto line = headers.substr(0, end);
+		headers.remove_prefix((end == std::string_view::npos) ? headers.size() : end + 1);
+		if (line.empty() == false && line.back() == '\r')
+			line.remove_suffix(1);
+		// a status line starts the headers of another response
+		if (line.starts_with("HTTP/"))
+		{
+			found.reset();
+			continue;
+		}
+		const auto colon = line.find(':');
+		if (colon == std::string_view::npos ||
+			HeaderNameEquals(line.substr(0, colon), name) == false)
+			continue;
+		auto value = line.substr(colon + 1);
+		while (value.empty() == false && (value.front() == ' ' || value.front() == '\t'))
+			value.remove_prefix(1);
+		while (value.empty() == false && (value.back() == ' ' || value.back() == '\t'))
+			value.remove_suffix(1);
+		found = value;
+	}
+	return found;
+}
+
+size_t cma::Detail::HeaderCb(char* buffer, size_t size, size_t nitems,
+	std::string* headers) noexcept
+{
+	headers->append(buffer, size * nitems);
+	return size * nitems;
+}
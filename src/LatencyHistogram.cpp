@@ -0,0 +1,124 @@
+#include <curl-multi-asio/LatencyHistogram.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+using cma::LatencyHistogram;
+using cma::TransferTimings;
+
+void LatencyHistogram::Snapshot::Merge(const Snapshot& other) noexcept
+{
+	if (other.m_count == 0)
+		return;
+	if (m_counts.size() < other.m_counts.size())
+		m_counts.resize(other.m_counts.size(), 0);
+	for (size_t i = 0; i < other.m_counts.size(); ++i)
+		m_counts[i] += other.m_counts[i];
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	m_min = std::min(m_min, other.m_min);
+	m_max = std::max(m_max, other.m_max);
+}
+
+std::chrono::microseconds LatencyHistogram::Snapshot::GetMin() const noexcept
+{
+	return std::chrono::microseconds((m_count == 0) ? 0 : m_min);
+}
+
+std::chrono::microseconds LatencyHistogram::Snapshot::GetMean() const noexcept
+{
+	return std::chrono::microseconds((m_count == 0) ? 0 : m_sum / m_count);
+}
+
+std::chrono::microseconds LatencyHistogram::Snapshot::GetPercentile(
+	double percentile) const noexcept
+{
+	if (m_count == 0)
+		return std::chrono::microseconds(0);
+	const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(
+		std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(m_count))));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < m_counts.size(); ++i)
+	{
+		seen += m_counts[i];
+		// the bucket's bound may overshoot the largest latency
+		if (seen >= rank)
+			return std::chrono::microseconds(std::min(UpperBound(i), m_max));
+	}
+	return GetMax();
+}
+
+void LatencyHistogram::Record(std::chrono::microseconds latency) noexcept
+{
+	const auto value = std::min<uint64_t>(static_cast<uint64_t>(
+		std::max<int64_t>(latency.count(), 0)), (uint64_t(1) << s_maxBits) - 1);
+	m_counts[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+	m_sum.fetch_add(value, std::memory_order_relaxed);
+	auto min = m_min.load(std::memory_order_relaxed);
+	while (value < min && m_min.compare_exchange_weak(min, value,
+		std::memory_order_relaxed) == false);
+	auto max = m_max.load(std::memory_order_relaxed);
+	while (value > max && m_max.compare_exchange_weak(max, value,
+		std::memory_order_relaxed) == false);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const
+{
+	Snapshot snapshot;
+	GetSnapshot(snapshot);
+	return snapshot;
+}
+
+void LatencyHistogram::GetSnapshot(Snapshot& snapshot) const
+{
+	snapshot.m_counts.resize(s_buckets);
+	snapshot.m_count = 0;
+	// the count is taken from the buckets, so that percentiles
+	// always add up even while latencies are being recorded
+	for (size_t i = 0; i < s_buckets; ++i)
+	{
+		snapshot.m_counts[i] = m_counts[i].load(std::memory_order_relaxed);
+		snapshot.m_count += snapshot.m_counts[i];
+	}
+	snapshot.m_sum = m_sum.load(std::memory_order_relaxed);
+	snapshot.m_min = m_min.load(std::memory_order_relaxed);
+	snapshot.m_max = m_max.load(std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::BucketOf(uint64_t value) noexcept
+{
+	if (value < s_subBuckets)
+		return static_cast<size_t>(value);
+	// the power of two, and the top bits below its leading one
+	const auto magnitude = static_cast<unsigned>(std::bit_width(value)) - 1;
+	const auto sub = (value >> (magnitude - s_subBits)) & (s_subBuckets - 1);
+	return s_subBuckets * (magnitude - s_subBits + 1) + static_cast<size_t>(sub);
+}
+
+uint64_t LatencyHistogram::LowerBound(size_t bucket) noexcept
+{
+	if (bucket < s_subBuckets)
+		return bucket;
+	const auto magnitude = static_cast<unsigned>(bucket / s_subBuckets) + s_subBits - 1;
+	const auto shift = magnitude - s_subBits;
+	return (s_subBuckets + bucket % s_subBuckets) << shift;
+}
+
+uint64_t LatencyHistogram::UpperBound(size_t bucket) noexcept
+{
+	if (bucket < s_subBuckets)
+		return bucket;
+	const auto magnitude = static_cast<unsigned>(bucket / s_subBuckets) + s_subBits - 1;
+	const auto shift = magnitude - s_subBits;
+	return LowerBound(bucket) + (uint64_t(1) << shift) - 1;
+}
+
+void TransferTimings::Merge(const TransferTimings& other) noexcept
+{
+	nameLookup.Merge(other.nameLookup);
+	connect.Merge(other.connect);
+	appConnect.Merge(other.appConnect);
+	startTransfer.Merge(other.startTransfer);
+	total.Merge(other.total);
+}
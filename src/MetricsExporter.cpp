@@ -0,0 +1,283 @@
+#include <curl-multi-asio/MetricsExporter.h>
+
+#include <curl-multi-asio/Multi.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+using cma::MetricsExporter;
+
+namespace
+{
+	/// @brief The upper bounds of the histogram buckets, in microseconds
+	constexpr std::array<uint64_t, 18> s_bounds{ 100, 250, 500, 1000, 2500, 5000,
+		10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000,
+		10000000, 30000000, 60000000 };
+	/// @brief The same bounds in seconds, as canonical OpenMetrics numbers
+	constexpr std::array<std::string_view, 18> s_boundLabels{ "0.0001", "0.00025",
+		"0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25",
+		"0.5", "1.0", "2.5", "5.0", "10.0", "30.0", "60.0" };
+	/// @brief The names of the transfer phases, see TransferTimings
+	constexpr std::array<std::string_view, 5> s_phases{ "name_lookup", "connect",
+		"app_connect", "start_transfer", "total" };
+
+	/// @param histograms The histograms of each phase
+	/// @return Them in the order of s_phases
+	std::array<const cma::LatencyHistogram*, 5> GetPhases(
+		const cma::Detail::TimingRecorder::Histograms& histograms) noexcept
+	{
+		return { &histograms.nameLookup, &histograms.connect, &histograms.appConnect,
+			&histograms.startTransfer, &histograms.total };
+	}
+}
+
+/// @brief Appends to the caller's buffer without ever overrunning it,
+/// while still counting the size of everything appended
+class MetricsExporter::Output
+{
+public:
+	Output(char* buffer, size_t size) noexcept : m_buffer(buffer), m_size(size) {}
+
+	/// @param text The text to append
+	void Append(std::string_view text) noexcept
+	{
+		if (m_length < m_size)
+			std::memcpy(m_buffer + m_length, text.data(), std::min(text.size(), m_size - m_length));
+		m_length += text.size();
+	}
+	/// @param value The number to append
+	void Append(uint64_t value) noexcept
+	{
+		char number[24];
+		const auto length = std::snprintf(number, sizeof(number), "%llu",
+			static_cast<unsigned long long>(value));
+		Append(std::string_view(number, length));
+	}
+	/// @param value The duration to append, in seconds
+	void AppendSeconds(std::chrono::microseconds value) noexcept
+	{
+		char number[32];
+		const auto length = std::snprintf(number, sizeof(number), "%.6f",
+			static_cast<double>(value.count()) / 1e6);
+		Append(std::string_view(number, length));
+	}
+	/// @brief Appends a label value, escaped
+	/// @param value The value
+	void AppendLabel(std::string_view value) noexcept
+	{
+		for (auto c : value)
+		{
+			if (c == '\\')
+				Append("\\\\");
+			else if (c == '"')
+				Append("\\\"");
+			else if (c == '\n')
+				Append("\\n");
+			else
+				Append(std::string_view(&c, 1));
+		}
+	}
+	/// @brief Appends the name and labels of a series
+	/// @param family The metric family
+	/// @param suffix The suffix of the series, like _total
+	/// @param multi The multi label
+	/// @param origin The origin label, if any
+	/// @param phase The phase label, if any
+	/// @param le The le label, if any
+	void AppendSeries(std::string_view family, std::string_view suffix, std::string_view multi,
+		std::string_view origin = {}, std::string_view phase = {}, std::string_view le = {}) noexcept
+	{
+		Append(family);
+		Append(suffix);
+		Append("{multi=\"");
+		AppendLabel(multi);
+		for (auto [name, value] : { std::pair{ "\",origin=\"", origin },
+			std::pair{ "\",phase=\"", phase }, std::pair{ "\",le=\"", le } })
+		{
+			if (value.empty() == true)
+				continue;
+			Append(name);
+			AppendLabel(value);
+		}
+		Append("\"} ");
+	}
+	/// @brief Appends the metadata of a metric family
+	/// @param family The metric family
+	/// @param type Its type
+	/// @param help Its description
+	void AppendFamily(std::string_view family, std::string_view type,
+		std::string_view help) noexcept
+	{
+		Append("# TYPE ");
+		Append(family);
+		Append(" ");
+		Append(type);
+		Append("\n# HELP ");
+		Append(family);
+		Append(" ");
+		Append(help);
+		Append("\n");
+	}
+
+	/// @return The size of everything appended
+	inline size_t GetLength() const noexcept { return m_length; }
+private:
+	char* m_buffer;
+	size_t m_size;
+	size_t m_length = 0;
+};
+
+void MetricsExporter::Add(std::string name, const Multi& multi)
+{
+	std::lock_guard lock(m_mutex);
+	m_sources.push_back({ std::move(name), &multi, {} });
+}
+
+void MetricsExporter::Remove(const Multi& multi) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	std::erase_if(m_sources, [&multi](const Source& source)
+		{
+			return source.multi == &multi;
+		});
+}
+
+size_t MetricsExporter::Write(char* buffer, size_t size)
+{
+	std::lock_guard lock(m_mutex);
+	Output out(buffer, size);
+	for (auto& source : m_sources)
+		source.stats = source.multi->GetStats();
+	struct Scalar
+	{
+		std::string_view family;
+		std::string_view type;
+		std::string_view help;
+		uint64_t(*get)(const Source&);
+	};
+	const Scalar scalars[] = {
+		{ "cma_transfers_queued", "gauge", "Transfers waiting for the strand",
+			[](const Source& source) { return source.stats.queued; } },
+		{ "cma_transfers_in_flight", "gauge", "Transfers on the multi handle",
+			[](const Source& source) { return source.stats.inFlight; } },
+		{ "cma_transfers_completed", "counter", "Transfers that completed without an error",
+			[](const Source& source) { return source.stats.completed; } },
+		{ "cma_transfers_failed", "counter", "Transfers that completed with an error",
+			[](const Source& source) { return source.stats.failed; } },
+		{ "cma_transfers_cancelled", "counter", "Transfers that were cancelled",
+			[](const Source& source) { return source.stats.cancelled; } },
+		{ "cma_sockets_open", "gauge", "Sockets cURL has open",
+			[](const Source& source) { return source.stats.openSockets; } },
+		{ "cma_received_bytes", "counter", "Bytes received by finished attempts",
+			[](const Source& source) { return source.stats.bytesDown; } },
+		{ "cma_sent_bytes", "counter", "Bytes sent by finished attempts",
+			[](const Source& source) { return source.stats.bytesUp; } },
+		{ "cma_connections_opened", "counter", "Connections made by finished attempts",
+			[](const Source& source) { return source.stats.connectionsOpened; } },
+		{ "cma_connections_reused", "counter", "Attempts that succeeded on a reused connection",
+			[](const Source& source) { return source.stats.connectionsReused; } },
+		{ "cma_timer_rearms", "counter", "Times a timer was armed",
+			[](const Source& source) { return source.stats.timerRearms; } },
+		{ "cma_strand_turns", "counter", "Turns the strand took for socket events and timers",
+			[](const Source& source) { return source.multi->m_instruments->turns.load(
+				std::memory_order_relaxed); } },
+		{ "cma_strand_events", "counter", "Transfers completed in the strand's turns",
+			[](const Source& source) { return source.multi->m_instruments->events.load(
+				std::memory_order_relaxed); } }
+	};
+	for (const auto& scalar : scalars)
+	{
+		out.AppendFamily(scalar.family, scalar.type, scalar.help);
+		for (const auto& source : m_sources)
+		{
+			out.AppendSeries(scalar.family, (scalar.type == "counter") ? "_total" : "",
+				source.name);
+			out.Append(scalar.get(source));
+			out.Append("\n");
+		}
+	}
+	out.AppendFamily("cma_transfer_seconds", "histogram",
+		"Time from the start of the last attempt of transfers until each phase ended");
+	for (const auto& source : m_sources)
+	{
+		const auto phases = GetPhases(source.multi->m_instruments->timings.GetHistograms());
+		for (size_t i = 0; i < phases.size(); ++i)
+			WriteHistogram(out, "cma_transfer_seconds", source, {}, s_phases[i], *phases[i]);
+	}
+	out.AppendFamily("cma_origin_transfer_seconds", "histogram",
+		"Time from the start of the last attempt of transfers to each origin until each phase ended");
+	for (const auto& source : m_sources)
+	{
+		source.multi->m_instruments->timings.ForEachOrigin(
+			[&](std::string_view origin, const Detail::TimingRecorder::Histograms& histograms)
+			{
+				const auto phases = GetPhases(histograms);
+				for (size_t i = 0; i < phases.size(); ++i)
+					WriteHistogram(out, "cma_origin_transfer_seconds", source, origin,
+						s_phases[i], *phases[i]);
+			});
+	}
+	struct Loop
+	{
+		std::string_view family;
+		std::string_view help;
+		LatencyHistogram Multi::Instruments::* histogram;
+	};
+	const Loop loops[] = {
+		{ "cma_strand_ready_delay_seconds", "Time from a socket being ready until the strand handled it",
+			&Multi::Instruments::readyDelay },
+		{ "cma_timer_lag_seconds", "Time from a timer expiring until the strand handled it",
+			&Multi::Instruments::timerLag },
+		{ "cma_socket_action_seconds", "Time each curl_multi_socket_action call took",
+			&Multi::Instruments::socketAction },
+		{ "cma_handler_seconds", "Time each completion handler ran",
+			&Multi::Instruments::handlers }
+	};
+	for (const auto& loop : loops)
+	{
+		out.AppendFamily(loop.family, "histogram", loop.help);
+		for (const auto& source : m_sources)
+			WriteHistogram(out, loop.family, source, {}, {},
+				(*source.multi->m_instruments).*loop.histogram);
+	}
+	out.Append("# EOF\n");
+	return out.GetLength();
+}
+
+void MetricsExporter::WriteHistogram(Output& out, std::string_view family,
+	const Source& source, std::string_view origin, std::string_view phase,
+	const LatencyHistogram& histogram)
+{
+	histogram.GetSnapshot(m_scratch);
+	// each latency bucket goes in the first bound its lowest latency is
+	// under. one that straddles a bound is counted below it, or a latency
+	// right at the bound, such as 100us in [100us, 101us], would be above
+	std::array<uint64_t, s_bounds.size()> counts{};
+	m_scratch.ForEachBucketRange([&counts](std::chrono::microseconds lower,
+		std::chrono::microseconds, uint64_t count)
+		{
+			const auto boundIt = std::lower_bound(s_bounds.begin(), s_bounds.end(),
+				static_cast<uint64_t>(lower.count()));
+			if (boundIt != s_bounds.end())
+				counts[boundIt - s_bounds.begin()] += count;
+		});
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < s_bounds.size(); ++i)
+	{
+		cumulative += counts[i];
+		out.AppendSeries(family, "_bucket", source.name, origin, phase, s_boundLabels[i]);
+		out.Append(cumulative);
+		out.Append("\n");
+	}
+	out.AppendSeries(family, "_bucket", source.name, origin, phase, "+Inf");
+	out.Append(m_scratch.GetCount());
+	out.Append("\n");
+	out.AppendSeries(family, "_count", source.name, origin, phase);
+	out.Append(m_scratch.GetCount());
+	out.Append("\n");
+	out.AppendSeries(family, "_sum", source.name, origin, phase);
+	out.AppendSeconds(m_scratch.GetSum());
+	out.Append("\n");
+}
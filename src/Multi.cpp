@@ -1,12 +1,22 @@
 #include <curl-multi-asio/Multi.h>
 
+#include <curl-multi-asio/Detail/Probes.h>
+#include <curl-multi-asio/RequestGroup.h>
+
+#include <algorithm>
 #include <chrono>
 #include <functional>
+#include <string_view>
 
 using cma::Multi;
 
 Multi::Multi(const asio::any_io_executor& executor) noexcept
-	: m_executor(executor), m_timer(executor), m_strand(executor),
+	: m_executor(executor), m_arenas(std::make_shared<Detail::ArenaPool>()),
+	m_submissions(std::make_unique<Detail::SubmissionQueue>()),
+	m_easyHandlerMap(TransferMap<HandlerPtr>::allocator_type(m_arenas)),
+	m_hedgeMap(TransferMap<PerformHandlerBase*>::allocator_type(m_arenas)), m_timer(executor),
+	m_timerWheelTimer(executor), m_instruments(std::make_shared<Instruments>()),
+	m_strand(executor),
 	m_nativeHandle(curl_multi_init(), curl_multi_cleanup)
 {
 	// set the timer function and data
@@ -17,12 +27,78 @@ Multi::Multi(const asio::any_io_executor& executor) noexcept
 	SetOption(CURLMoption::CURLMOPT_SOCKETDATA, this);
 }
 
+Multi::~Multi() noexcept
+{
+	// the transfers cancelled here complete once the handle is gone, and
+	// the sink only had to outlive the handle. one that was moved from has
+	// no instruments
+	if (m_instruments != nullptr)
+	{
+		m_instruments->traceSink.store(nullptr, std::memory_order_release);
+		m_instruments->closed.store(true, std::memory_order_release);
+	}
+	CancelAll();
+}
+
 size_t Multi::Cancel(cma::error_code& ec, CURLMcode error) noexcept
+{
+	ec.clear();
+	// a handle that was moved from has nothing to cancel, nor instruments
+	if (m_instruments == nullptr)
+		return 0;
+	const auto outstanding = m_instruments->queued.load(std::memory_order_relaxed) +
+		m_instruments->inFlight.load(std::memory_order_relaxed);
+	Dispatch([this] { CancelAll(); });
+	return outstanding;
+}
+
+bool Multi::Cancel(const Easy& easy, CURLMcode error) noexcept
+{
+	// only the first cancel of an outstanding transfer gets through, and
+	// a transfer that is still queued sees that it was cancelled as it starts
+	auto& state = easy.m_transferState;
+	auto expected = Easy::TransferState::Active;
+	if (state.value.compare_exchange_strong(expected,
+		Easy::TransferState::Cancelling, std::memory_order_acq_rel) == false)
+		return false;
+	// the transfer may complete and the easy handle be destroyed before
+	// the strand gets to it, so the strand goes by what identifies it
+	Dispatch([this, handle = state.handle.load(std::memory_order_relaxed),
+		generation = state.generation.load(std::memory_order_relaxed)]
+		{
+			CancelTransfer(handle, generation);
+		});
+	return true;
+}
+
+void Multi::CancelAll() noexcept
 {
 	// if there are no operations, there is no need for a timer.
-	m_timer.cancel(ec);
+	cma::error_code ignored;
+	m_timer.cancel(ignored);
+	// a handle that was moved from has no queue either
+	auto node = (m_submissions != nullptr) ? m_submissions->Drain() : nullptr;
+	while (node != nullptr)
+	{
+		auto& submission = static_cast<Submission&>(*node);
+		node = node->next;
+		auto handler = std::move(submission.handler);
+		submission.~Submission();
+		m_instruments->queued.fetch_sub(1, std::memory_order_relaxed);
+		asio::post(m_executor, [handler = std::move(handler)]
+			{
+				handler->Complete(asio::error::operation_aborted);
+			});
+	}
+	if (m_easyHandlerMap.empty() == false)
+	{
+		m_instruments->inFlight.fetch_sub(m_easyHandlerMap.size(), std::memory_order_relaxed);
+		m_instruments->timerArmed.store(false, std::memory_order_relaxed);
+	}
 	for (auto& handler : m_easyHandlerMap)
 	{
+		CMA_PROBE1(transfer__cancel, handler.first);
+		Untrack(*handler.second);
 		// post each completion in case the handler tries to cancel itself
 		asio::post(m_executor, [handler = std::move(handler.second)]
 			{
@@ -30,15 +106,67 @@ size_t Multi::Cancel(cma::error_code& ec, CURLMcode error) noexcept
 			});
 	}
 	m_easyHandlerMap.clear();
-	return m_easyHandlerMap.size();
 }
 
-bool Multi::Cancel(const Easy& easy, CURLMcode error) noexcept
+void Multi::CancelGroup(RequestGroup& group) noexcept
 {
-	// ensure that the easy handle is already being handled
-	auto handlerIt = m_easyHandlerMap.find(easy.GetNativeHandle());
-	if (handlerIt == m_easyHandlerMap.end())
-		return false;
+	CompletionBatch batch;
+	size_t cancelled = 0;
+	// only started transfers are in the list, and they are all tracked
+	while (group.m_members != nullptr)
+	{
+		auto handlerIt = m_easyHandlerMap.find(group.m_members->GetEasyHandle());
+		auto owned = std::move(handlerIt->second);
+		m_easyHandlerMap.erase(handlerIt);
+		CMA_PROBE1(transfer__cancel, owned->GetEasyHandle());
+		// this takes it out of the list
+		Untrack(*owned);
+		batch.Add(std::move(owned));
+		++cancelled;
+	}
+	if (cancelled == 0)
+		return;
+	m_instruments->inFlight.fetch_sub(cancelled, std::memory_order_relaxed);
+	// if there are no more operations, there is no need for a timer
+	if (m_easyHandlerMap.empty() == true)
+	{
+		cma::error_code ignored;
+		m_timer.cancel(ignored);
+		m_instruments->timerArmed.store(false, std::memory_order_relaxed);
+	}
+	// posted in case a handler tries to cancel itself
+	asio::post(m_executor, std::move(batch));
+}
+
+void Multi::FinishGroupMember(PerformHandlerBase& handler, const error_code& ec) noexcept
+{
+	const auto& group = handler.GetGroup().group;
+	if (group == nullptr)
+		return;
+	if (ec)
+		group->m_failed.fetch_add(1, std::memory_order_relaxed);
+	if (group->m_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		asio::dispatch(group->m_strand, [group] { group->Settle(); });
+}
+
+void Multi::CancelTransfer(CURL* easy, uint64_t generation) noexcept
+{
+	const auto isTransfer = [generation](const auto& entry)
+	{
+		return entry.second->GetGeneration() == generation;
+	};
+	auto handlerIt = m_easyHandlerMap.find(easy);
+	// a hedge that won keys the transfer by its own native handle, which
+	// only lasts while the transfer waits to be retried
+	if ((handlerIt == m_easyHandlerMap.end() || isTransfer(*handlerIt) == false) &&
+		m_swappedTransfers > 0)
+		handlerIt = std::find_if(m_easyHandlerMap.begin(), m_easyHandlerMap.end(), isTransfer);
+	// it may have completed, and the easy handle even been performed again
+	// since. a transfer that is still queued is cancelled when it is started
+	if (handlerIt == m_easyHandlerMap.end() || isTransfer(*handlerIt) == false)
+		return;
+	CMA_PROBE1(transfer__cancel, handlerIt->first);
+	Untrack(*handlerIt->second);
 	// post each completion in case the handler tries to cancel itself
 	asio::post(m_executor, [handler = std::move(handlerIt->second)]
 		{
@@ -46,23 +174,734 @@ bool Multi::Cancel(const Easy& easy, CURLMcode error) noexcept
 		});
 	// delete the handler
 	m_easyHandlerMap.erase(handlerIt);
+	m_instruments->inFlight.fetch_sub(1, std::memory_order_relaxed);
 	// if there are no more operations, there is no need for a timer
 	if (m_easyHandlerMap.empty() == true)
 	{
 		cma::error_code ignored;
 		m_timer.cancel(ignored);
+		m_instruments->timerArmed.store(false, std::memory_order_relaxed);
+	}
+}
+
+void Multi::SetBandwidthLimit(const BandwidthLimit& limit) noexcept
+{
+	Post([this, limit]
+		{
+			m_shaper.SetLimit(limit);
+			if (m_shaper.Enabled() == true && m_shaper.Empty() == false)
+				StartShaper();
+		});
+}
+
+void Multi::StartTransfer(Easy& easy, HandlerPtr handler,
+	const PerformOptions& options) noexcept
+{
+	Trace(TraceEventType::Admit, &easy);
+	m_instruments->queued.fetch_sub(1, std::memory_order_relaxed);
+	CMA_PROBE1(transfer__submit, easy.GetNativeHandle());
+	// a transfer that was cancelled while it was queued never starts
+	if (easy.m_transferState.value.load(std::memory_order_acquire) ==
+		Easy::TransferState::Cancelling)
+	{
+		CMA_PROBE1(transfer__cancel, easy.GetNativeHandle());
+		return handler->Complete(asio::error::operation_aborted);
+	}
+	// and so does one whose group was
+	auto& group = handler->GetGroup();
+	if (group.group != nullptr && group.group->Cancelled() == true)
+	{
+		CMA_PROBE1(transfer__cancel, easy.GetNativeHandle());
+		return handler->Complete(asio::error::operation_aborted);
+	}
+	// a transfer that waited out its deadline in the queue never starts
+	auto& deadline = handler->GetDeadline();
+	deadline.deadline = options.deadline;
+	deadline.attemptTimeout = options.attemptTimeout;
+	if (deadline.deadline.has_value() == true &&
+		std::chrono::steady_clock::now() >= *deadline.deadline)
+		return handler->Complete(Error::DeadlineExceeded);
+	// the origin is worked out once, for the breaker and the timings
+	char* url = nullptr;
+	curl_easy_getinfo(easy.GetNativeHandle(), CURLINFO_EFFECTIVE_URL, &url);
+	CircuitBreaker::GetOrigin(url, handler->GetOrigin());
+	// a transfer to an ejected origin fails before anything else is set up,
+	// having only read the url to find its origin
+	if (options.breaker != nullptr)
+	{
+		handler->GetBreaker().breaker = options.breaker;
+		if (AdmitAttempt(*handler) == false)
+			return handler->Complete(Error::CircuitOpen);
+	}
+	if (options.endpoints != nullptr && options.endpoints->GetSize() > 0)
+	{
+		handler->GetRoute().endpoints = options.endpoints;
+		RouteAttempt(*handler);
+	}
+	// set the open and close socket functions. this allows
+	// us to make them asio sockets for async functionality
+	easy.SetOption(CURLoption::CURLOPT_OPENSOCKETFUNCTION, &Multi::OpenSocketCb);
+	easy.SetOption(CURLoption::CURLOPT_OPENSOCKETDATA, this);
+	easy.SetOption(CURLoption::CURLOPT_CLOSESOCKETFUNCTION, &Multi::CloseSocketCb);
+	easy.SetOption(CURLoption::CURLOPT_CLOSESOCKETDATA, this);
+	if (auto recorder = GetFlightRecorder(); recorder != nullptr)
+	{
+		// set directly, so the easy handle keeps the user's own to put back
+		handler->SetRecorder(recorder);
+		curl_easy_setopt(easy.GetNativeHandle(), CURLOPT_DEBUGFUNCTION, &Multi::DebugCallback);
+		curl_easy_setopt(easy.GetNativeHandle(), CURLOPT_DEBUGDATA, handler.get());
+		curl_easy_setopt(easy.GetNativeHandle(), CURLOPT_VERBOSE, 1L);
+	}
+	if (m_shaper.Enabled() == true)
+	{
+		m_shaper.Add(handler->GetShaping(), easy.GetNativeHandle(), options.weight);
+		StartShaper();
 	}
+	auto& retry = handler->GetRetry();
+	retry.attempts = 1;
+	if (options.retry != nullptr)
+	{
+		retry.policy = options.retry;
+		retry.timer.callback = &Multi::RetryTimerCb;
+		retry.timer.context = handler.get();
+	}
+	// so a failed attempt's body, or the original's once its hedge wins,
+	// can be dropped without touching what was in the buffer before
+	if (options.retry != nullptr || options.hedge != nullptr)
+		easy.MarkBuffer();
+	// a hedge needs a buffer it can write to in place of the original
+	if (options.hedge != nullptr && easy.m_buffer != nullptr)
+	{
+		auto& hedge = handler->GetHedge();
+		hedge.policy = options.hedge;
+		hedge.policy->OnRequest();
+		hedge.start = std::chrono::steady_clock::now();
+		hedge.timer.callback = &Multi::HedgeTimerCb;
+		hedge.timer.context = handler.get();
+		ScheduleTimer(hedge.timer, hedge.policy->GetDelay());
+		// both halves keep their headers to themselves, and the header
+		// callback only gets those of the one that completes
+		if (easy.m_headerFunction != nullptr)
+		{
+			hedge.primaryHeaders.clear();
+			curl_easy_setopt(easy.GetNativeHandle(), CURLOPT_HEADERFUNCTION, &Multi::HedgeHeaderCb);
+			curl_easy_setopt(easy.GetNativeHandle(), CURLOPT_HEADERDATA, &hedge.primaryHeaders);
+			hedge.holdsHeaders = true;
+		}
+		// each half notes down the sockets it opens, for when it is stopped
+		hedge.primarySockets.multi = this;
+		hedge.primarySockets.opened.clear();
+		curl_easy_setopt(easy.GetNativeHandle(), CURLOPT_OPENSOCKETFUNCTION, &Multi::HedgeOpenSocketCb);
+		curl_easy_setopt(easy.GetNativeHandle(), CURLOPT_OPENSOCKETDATA, &hedge.primarySockets);
+	}
+	BudgetAttempt(*handler);
+	if (deadline.deadline.has_value() == true)
+	{
+		deadline.timer.callback = &Multi::DeadlineTimerCb;
+		deadline.timer.context = handler.get();
+		ScheduleTimer(deadline.timer, *deadline.deadline - std::chrono::steady_clock::now());
+	}
+	// track the socket and initiate the transfer. if this fails
+	if (auto res = curl_multi_add_handle(GetNativeHandle(),
+		easy.GetNativeHandle()); res != CURLM_OK)
+	{
+		Untrack(*handler);
+		return handler->Complete(res);
+	}
+	Trace(TraceEventType::Start, &easy);
+	// a group cancels what it has started through its list
+	if (group.group != nullptr)
+	{
+		auto& members = group.group->m_members;
+		group.next = members;
+		if (members != nullptr)
+			members->GetGroup().prev = handler.get();
+		members = handler.get();
+		group.linked = true;
+	}
+	// track the handler
+	m_easyHandlerMap.emplace(easy.GetNativeHandle(), std::move(handler));
+	m_instruments->inFlight.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Multi::StartFanOut(Detail::FanOutBase& fanOut, std::span<Easy> easies,
+	PerformOptions options)
+{
+	if (fanOut.CutsShort() == true)
+	{
+		options.group = std::make_shared<RequestGroup>(*this);
+		fanOut.SetGroup(options.group);
+	}
+	for (size_t i = 0; i < easies.size(); ++i)
+		AsyncPerform(easies[i], options, Detail::FanOutChild{ &fanOut, i });
+	asio::post(m_executor, [&fanOut] { fanOut.Release(); });
+}
+
+void Multi::Submit(HandlerPtr handler, const PerformOptions& options)
+{
+	// the group counts its transfers from when they are submitted, so
+	// that it isn't done while some of them are still queued
+	if (options.group != nullptr)
+	{
+		handler->GetGroup().group = options.group;
+		options.group->m_outstanding.fetch_add(1, std::memory_order_relaxed);
+	}
+	// the handler is aborted along with the function if the handle
+	// goes away before the strand gets to it
+	if (m_instruments->batchSubmissions.load(std::memory_order_relaxed) == false)
+		return Post([this, handler = std::move(handler), options]() mutable
+			{
+				auto& easy = handler->GetEasy();
+				StartTransfer(easy, std::move(handler), options);
+			});
+	// the submission goes in the same arena as its handler, which nothing
+	// else touches until the strand takes it out of the queue
+	auto memory = handler->GetArena().GetResource()->allocate(
+		sizeof(Submission), alignof(Submission));
+	auto submission = new (memory) Submission{ {}, std::move(handler), options };
+	if (m_submissions->Push(submission) == true)
+		Post([this] { DrainSubmissions(); });
+}
+
+void Multi::DrainSubmissions() noexcept
+{
+	auto node = m_submissions->Drain();
+	while (node != nullptr)
+	{
+		auto& submission = static_cast<Submission&>(*node);
+		node = node->next;
+		// the handler may be gone by the time StartTransfer returns, and
+		// the submission along with its arena, so it's emptied out first
+		auto handler = std::move(submission.handler);
+		const auto options = std::move(submission.options);
+		submission.~Submission();
+		auto& easy = handler->GetEasy();
+		StartTransfer(easy, std::move(handler), options);
+	}
+}
+
+void Multi::Untrack(PerformHandlerBase& handler) noexcept
+{
+	// the handler may complete after the handle is gone, so the easy handle
+	// is taken out of it now
+	curl_multi_remove_handle(GetNativeHandle(), handler.GetEasyHandle());
+	m_shaper.Remove(handler.GetShaping());
+	m_timerWheel.Cancel(handler.GetRetry().timer);
+	m_timerWheel.Cancel(handler.GetHedge().timer);
+	m_timerWheel.Cancel(handler.GetDeadline().timer);
+	DropHedge(handler);
+	if (handler.GetHedge().won == true)
+		--m_swappedTransfers;
+	if (handler.GetHedge().holdsHeaders == true)
+		ReleaseHeaders(handler);
+	if (auto& hedge = handler.GetHedge(); hedge.primarySockets.multi != nullptr)
+	{
+		curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_OPENSOCKETFUNCTION, &Multi::OpenSocketCb);
+		curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_OPENSOCKETDATA, this);
+		hedge.primarySockets.multi = nullptr;
+		hedge.primarySockets.opened.clear();
+	}
+	// an attempt that never finished has no outcome to report
+	if (auto& breaker = handler.GetBreaker(); breaker.pending == true)
+	{
+		breaker.breaker->Release(handler.GetOrigin());
+		breaker.pending = false;
+	}
+	FinishRoute(handler, std::nullopt);
+	// the easy handle may be reused, and the list is about to go away
+	if (auto& route = handler.GetRoute(); route.connectTo != nullptr)
+	{
+		curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_CONNECT_TO, nullptr);
+		route.connectTo.reset();
+	}
+	// the easy handle gets its own timeout back
+	if (auto& deadline = handler.GetDeadline(); deadline.deadline.has_value() == true ||
+		deadline.attemptTimeout.has_value() == true)
+		curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_TIMEOUT_MS,
+			static_cast<long>(handler.GetEasy().m_timeout.count()));
+	// cURL can't tell what the user had set before, so these are cleared
+	if (handler.GetRecorder() != nullptr)
+	{
+		const auto& easy = handler.GetEasy();
+		curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_VERBOSE, easy.m_verbose == true ? 1L : 0L);
+		curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_DEBUGFUNCTION, easy.m_debugFunction);
+		curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_DEBUGDATA, easy.m_debugData);
+		handler.SetRecorder(nullptr);
+	}
+	if (auto& group = handler.GetGroup(); group.linked == true)
+	{
+		if (group.prev != nullptr)
+			group.prev->GetGroup().next = group.next;
+		else
+			group.group->m_members = group.next;
+		if (group.next != nullptr)
+			group.next->GetGroup().prev = group.prev;
+		group.prev = group.next = nullptr;
+		group.linked = false;
+	}
+}
+
+void Multi::ScheduleTimer(Detail::TimerNode& node,
+	std::chrono::steady_clock::duration delay) noexcept
+{
+	m_timerWheel.Schedule(node, delay);
+	ArmTimerWheel();
+}
+
+void Multi::ArmTimerWheel() noexcept
+{
+	const auto next = m_timerWheel.NextExpiry();
+	// an early wake up is harmless, so only ever move the timer closer
+	if (next.has_value() == false || (m_timerWheelArmedFor.has_value() == true &&
+		*m_timerWheelArmedFor <= *next))
+		return;
+	m_timerWheelArmedFor = next;
+	m_instruments->timerRearms.fetch_add(1, std::memory_order_relaxed);
+	m_timerWheelTimer.expires_at(*next);
+	m_timerWheelTimer.async_wait(asio::bind_executor(m_strand,
+		[this, expiry = *next](const cma::error_code& ec)
+		{
+			// aborted waits were either replaced by a closer one, or the
+			// multi handle is going away
+			if (ec)
+				return;
+			const auto lag = std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - expiry);
+			m_instruments->timerLag.Record(lag);
+			CMA_PROBE2(timer__fire, 1, static_cast<int64_t>(lag.count()));
+			// a wait that finished before it could be replaced still runs,
+			// and the closer one it was replaced by is left armed
+			if (m_timerWheelArmedFor == expiry)
+				m_timerWheelArmedFor.reset();
+			m_timerWheel.Advance();
+			ArmTimerWheel();
+		}));
+}
+
+bool Multi::AdmitAttempt(PerformHandlerBase& handler) noexcept
+{
+	auto& breaker = handler.GetBreaker();
+	// a URL without an origin can't be tracked
+	if (breaker.breaker == nullptr || handler.GetOrigin().empty() == true)
+		return true;
+	if (breaker.breaker->Allow(handler.GetOrigin()) == false)
+		return false;
+	breaker.pending = true;
+	breaker.start = std::chrono::steady_clock::now();
 	return true;
 }
 
+void Multi::RecordAttempt(PerformHandlerBase& handler, CURLcode result) noexcept
+{
+	auto& breaker = handler.GetBreaker();
+	if (breaker.pending == false)
+		return;
+	long status = 0;
+	curl_easy_getinfo(handler.GetEasyHandle(), CURLINFO_RESPONSE_CODE, &status);
+	breaker.breaker->Record(handler.GetOrigin(), breaker.breaker->IsFailure(result, status,
+		std::chrono::steady_clock::now() - breaker.start));
+	breaker.pending = false;
+}
+
+void Multi::RouteAttempt(PerformHandlerBase& handler) noexcept
+{
+	auto& route = handler.GetRoute();
+	if (route.endpoints == nullptr)
+		return;
+	route.index = route.endpoints->Pick();
+	route.start = std::chrono::steady_clock::now();
+	route.active = true;
+	// the new list goes in before the old one is freed, so that the easy
+	// handle never points at a freed list
+	decltype(route.connectTo) connectTo(curl_slist_append(nullptr,
+		route.endpoints->GetConnectTo(route.index).c_str()), curl_slist_free_all);
+	curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_CONNECT_TO, connectTo.get());
+	route.connectTo = std::move(connectTo);
+}
+
+void Multi::FinishRoute(PerformHandlerBase& handler,
+	std::optional<CURLcode> result) noexcept
+{
+	auto& route = handler.GetRoute();
+	if (route.active == false)
+		return;
+	route.active = false;
+	if (result.has_value() == false)
+		return route.endpoints->Finish(route.index, std::nullopt, false);
+	long status = 0;
+	curl_easy_getinfo(handler.GetEasyHandle(), CURLINFO_RESPONSE_CODE, &status);
+	route.endpoints->Finish(route.index, std::chrono::steady_clock::now() - route.start,
+		*result != CURLE_OK || status >= 500);
+}
+
+bool Multi::BudgetAttempt(PerformHandlerBase& handler) noexcept
+{
+	auto& deadline = handler.GetDeadline();
+	auto timeout = deadline.attemptTimeout;
+	if (deadline.deadline.has_value() == true)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= *deadline.deadline)
+			return false;
+		const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+			*deadline.deadline - now);
+		timeout = (timeout.has_value() == true) ? std::min(*timeout, remaining) : remaining;
+	}
+	// the easy handle's own timeout still holds
+	if (const auto own = handler.GetEasy().m_timeout; timeout.has_value() == true &&
+		own.count() > 0)
+		timeout = std::min(*timeout, own);
+	// 0 would mean no timeout at all
+	if (timeout.has_value() == true)
+		curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_TIMEOUT_MS,
+			static_cast<long>(std::max<std::chrono::milliseconds::rep>(timeout->count(), 1)));
+	return true;
+}
+
+bool Multi::RetryTransfer(PerformHandlerBase& handler, CURLcode result) noexcept
+{
+	auto& retry = handler.GetRetry();
+	if (retry.policy == nullptr)
+		return false;
+	const cma::error_code ec = result;
+	long status = 0;
+	curl_easy_getinfo(handler.GetEasyHandle(), CURLINFO_RESPONSE_CODE, &status);
+	std::optional<std::chrono::seconds> retryAfter;
+#if LIBCURL_VERSION_NUM >= 0x074200
+	// cURL parses both the delay-seconds and HTTP-date forms
+	curl_off_t after = 0;
+	if (curl_easy_getinfo(handler.GetEasyHandle(), CURLINFO_RETRY_AFTER,
+		&after) == CURLE_OK && after > 0)
+		retryAfter = std::chrono::seconds(after);
+#endif
+	std::optional<std::chrono::milliseconds> remaining;
+	if (auto& deadline = handler.GetDeadline(); deadline.deadline.has_value() == true)
+		remaining = std::chrono::floor<std::chrono::milliseconds>(
+			*deadline.deadline - std::chrono::steady_clock::now());
+	const auto delay = retry.policy->NextDelay(ec, status, retry.attempts,
+		retryAfter, remaining);
+	if (delay.has_value() == false)
+	{
+		if (retry.policy->budget != nullptr && !ec && status < 500 && status != 429)
+			retry.policy->budget->OnSuccess();
+		return false;
+	}
+	// take it out of the multi handle, but keep the handler tracked
+	// so that the transfer can still be cancelled while it waits
+	curl_multi_remove_handle(GetNativeHandle(), handler.GetEasyHandle());
+	handler.GetEasy().RewindBuffer();
+	handler.GetHedge().primaryHeaders.clear();
+	handler.GetHedge().primarySockets.opened.clear();
+	ScheduleTimer(retry.timer, *delay);
+	return true;
+}
+
+cma::Multi::PerformHandlerBase* Multi::FindHandler(CURL* easy) const noexcept
+{
+	if (auto handlerIt = m_easyHandlerMap.find(easy); handlerIt != m_easyHandlerMap.end())
+		return handlerIt->second.get();
+	if (auto hedgeIt = m_hedgeMap.find(easy); hedgeIt != m_hedgeMap.end())
+		return hedgeIt->second;
+	return nullptr;
+}
+
+bool Multi::ResolveHedge(PerformHandlerBase& handler, CURL* easy,
+	CURLcode& result) noexcept
+{
+	auto& hedge = handler.GetHedge();
+	if (hedge.duplicate == nullptr)
+		return false;
+	const bool fromHedge = easy == hedge.duplicate->GetNativeHandle();
+	long status = 0;
+	curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+	if (result != CURLE_OK || status >= 500)
+	{
+		// the other one may still succeed
+		if (fromHedge == false)
+		{
+			curl_multi_remove_handle(GetNativeHandle(), easy);
+			hedge.primaryResult = result;
+			return true;
+		}
+		const auto primaryResult = hedge.primaryResult;
+		DropHedge(handler, true);
+		if (primaryResult.has_value() == false)
+			return true;
+		// both failed, complete with the original's result
+		result = *primaryResult;
+		return false;
+	}
+	if (fromHedge == false)
+	{
+		DropHedge(handler);
+		return false;
+	}
+	// the hedge won. stop the original, and stop shaping it while
+	// its native handle is still alive
+	auto& primary = handler.GetEasy();
+	auto& duplicate = *hedge.duplicate;
+	m_shaper.Remove(handler.GetShaping());
+	curl_multi_remove_handle(GetNativeHandle(), primary.GetNativeHandle());
+	curl_multi_remove_handle(GetNativeHandle(), duplicate.GetNativeHandle());
+	m_hedgeMap.erase(duplicate.GetNativeHandle());
+	// unless it already failed, the original was stopped before it finished
+	if (hedge.primaryResult.has_value() == false)
+	{
+		Trace(TraceEventType::Done, &primary, CURL_SOCKET_BAD, CURLE_ABORTED_BY_CALLBACK);
+		ForgetClosedSockets(hedge.primarySockets);
+	}
+	// hand the winner's body and native handle to the caller's easy handle,
+	// pointing it back at the caller's buffer
+	primary.RewindBuffer();
+	primary.m_bufferOps->append(primary.m_buffer, hedge.body.data(), hedge.body.size());
+	std::swap(primary.m_nativeHandle, duplicate.m_nativeHandle);
+	std::swap(primary.m_headerList, duplicate.m_headerList);
+	primary.m_bufferOps->install(primary, primary.m_buffer);
+	if (hedge.holdsHeaders == true)
+	{
+		hedge.primaryHeaders = std::move(hedge.headers);
+		curl_easy_setopt(primary.GetNativeHandle(), CURLOPT_HEADERDATA, &hedge.primaryHeaders);
+	}
+	hedge.primarySockets.opened = std::move(hedge.sockets.opened);
+	curl_easy_setopt(primary.GetNativeHandle(), CURLOPT_OPENSOCKETDATA, &hedge.primarySockets);
+	// the handler is keyed by the native handle. it is moved rather than
+	// extracted, as some node handles never destroy the pool allocator
+	// they are left with once reinserted
+	auto handlerIt = m_easyHandlerMap.find(handler.GetEasyHandle());
+	auto owned = std::move(handlerIt->second);
+	m_easyHandlerMap.erase(handlerIt);
+	m_easyHandlerMap.emplace(primary.GetNativeHandle(), std::move(owned));
+	handler.SetEasyHandle(primary.GetNativeHandle());
+	hedge.won = true;
+	++m_swappedTransfers;
+	hedge.duplicate.reset();
+	hedge.body.clear();
+	hedge.headers.clear();
+	hedge.policy->OnHedgeWon();
+	return false;
+}
+
+void Multi::DropHedge(PerformHandlerBase& handler, bool finished) noexcept
+{
+	auto& hedge = handler.GetHedge();
+	if (hedge.duplicate == nullptr)
+		return;
+	curl_multi_remove_handle(GetNativeHandle(), hedge.duplicate->GetNativeHandle());
+	m_hedgeMap.erase(hedge.duplicate->GetNativeHandle());
+	if (finished == false)
+	{
+		Trace(TraceEventType::Done, hedge.duplicate.get(), CURL_SOCKET_BAD,
+			CURLE_ABORTED_BY_CALLBACK);
+		ForgetClosedSockets(hedge.sockets);
+	}
+	hedge.duplicate.reset();
+	hedge.body.clear();
+	hedge.headers.clear();
+	hedge.sockets.opened.clear();
+	hedge.primaryResult.reset();
+}
+
+size_t Multi::HedgeHeaderCb(char* buffer, size_t size, size_t nitems,
+	std::pmr::string* headers) noexcept
+{
+	headers->append(buffer, size * nitems);
+	return size * nitems;
+}
+
+void Multi::ReleaseHeaders(PerformHandlerBase& handler) noexcept
+{
+	auto& hedge = handler.GetHedge();
+	auto& easy = handler.GetEasy();
+	curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_HEADERFUNCTION, easy.m_headerFunction);
+	curl_easy_setopt(handler.GetEasyHandle(), CURLOPT_HEADERDATA, easy.m_headerData);
+	// one line at a time, as cURL would have passed them
+	for (size_t start = 0; start < hedge.primaryHeaders.size();)
+	{
+		auto end = hedge.primaryHeaders.find('\n', start);
+		end = end == std::string::npos ? hedge.primaryHeaders.size() : end + 1;
+		easy.m_headerFunction(hedge.primaryHeaders.data() + start, 1, end - start,
+			easy.m_headerData);
+		start = end;
+	}
+	hedge.primaryHeaders.clear();
+	hedge.holdsHeaders = false;
+}
+
+Multi::SocketMap::iterator Multi::ForgetSocket(SocketMap::iterator socketIt) noexcept
+{
+	// its waits are aborted, and the descriptor is left alone
+	cma::error_code ignored;
+	socketIt->second.release(ignored);
+	m_socketActions.erase(socketIt->first);
+	m_instruments->openSockets.fetch_sub(1, std::memory_order_relaxed);
+	return m_easySocketMap.erase(socketIt);
+}
+
+void Multi::ForgetClosedSockets(PerformHandlerBase::HedgeState::Sockets& sockets) noexcept
+{
+	// a descriptor that was closed and opened again since is tracked
+	// afresh by OpenSocketCb, and is open
+	for (const auto sock : sockets.opened)
+	{
+		auto socketIt = m_easySocketMap.find(sock);
+		if (socketIt == m_easySocketMap.end())
+			continue;
+		// any option will do, it only has to reach the descriptor
+		asio::socket_base::keep_alive option;
+		cma::error_code ec;
+		socketIt->second.get_option(option, ec);
+		if (ec == asio::error::bad_descriptor || ec == asio::error::not_socket)
+			ForgetSocket(socketIt);
+	}
+	sockets.opened.clear();
+}
+
+void Multi::HedgeTimerCb(void* context) noexcept
+{
+	auto& handler = *static_cast<PerformHandlerBase*>(context);
+	auto& multi = handler.GetMulti();
+	auto& hedge = handler.GetHedge();
+	// the duplicate sends the request again, reading from the same read
+	// callback, so only requests that are safe to repeat and have no body
+	// are hedged. cURL knows the method once the original has started
+#if LIBCURL_VERSION_NUM >= 0x074800
+	char* method = nullptr;
+	curl_easy_getinfo(handler.GetEasyHandle(), CURLINFO_EFFECTIVE_METHOD, &method);
+	if (method == nullptr || (std::string_view(method) != "GET" &&
+		std::string_view(method) != "HEAD"))
+		return;
+#else
+	return;
+#endif
+	// a transfer waiting to be retried isn't running
+	if (handler.GetRetry().timer.Scheduled() == true ||
+		hedge.policy->TryHedge() == false)
+		return;
+	// the hedge is only spent once the duplicate is running
+	auto duplicate = std::make_unique<Easy>(handler.GetEasy());
+	if (*duplicate == false)
+		return hedge.policy->RefundHedge();
+	hedge.body.clear();
+	duplicate->SetBuffer(hedge.body);
+	hedge.sockets.multi = &multi;
+	hedge.sockets.opened.clear();
+	curl_easy_setopt(duplicate->GetNativeHandle(), CURLOPT_OPENSOCKETDATA, &hedge.sockets);
+	if (hedge.holdsHeaders == true)
+	{
+		hedge.headers.clear();
+		curl_easy_setopt(duplicate->GetNativeHandle(), CURLOPT_HEADERDATA, &hedge.headers);
+	}
+	// the duplicate isn't shaped, and must not report to the original
+	if (handler.GetShaping().active == true)
+	{
+		duplicate->SetOption(CURLoption::CURLOPT_NOPROGRESS, 1L);
+		duplicate->SetOption(CURLoption::CURLOPT_XFERINFOFUNCTION, nullptr);
+	}
+	if (curl_multi_add_handle(multi.GetNativeHandle(),
+		duplicate->GetNativeHandle()) != CURLM_OK)
+		return hedge.policy->RefundHedge();
+	// the hedge is traced as a transfer of its own
+	multi.Trace(TraceEventType::Start, duplicate.get());
+	multi.m_hedgeMap.emplace(duplicate->GetNativeHandle(), &handler);
+	hedge.duplicate = std::move(duplicate);
+}
+
+void Multi::RetryTimerCb(void* context) noexcept
+{
+	auto& handler = *static_cast<PerformHandlerBase*>(context);
+	auto& multi = handler.GetMulti();
+	++handler.GetRetry().attempts;
+	// the pause state of the last attempt doesn't carry over, so start
+	// the shaping over as well
+	if (auto& shaping = handler.GetShaping(); shaping.active == true)
+	{
+		const auto weight = shaping.weight;
+		multi.m_shaper.Remove(shaping);
+		multi.m_shaper.Add(shaping, handler.GetEasyHandle(), weight);
+	}
+	cma::error_code ec;
+	if (multi.BudgetAttempt(handler) == false)
+		ec = Error::DeadlineExceeded;
+	else if (multi.AdmitAttempt(handler) == false)
+		ec = Error::CircuitOpen;
+	else
+	{
+		// each attempt may go to a different replica
+		multi.RouteAttempt(handler);
+		if (auto res = curl_multi_add_handle(multi.GetNativeHandle(),
+			handler.GetEasyHandle()); res != CURLM_OK)
+			ec = res;
+		else
+			multi.Trace(TraceEventType::Start, &handler.GetEasy());
+	}
+	if (ec)
+		multi.FailTransfer(handler, ec);
+}
+
+void Multi::DeadlineTimerCb(void* context) noexcept
+{
+	auto& handler = *static_cast<PerformHandlerBase*>(context);
+	handler.GetMulti().FailTransfer(handler, Error::DeadlineExceeded);
+}
+
+void Multi::FailTransfer(PerformHandlerBase& handler, const error_code& ec) noexcept
+{
+	auto handlerIt = m_easyHandlerMap.find(handler.GetEasyHandle());
+	if (handlerIt == m_easyHandlerMap.end())
+		return;
+	auto owned = std::move(handlerIt->second);
+	m_easyHandlerMap.erase(handlerIt);
+	m_instruments->inFlight.fetch_sub(1, std::memory_order_relaxed);
+	// whatever the transfer was doing, it is taken out of the
+	// multi handle as it is untracked
+	if (auto recorder = owned->GetRecorder(); recorder != nullptr)
+		recorder->DumpFailure(owned->GetEasyHandle(), ec);
+	Untrack(*owned);
+	owned->Complete(ec);
+}
+
+void Multi::StartShaper() noexcept
+{
+	if (m_shaperNode.Scheduled() == true)
+		return;
+	m_shaperNode.callback = &Multi::ShaperTimerCb;
+	m_shaperNode.context = this;
+	ScheduleTimer(m_shaperNode, m_shaper.GetLimit().interval);
+}
+
+void Multi::ShaperTimerCb(void* context) noexcept
+{
+	auto& multi = *static_cast<Multi*>(context);
+	multi.m_shaper.Tick();
+	// the shaper paces every transfer from one timer, and it only
+	// runs while there is something to pace
+	if (multi.m_shaper.Enabled() == true && multi.m_shaper.Empty() == false)
+		multi.StartShaper();
+}
+
 int Multi::CloseSocketCb(Multi* userp, curl_socket_t item) noexcept
 {
+	userp->Trace(TraceEventType::SocketClose, nullptr, item);
+	CMA_PROBE1(socket__close, item);
 	auto socketIt = userp->m_easySocketMap.find(item);
 	cma::error_code ec;
-	// move the socket out so it doesn't get stuck if the close fails.
-	// delete the old iterator
-	auto socket = std::move(socketIt->second);
-	userp->m_easySocketMap.erase(socketIt);
+	asio::ip::tcp::socket socket(userp->m_executor);
+	if (socketIt != userp->m_easySocketMap.end())
+	{
+		// move the socket out so it doesn't get stuck if the close fails.
+		// delete the old iterator
+		socket = std::move(socketIt->second);
+		userp->m_easySocketMap.erase(socketIt);
+		userp->m_socketActions.erase(item);
+		userp->m_instruments->openSockets.fetch_sub(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		// one that was forgotten is still ours to close
+		socket.assign(asio::ip::tcp::v4(), item, ec);
+		if (ec)
+			return 1;
+	}
 	socket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
 	// close the socket
 	return (socket.close(ec)) ? 1 : 0;
@@ -78,44 +917,53 @@ curl_socket_t Multi::OpenSocketCb(Multi* userp, curlsocktype purpose,
 	auto sock = socket(address->family, address->socktype, address->protocol);
 	if (sock == -1)
 		return CURL_SOCKET_BAD;
+	// cURL doesn't always say when it closes a socket, so the descriptor may
+	// still be tracked from before. the old socket must not close it
+	if (auto socketIt = userp->m_easySocketMap.find(sock);
+		socketIt != userp->m_easySocketMap.end())
+		userp->ForgetSocket(socketIt);
 	// create and save the socket
 	userp->m_easySocketMap.emplace(sock, asio::ip::tcp::socket(
 		userp->m_executor, asio::ip::tcp::v4(), sock));
+	userp->m_instruments->openSockets.fetch_add(1, std::memory_order_relaxed);
+	userp->Trace(TraceEventType::SocketOpen, nullptr, sock);
+	CMA_PROBE1(socket__open, sock);
+	return sock;
+}
+
+curl_socket_t Multi::HedgeOpenSocketCb(PerformHandlerBase::HedgeState::Sockets* clientp,
+	curlsocktype purpose, curl_sockaddr* address) noexcept
+{
+	const auto sock = OpenSocketCb(clientp->multi, purpose, address);
+	if (sock != CURL_SOCKET_BAD)
+		clientp->opened.push_back(sock);
 	return sock;
 }
 
 int Multi::SocketCallback(CURL* easy, curl_socket_t s, int what,
-	Multi* userp, int* socketp) noexcept
+	Multi* userp, int*) noexcept
 {
-	// delete our last action
+	// forget our last action. it is kept by socket rather than through
+	// socketp, since waits that are still pending look it up later
 	if (what == CURL_POLL_REMOVE)
 	{
-		delete socketp;
+		userp->m_socketActions.erase(s);
 		return 0;
 	}
-	if (socketp == nullptr)
-	{
-		// allocate our last action
-		socketp = new int(0);
-		curl_multi_assign(userp->GetNativeHandle(), s, socketp);
-	}
 	// find the socket
 	auto socketIt = userp->m_easySocketMap.find(s);
 	if (socketIt == userp->m_easySocketMap.end())
 		return 0;
-	int last = *socketp;
-	*socketp = what;
+	auto& action = userp->m_socketActions[s];
+	const int last = action;
+	action = what;
 	// do what cURL wants, only if it changed
 	if ((what == CURL_POLL_IN || what == CURL_POLL_INOUT) &&
 		(last != CURL_POLL_IN && last != CURL_POLL_INOUT))
-		socketIt->second.async_read_some(asio::null_buffers(),
-			asio::bind_executor(userp->m_strand, std::bind(&Multi::EventCallback,
-				userp, std::placeholders::_1, s, CURL_POLL_IN, socketp)));
+		userp->WaitSocket(socketIt->second, s, CURL_POLL_IN);
 	if ((what == CURL_POLL_OUT || what == CURL_POLL_INOUT) &&
 		(last != CURL_POLL_OUT && last != CURL_POLL_INOUT))
-		socketIt->second.async_write_some(asio::null_buffers(),
-			asio::bind_executor(userp->m_strand, std::bind(&Multi::EventCallback,
-				userp, std::placeholders::_1, s, CURL_POLL_OUT, socketp)));
+		userp->WaitSocket(socketIt->second, s, CURL_POLL_OUT);
 	return 0;
 }
 
@@ -126,90 +974,252 @@ int Multi::TimerCallback(CURLM* multi, long timeout_ms, Multi* userp) noexcept
 		// delete the timer, per cURL docs
 		cma::error_code ignored;
 		userp->m_timer.cancel(ignored);
+		userp->m_instruments->timerArmed.store(false, std::memory_order_relaxed);
 	}
 	else
 	{
 		// start the timer
+		userp->m_instruments->timerArmed.store(true, std::memory_order_relaxed);
+		userp->m_instruments->timerRearms.fetch_add(1, std::memory_order_relaxed);
 		userp->m_timer.expires_from_now(std::chrono::milliseconds(timeout_ms));
 		userp->m_timer.async_wait(asio::bind_executor(
 			userp->m_strand, [userp] (const cma::error_code& ec)
 			{
 				if (ec)
 					return;
-				int still_running = 0;
-				cma::error_code ignored;
-				if (auto err = curl_multi_socket_action(userp->GetNativeHandle(),
-					CURL_SOCKET_TIMEOUT, 0, &still_running); err != CURLMcode::CURLM_OK)
-				{
-					userp->Cancel(ignored, err);
-					return;
-				}
-				// we may have completed some transfers here. check
-				userp->CheckTransfers();
+				userp->m_instruments->timerArmed.store(false, std::memory_order_relaxed);
+				const auto lag = std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::system_clock::now() - userp->m_timer.expiry());
+				userp->m_instruments->timerLag.Record(lag);
+				CMA_PROBE2(timer__fire, 0, static_cast<int64_t>(lag.count()));
+				userp->SocketAction(CURL_SOCKET_TIMEOUT, 0);
 			}));
 	}
 	return 0;
 }
 
-void Multi::CheckTransfers() noexcept
+int Multi::DebugCallback(CURL* easy, curl_infotype type, char* data,
+	size_t size, PerformHandlerBase* handler) noexcept
+{
+	handler->GetRecorder()->Record(easy, type, data, size);
+	// cURL only calls a debug callback with verbose on
+	const auto& owner = handler->GetEasy();
+	if (owner.m_verbose == true && owner.m_debugFunction != nullptr)
+		owner.m_debugFunction(easy, type, data, size, owner.m_debugData);
+	return 0;
+}
+
+void Multi::Trace(TraceEventType type, const Easy* transfer, curl_socket_t socket,
+	CURLcode result, std::chrono::steady_clock::time_point time) const noexcept
+{
+	auto sink = GetTraceSink();
+	if (sink == nullptr)
+		return;
+	if (time == std::chrono::steady_clock::time_point())
+		time = std::chrono::steady_clock::now();
+	sink->OnEvent({ type, time, transfer, socket, result });
+}
+
+void Multi::TraceTimings(const Easy* transfer, CURL* easy,
+	std::chrono::steady_clock::time_point done) const noexcept
+{
+	// cURL's times are from the start of the attempt, so count
+	// back from the end of it
+	curl_off_t connect = 0, startTransfer = 0, total = 0;
+	curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer);
+	curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &total);
+	const auto start = done - std::chrono::microseconds(total);
+	// a reused connection wasn't made by this attempt
+	if (connect > 0)
+		Trace(TraceEventType::Connect, transfer, CURL_SOCKET_BAD, CURLE_OK,
+			start + std::chrono::microseconds(connect));
+	if (startTransfer > 0)
+		Trace(TraceEventType::FirstByte, transfer, CURL_SOCKET_BAD, CURLE_OK,
+			start + std::chrono::microseconds(startTransfer));
+}
+
+std::optional<int> Multi::SocketAction(curl_socket_t s, int what) noexcept
+{
+	auto& instruments = *m_instruments;
+	int still_running = 0;
+	const auto start = std::chrono::steady_clock::now();
+	const auto err = curl_multi_socket_action(GetNativeHandle(), s, what, &still_running);
+	const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start);
+	instruments.socketAction.Record(duration);
+	CMA_PROBE4(socket__action, s, what, static_cast<int>(err),
+		static_cast<int64_t>(duration.count()));
+	if (err != CURLMcode::CURLM_OK)
+	{
+		CancelAll();
+		return std::nullopt;
+	}
+	// we may have completed some transfers here. check
+	const uint64_t events = CheckTransfers();
+	instruments.turns.fetch_add(1, std::memory_order_relaxed);
+	instruments.events.fetch_add(events, std::memory_order_relaxed);
+	// only the strand writes it, so there is no race to lose
+	if (events > instruments.maxEventsPerTurn.load(std::memory_order_relaxed))
+		instruments.maxEventsPerTurn.store(events, std::memory_order_relaxed);
+	return still_running;
+}
+
+void Multi::WaitSocket(asio::ip::tcp::socket& socket, curl_socket_t s,
+	int what) noexcept
+{
+	// the wait completes on the executor, where the time the socket was
+	// ready is taken, and only then queues up for the strand
+	auto handler = [this, s, what](const cma::error_code& ec, size_t)
+	{
+		// waits are only aborted when their socket is closed, either by cURL
+		// or as the handle is destroyed, and then there is nothing to handle
+		if (ec == asio::error::operation_aborted)
+			return;
+		asio::dispatch(m_strand, std::bind(&Multi::EventCallback, this, ec, s, what,
+			std::chrono::steady_clock::now()));
+	};
+	if (what == CURL_POLL_IN)
+		socket.async_read_some(asio::null_buffers(), std::move(handler));
+	else
+		socket.async_write_some(asio::null_buffers(), std::move(handler));
+}
+
+cma::LoopHealth Multi::GetLoopHealth() const
+{
+	const auto& instruments = *m_instruments;
+	LoopHealth health;
+	health.readyDelay = instruments.readyDelay.GetSnapshot();
+	health.timerLag = instruments.timerLag.GetSnapshot();
+	health.socketAction = instruments.socketAction.GetSnapshot();
+	health.handlers = instruments.handlers.GetSnapshot();
+	health.turns = instruments.turns.load(std::memory_order_relaxed);
+	health.events = instruments.events.load(std::memory_order_relaxed);
+	health.maxEventsPerTurn = instruments.maxEventsPerTurn.load(std::memory_order_relaxed);
+	return health;
+}
+
+cma::MultiStats Multi::GetStats() const noexcept
 {
+	const auto& instruments = *m_instruments;
+	MultiStats stats;
+	stats.queued = instruments.queued.load(std::memory_order_relaxed);
+	stats.inFlight = instruments.inFlight.load(std::memory_order_relaxed);
+	stats.completed = instruments.completed.load(std::memory_order_relaxed);
+	stats.failed = instruments.failed.load(std::memory_order_relaxed);
+	stats.cancelled = instruments.cancelled.load(std::memory_order_relaxed);
+	stats.openSockets = instruments.openSockets.load(std::memory_order_relaxed);
+	stats.bytesDown = instruments.bytesDown.load(std::memory_order_relaxed);
+	stats.bytesUp = instruments.bytesUp.load(std::memory_order_relaxed);
+	stats.connectionsOpened = instruments.connectionsOpened.load(std::memory_order_relaxed);
+	stats.connectionsReused = instruments.connectionsReused.load(std::memory_order_relaxed);
+	stats.timerRearms = instruments.timerRearms.load(std::memory_order_relaxed);
+	stats.timerArmed = instruments.timerArmed.load(std::memory_order_relaxed);
+	return stats;
+}
+
+size_t Multi::CheckTransfers() noexcept
+{
+	size_t completed = 0;
 	int msgs_in_queue = 0;
 	while (CURLMsg* msg = curl_multi_info_read(GetNativeHandle(), &msgs_in_queue))
 	{
 		// only pay attention to finished transfers
 		if (msg->msg != CURLMSG::CURLMSG_DONE)
 			continue;
-		auto handlerIt = m_easyHandlerMap.find(msg->easy_handle);
-		if (handlerIt == m_easyHandlerMap.end())
+		// the message is gone once the handle is removed
+		CURL* easy = msg->easy_handle;
+		CURLcode result = msg->data.result;
+		auto handler = FindHandler(easy);
+		if (handler == nullptr)
 			continue;
+		if (GetTraceSink() != nullptr)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			const Easy* transfer = &handler->GetEasy();
+			if (auto& duplicate = handler->GetHedge().duplicate; duplicate != nullptr &&
+				duplicate->GetNativeHandle() == easy)
+				transfer = duplicate.get();
+			TraceTimings(transfer, easy, now);
+			Trace(TraceEventType::Done, transfer, CURL_SOCKET_BAD, result, now);
+		}
+		// every attempt counts towards the totals, even those retried
+		curl_off_t downloaded = 0, uploaded = 0;
+		long connects = 0;
+		curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+		curl_easy_getinfo(easy, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+		curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+		auto& instruments = *m_instruments;
+		instruments.bytesDown.fetch_add(downloaded, std::memory_order_relaxed);
+		instruments.bytesUp.fetch_add(uploaded, std::memory_order_relaxed);
+		instruments.connectionsOpened.fetch_add(connects, std::memory_order_relaxed);
+		// an attempt that failed without connecting made no connection either
+		if (connects == 0 && result == CURLE_OK)
+			instruments.connectionsReused.fetch_add(1, std::memory_order_relaxed);
+		CMA_PROBE4(transfer__done, easy, static_cast<int>(result),
+			static_cast<int64_t>(downloaded), static_cast<int64_t>(uploaded));
+		// a hedged transfer may keep running with its other half
+		if (ResolveHedge(*handler, easy, result) == true)
+			continue;
+		RecordAttempt(*handler, result);
+		FinishRoute(*handler, result);
+		// the handler stays tracked while it waits for another attempt
+		if (RetryTransfer(*handler, result) == true)
+			continue;
+		if (auto& hedge = handler->GetHedge(); hedge.policy != nullptr && result == CURLE_OK)
+			hedge.policy->RecordLatency(std::chrono::steady_clock::now() - hedge.start);
+		m_instruments->timings.Record(handler->GetEasyHandle(), handler->GetOrigin());
+		auto handlerIt = m_easyHandlerMap.find(handler->GetEasyHandle());
 		// move the handler out and erase it in case 
 		// it tries to cancel itself
-		auto handler = std::move(handlerIt->second);
-		// remove it from the handler map. the deleter
+		auto owned = std::move(handlerIt->second);
+		// remove it from the handler map. untracking it
 		// will also remove the handle from multi
 		m_easyHandlerMap.erase(handlerIt);
+		m_instruments->inFlight.fetch_sub(1, std::memory_order_relaxed);
+		if (auto recorder = owned->GetRecorder(); recorder != nullptr && result != CURLE_OK)
+			recorder->DumpFailure(owned->GetEasyHandle(), result);
+		Untrack(*owned);
 		// a descriptor is done. call its handler
-		handler->Complete(msg->data.result);
+		owned->Complete(result);
+		++completed;
 	}
+	return completed;
 }
 
 void Multi::EventCallback(const cma::error_code& ec, curl_socket_t s,
-	int what, int* last) noexcept
+	int what, std::chrono::steady_clock::time_point ready) noexcept
 {
+	m_instruments->readyDelay.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - ready));
 	// make sure it's a socket that hasn't bene closed
-	if (m_easySocketMap.find(s) == m_easySocketMap.end())
+	auto actionIt = m_socketActions.find(s);
+	if (m_easySocketMap.find(s) == m_easySocketMap.end() || actionIt == m_socketActions.end())
 		return;
 	// if the action changed, let curl handle it
-	if (what != *last && *last != CURL_POLL_INOUT)
+	if (what != actionIt->second && actionIt->second != CURL_POLL_INOUT)
 		return;
-	int still_running = 0;
 	cma::error_code ignored;
 	if (ec)
 		what = CURL_CSELECT_ERR;
-	if (auto err = curl_multi_socket_action(GetNativeHandle(), s,
-		what, &still_running); err != CURLMcode::CURLM_OK)
-	{
-		Cancel(ignored, err);
+	// this also checks for completed transfers
+	const auto still_running = SocketAction(s, what);
+	if (still_running.has_value() == false)
 		return;
-	}
-	// check for completed transfers
-	CheckTransfers();
 	// we have no reason to continue if there are none running
-	if (still_running == 0)
+	if (*still_running == 0)
+	{
 		m_timer.cancel(ignored);
+		m_instruments->timerArmed.store(false, std::memory_order_relaxed);
+	}
 	// if the socket still exists and the mission remainds
 	// unchanged, keep it up
-	auto socketIt = m_easySocketMap.find(s);	
-	if (!ec && socketIt != m_easySocketMap.end() &&
-		(what == *last || *last == CURL_POLL_INOUT))
-	{
-		if (what == CURL_POLL_IN)
-			socketIt->second.async_read_some(asio::null_buffers(),
-				asio::bind_executor(m_strand, std::bind(&Multi::EventCallback,
-					this, std::placeholders::_1, s, what, last)));
-		else if (what == CURL_POLL_OUT)
-			socketIt->second.async_write_some(asio::null_buffers(),
-				asio::bind_executor(m_strand, std::bind(&Multi::EventCallback,
-					this, std::placeholders::_1, s, what, last)));
+	auto socketIt = m_easySocketMap.find(s);
+	actionIt = m_socketActions.find(s);
+	if (!ec && socketIt != m_easySocketMap.end() && actionIt != m_socketActions.end() &&
+		(what == actionIt->second || actionIt->second == CURL_POLL_INOUT))
+	{
+		if (what == CURL_POLL_IN || what == CURL_POLL_OUT)
+			WaitSocket(socketIt->second, s, what);
 	}
 }
\ No newline at end of file
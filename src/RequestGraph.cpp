@@ -0,0 +1,161 @@
+#include <curl-multi-asio/RequestGraph.h>
+
+#include <curl-multi-asio/RequestGroup.h>
+
+using cma::RequestGraph;
+
+RequestGraph::RequestGraph(Multi& multi, PerformOptions options) :
+	m_multi(multi), m_options(std::move(options)), m_strand(multi.GetExecutor()),
+	m_nodes(&m_arena)
+{
+	m_options.group = std::make_shared<RequestGroup>(multi);
+}
+
+tl::expected<RequestGraph::NodeId, cma::error_code> RequestGraph::AddNode(
+	Factory factory, std::initializer_list<NodeId> dependencies)
+{
+	if (m_started == true)
+		return tl::make_unexpected(error_code(asio::error::already_started));
+	for (auto dependency : dependencies)
+	{
+		if (dependency >= m_nodes.size())
+			return tl::make_unexpected(error_code(asio::error::invalid_argument));
+	}
+	const NodeId id = m_nodes.size();
+	auto& node = m_nodes.emplace_back(std::move(factory), &m_arena);
+	node.dependencies.assign(dependencies.begin(), dependencies.end());
+	node.waiting = dependencies.size();
+	for (auto dependency : dependencies)
+		m_nodes[dependency].dependents.push_back(id);
+	return id;
+}
+
+void RequestGraph::Cancel() noexcept
+{
+	// the requests in flight are cancelled right away, and any the strand
+	// launches before it sees the graph was cancelled are aborted by the group
+	m_options.group->Cancel();
+	asio::post(m_strand, [self = shared_from_this()]
+		{
+			self->m_cancelled = true;
+			// a run that hasn't started skips everything as it starts, and
+			// one that has finished has nothing left to skip
+			if (self->m_handler == nullptr)
+				return;
+			for (NodeId node = 0; node < self->m_nodes.size(); ++node)
+			{
+				if (self->m_nodes[node].state == NodeState::Waiting)
+					self->Skip(node);
+			}
+		});
+}
+
+RequestGraph::Result RequestGraph::GetResult(NodeId node) const noexcept
+{
+	const auto& state = m_nodes[node];
+	return { &state.easy, state.body };
+}
+
+cma::error_code RequestGraph::GetError(NodeId node) const noexcept
+{
+	return m_nodes[node].ec;
+}
+
+void RequestGraph::Run(std::unique_ptr<Detail::GraphHandlerBase> handler)
+{
+	if (std::exchange(m_started, true) == true)
+	{
+		asio::post(m_strand, [handler = std::move(handler)]
+			{
+				handler->Complete(asio::error::already_started);
+			});
+		return;
+	}
+	asio::post(m_strand, [self = shared_from_this(),
+		handler = std::move(handler)]() mutable
+		{
+			self->m_handler = std::move(handler);
+			self->m_remaining = self->m_nodes.size();
+			if (self->m_remaining == 0)
+				return std::exchange(self->m_handler, nullptr)->Complete(
+					(self->m_cancelled == true) ? error_code(asio::error::operation_aborted) : error_code());
+			// when the graph was cancelled, every node launched is skipped
+			// along with everything downstream of it, which is all of them
+			for (NodeId node = 0; node < self->m_nodes.size(); ++node)
+			{
+				if (self->m_nodes[node].waiting == 0 &&
+					self->m_nodes[node].state == NodeState::Waiting)
+					self->Launch(node);
+			}
+		});
+}
+
+void RequestGraph::Launch(NodeId id) noexcept
+{
+	auto& node = m_nodes[id];
+	if (m_cancelled == true)
+		return Skip(id);
+	node.state = NodeState::Running;
+	// the bodies grow in the arena on the Multi's strand, so the inputs go
+	// on the stack, and only spill to the heap for nodes with many inputs
+	std::byte buffer[8 * sizeof(Result)];
+	std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+	std::pmr::vector<Result> inputs(&scratch);
+	inputs.reserve(node.dependencies.size());
+	for (auto dependency : node.dependencies)
+		inputs.push_back(GetResult(dependency));
+	// set first, so that the factory can set a buffer of its own
+	node.easy.SetBuffer(node.body);
+	if (auto ec = node.factory(node.easy, inputs); ec)
+		return Land(id, ec);
+	m_multi.AsyncPerform(node.easy, m_options,
+		[self = shared_from_this(), id](const error_code& ec)
+		{
+			asio::dispatch(self->m_strand, [self, id, ec]
+				{
+					self->Land(id, ec);
+				});
+		});
+}
+
+void RequestGraph::Land(NodeId id, error_code ec) noexcept
+{
+	auto& node = m_nodes[id];
+	// settled first, so that the run fails with its error rather than
+	// with the errors of the nodes skipped because of it
+	if (ec)
+	{
+		Settle(id, ec);
+		for (auto dependent : node.dependents)
+			Skip(dependent);
+		return;
+	}
+	for (auto dependent : node.dependents)
+	{
+		if (--m_nodes[dependent].waiting == 0 &&
+			m_nodes[dependent].state == NodeState::Waiting)
+			Launch(dependent);
+	}
+	Settle(id, ec);
+}
+
+void RequestGraph::Skip(NodeId id) noexcept
+{
+	// a node downstream of several failures is only skipped once
+	if (m_nodes[id].state != NodeState::Waiting)
+		return;
+	for (auto dependent : m_nodes[id].dependents)
+		Skip(dependent);
+	Settle(id, asio::error::operation_aborted);
+}
+
+void RequestGraph::Settle(NodeId id, error_code ec) noexcept
+{
+	auto& node = m_nodes[id];
+	node.state = NodeState::Done;
+	node.ec = ec;
+	if (ec && !m_firstError)
+		m_firstError = ec;
+	if (--m_remaining == 0)
+		std::exchange(m_handler, nullptr)->Complete(m_firstError);
+}
@@ -0,0 +1,40 @@
+#include <curl-multi-asio/RequestGroup.h>
+
+using cma::RequestGroup;
+
+void RequestGroup::Cancel() noexcept
+{
+	// only the first cancel does anything
+	if (m_cancelled.exchange(true, std::memory_order_acq_rel) == true)
+		return;
+	// once the Multi is gone, so are the transfers it started
+	asio::dispatch(m_strand, [self = shared_from_this()]
+		{
+			if (self->m_instruments->closed.load(std::memory_order_acquire) == false)
+				self->m_multi.CancelGroup(*self);
+		});
+}
+
+void RequestGroup::Wait(std::unique_ptr<Detail::GroupWaiterBase> waiter)
+{
+	asio::dispatch(m_strand, [self = shared_from_this(),
+		waiter = std::move(waiter)]() mutable
+		{
+			self->m_waiters.push_back(std::move(waiter));
+			self->Settle();
+		});
+}
+
+void RequestGroup::Settle() noexcept
+{
+	// a transfer may have been submitted since the last one completed
+	if (m_waiters.empty() == true || m_outstanding.load(std::memory_order_acquire) > 0)
+		return;
+	// a waiter may wait again from its handler
+	auto waiters = std::move(m_waiters);
+	m_waiters.clear();
+	const auto ec = (Cancelled() == true) ?
+		error_code(asio::error::operation_aborted) : error_code();
+	for (auto& waiter : waiters)
+		waiter->Complete(ec, GetFailed());
+}
@@ -0,0 +1,356 @@
+#include <curl-multi-asio/ResponseCache.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+using cma::CacheEntry;
+using cma::ResponseCache;
+using Clock = CacheEntry::Clock;
+
+namespace
+{
+	/// @brief Trims spaces and tabs off both ends of a string
+	/// @param str The string
+	/// @return The trimmed string
+	std::string_view Trim(std::string_view str) noexcept
+	{
+		while (str.empty() == false && (str.front() == ' ' || str.front() == '\t'))
+			str.remove_prefix(1);
+		while (str.empty() == false && (str.back() == ' ' || str.back() == '\t'))
+			str.remove_suffix(1);
+		return str;
+	}
+
+	/// @brief Calls a function with each trimmed, non-empty element of
+	/// a comma separated list
+	/// @param list The list
+	/// @param fn The function
+	template<typename Fn>
+	void ForEachElement(std::string_view list, Fn&& fn)
+	{
+		while (list.empty() == false)
+		{
+			const auto comma = list.find(',');
+			const auto element = Trim(list.substr(0, comma));
+			list.remove_prefix((comma == std::string_view::npos) ? list.size() : comma + 1);
+			if (element.empty() == false)
+				fn(element);
+		}
+	}
+
+	/// @brief Parses a number of seconds, as in max-age and Age
+	/// @param value The value
+	/// @return The seconds, or nothing if the value isn't a valid number
+	std::optional<std::chrono::seconds> ParseSeconds(std::string_view value) noexcept
+	{
+		if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+			value = value.substr(1, value.size() - 2);
+		long long seconds = 0;
+		const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), seconds);
+		if (ec != std::errc() || end != value.data() + value.size() || seconds < 0)
+			return std::nullopt;
+		return std::chrono::seconds(seconds);
+	}
+
+	/// @brief Parses an HTTP date
+	/// @param value The value
+	/// @return The time, or nothing if the value isn't a valid date
+	std::optional<Clock::time_point> ParseDate(std::optional<std::string_view> value) noexcept
+	{
+		if (value.has_value() == false)
+			return std::nullopt;
+		const std::string date(*value);
+		const auto time = curl_getdate(date.c_str(), nullptr);
+		if (time == -1)
+			return std::nullopt;
+		return Clock::from_time_t(time);
+	}
+
+	/// @param from The start
+	/// @param to The end
+	/// @return The whole seconds from one time to another, or zero if
+	/// the end comes first
+	std::chrono::seconds Between(Clock::time_point from, Clock::time_point to) noexcept
+	{
+		return (to > from) ? std::chrono::duration_cast<std::chrono::seconds>(to - from) :
+			std::chrono::seconds(0);
+	}
+
+	/// @brief Sets the age and freshness lifetime of an entry from the
+	/// headers of a response, as in RFC 9111 sections 4.2.1 through 4.2.3
+	/// @param entry The entry
+	/// @param headers The raw header block of the response
+	/// @param cacheControl The parsed Cache-Control header of the response
+	/// @param requestTime When the request was sent
+	/// @param responseTime When the response was received
+	void SetFreshness(CacheEntry& entry, std::string_view headers,
+		const cma::Detail::CacheControl& cacheControl, Clock::time_point requestTime,
+		Clock::time_point responseTime) noexcept
+	{
+		using cma::Detail::FindHeader;
+		const auto date = ParseDate(FindHeader(headers, "date")).value_or(responseTime);
+		const auto age = FindHeader(headers, "age");
+		const auto ageValue = (age.has_value() == true) ?
+			ParseSeconds(*age).value_or(std::chrono::seconds(0)) : std::chrono::seconds(0);
+		entry.responseTime = responseTime;
+		entry.initialAge = std::max(Between(date, responseTime),
+			ageValue + Between(requestTime, responseTime));
+		entry.noCache = cacheControl.noCache;
+		if (cacheControl.maxAge.has_value() == true)
+		{
+			entry.lifetime = *cacheControl.maxAge;
+			return;
+		}
+		if (const auto expires = FindHeader(headers, "expires"); expires.has_value() == true)
+		{
+			// an invalid date means the response has already expired
+			const auto expiresAt = ParseDate(expires);
+			entry.lifetime = (expiresAt.has_value() == true) ?
+				Between(date, *expiresAt) : std::chrono::seconds(0);
+			return;
+		}
+		// with nothing explicit to go by, guess a tenth of how long the
+		// resource had gone unmodified, capped at a day
+		const auto lastModified = ParseDate(FindHeader(headers, "last-modified"));
+		entry.lifetime = (lastModified.has_value() == true) ?
+			std::min<std::chrono::seconds>(Between(*lastModified, date) / 10,
+				std::chrono::hours(24)) : std::chrono::seconds(0);
+	}
+}
+
+cma::Detail::CacheControl cma::Detail::CacheControl::Parse(std::string_view value) noexcept
+{
+	CacheControl cacheControl;
+	ForEachElement(value, [&cacheControl](std::string_view directive)
+		{
+			const auto equals = directive.find('=');
+			const auto name = Trim(directive.substr(0, equals));
+			const auto argument = (equals == std::string_view::npos) ?
+				std::string_view() : Trim(directive.substr(equals + 1));
+			if (HeaderNameEquals(name, "no-store") == true)
+				cacheControl.noStore = true;
+			else if (HeaderNameEquals(name, "no-cache") == true)
+				cacheControl.noCache = true;
+			else if (HeaderNameEquals(name, "max-age") == true)
+			{
+				// an invalid max-age is treated as already expired
+				cacheControl.maxAge = ParseSeconds(argument).value_or(
+					std::chrono::seconds(0));
+			}
+		});
+	return cacheControl;
+}
+
+std::optional<CacheEntry> CacheEntry::FromResponse(const HttpRequest& request,
+	ResponsePtr response, Clock::time_point requestTime,
+	Clock::time_point responseTime) noexcept
+{
+	if (response == nullptr)
+		return std::nullopt;
+	// only the statuses that are cacheable by default, RFC 9110 section 15.1
+	switch (response->status)
+	{
+	case 200: case 203: case 204: case 300: case 301: case 308:
+	case 404: case 405: case 410: case 414: case 501:
+		break;
+	default:
+		return std::nullopt;
+	}
+	const std::string_view headers = response->headers;
+	const auto cacheControl = Detail::CacheControl::Parse(
+		Detail::FindHeader(headers, "cache-control").value_or(""));
+	if (cacheControl.noStore == true)
+		return std::nullopt;
+	CacheEntry entry;
+	bool varyAll = false;
+	ForEachElement(Detail::FindHeader(headers, "vary").value_or(""),
+		[&entry, &request, &varyAll](std::string_view name)
+		{
+			if (name == "*")
+				varyAll = true;
+			std::string lowered(name);
+			std::transform(lowered.begin(), lowered.end(), lowered.begin(),
+				[](unsigned char c)
+				{
+					return static_cast<char>(std::tolower(c));
+				});
+			entry.vary.emplace_back(std::move(lowered),
+				std::string(request.FindHeader(name).value_or("")));
+		});
+	// a response that varies on everything can never be reused
+	if (varyAll == true)
+		return std::nullopt;
+	entry.etag = Detail::FindHeader(headers, "etag").value_or("");
+	entry.lastModified = Detail::FindHeader(headers, "last-modified").value_or("");
+	SetFreshness(entry, headers, cacheControl, requestTime, responseTime);
+	// a response that is stale right away and can't be revalidated is useless
+	if (entry.lifetime.count() == 0 && entry.HasValidators() == false)
+		return std::nullopt;
+	entry.response = std::move(response);
+	return entry;
+}
+
+void CacheEntry::Refresh(std::string_view headers, Clock::time_point requestTime,
+	Clock::time_point responseTime) noexcept
+{
+	const auto cacheControl = Detail::CacheControl::Parse(
+		Detail::FindHeader(headers, "cache-control").value_or(""));
+	if (const auto newEtag = Detail::FindHeader(headers, "etag"); newEtag.has_value() == true)
+		etag = *newEtag;
+	// a 304 doesn't have to repeat what didn't change, so only the stored
+	// response's Last-Modified can be a fallback for the heuristic
+	std::string combined;
+	std::string_view freshnessHeaders = headers;
+	if (Detail::FindHeader(headers, "last-modified").has_value() == false &&
+		lastModified.empty() == false)
+	{
+		combined = std::string(headers) + "Last-Modified: " + lastModified + "\r\n";
+		freshnessHeaders = combined;
+	}
+	SetFreshness(*this, freshnessHeaders, cacheControl, requestTime, responseTime);
+}
+
+std::chrono::seconds CacheEntry::Age(Clock::time_point now) const noexcept
+{
+	return initialAge + Between(responseTime, now);
+}
+
+bool CacheEntry::Fresh(Clock::time_point now) const noexcept
+{
+	return noCache == false && Age(now) < lifetime;
+}
+
+bool CacheEntry::Matches(const HttpRequest& request) const noexcept
+{
+	return std::all_of(vary.begin(), vary.end(), [&request](const auto& header)
+		{
+			return request.FindHeader(header.first).value_or("") == header.second;
+		});
+}
+
+ResponseCache::ResponseCache(size_t capacity, size_t shards) noexcept :
+	m_capacity(capacity), m_shardCount(std::max<size_t>(shards, 1)),
+	m_shards(std::make_unique<Shard[]>(m_shardCount))
+{
+	m_shardCapacity = m_capacity / m_shardCount;
+}
+
+cma::CacheEntryPtr ResponseCache::Find(std::string_view key) noexcept
+{
+	auto& shard = GetShard(key);
+	std::lock_guard lock(shard.mutex);
+	auto nodeIt = shard.index.find(key);
+	if (nodeIt == shard.index.end())
+		return nullptr;
+	shard.lru.splice(shard.lru.begin(), shard.lru, nodeIt->second);
+	return nodeIt->second->entry;
+}
+
+void ResponseCache::Store(std::string_view key, CacheEntryPtr entry) noexcept
+{
+	if (entry == nullptr)
+		return;
+	const auto bytes = Charge(key, *entry);
+	if (bytes > m_shardCapacity)
+	{
+		// the old entry would be out of date, so it can't stay either
+		Erase(key);
+		return;
+	}
+	// evicted entries are released once the lock is, in case this was the
+	// last reference to a large response
+	std::vector<CacheEntryPtr> evicted;
+	auto& shard = GetShard(key);
+	std::lock_guard lock(shard.mutex);
+	if (auto nodeIt = shard.index.find(key); nodeIt != shard.index.end())
+	{
+		auto& node = *nodeIt->second;
+		shard.bytes -= node.bytes;
+		evicted.push_back(std::exchange(node.entry, std::move(entry)));
+		node.bytes = bytes;
+		shard.lru.splice(shard.lru.begin(), shard.lru, nodeIt->second);
+	}
+	else
+	{
+		shard.lru.push_front(Node{ std::string(key), std::move(entry), bytes });
+		shard.index.emplace(shard.lru.front().key, shard.lru.begin());
+	}
+	shard.bytes += bytes;
+	while (shard.bytes > m_shardCapacity)
+	{
+		auto& node = shard.lru.back();
+		shard.bytes -= node.bytes;
+		evicted.push_back(std::move(node.entry));
+		shard.index.erase(node.key);
+		shard.lru.pop_back();
+		m_evictions.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void ResponseCache::Erase(std::string_view key) noexcept
+{
+	CacheEntryPtr erased;
+	auto& shard = GetShard(key);
+	std::lock_guard lock(shard.mutex);
+	auto nodeIt = shard.index.find(key);
+	if (nodeIt == shard.index.end())
+		return;
+	auto lruIt = nodeIt->second;
+	shard.bytes -= lruIt->bytes;
+	erased = std::move(lruIt->entry);
+	shard.index.erase(nodeIt);
+	shard.lru.erase(lruIt);
+}
+
+void ResponseCache::Clear() noexcept
+{
+	for (size_t i = 0; i < m_shardCount; ++i)
+	{
+		std::list<Node> cleared;
+		std::lock_guard lock(m_shards[i].mutex);
+		m_shards[i].index.clear();
+		cleared.swap(m_shards[i].lru);
+		m_shards[i].bytes = 0;
+	}
+}
+
+size_t ResponseCache::GetSize() const noexcept
+{
+	size_t size = 0;
+	for (size_t i = 0; i < m_shardCount; ++i)
+	{
+		std::lock_guard lock(m_shards[i].mutex);
+		size += m_shards[i].bytes;
+	}
+	return size;
+}
+
+size_t ResponseCache::GetCount() const noexcept
+{
+	size_t count = 0;
+	for (size_t i = 0; i < m_shardCount; ++i)
+	{
+		std::lock_guard lock(m_shards[i].mutex);
+		count += m_shards[i].index.size();
+	}
+	return count;
+}
+
+ResponseCache::Shard& ResponseCache::GetShard(std::string_view key) noexcept
+{
+	return m_shards[std::hash<std::string_view>{}(key) % m_shardCount];
+}
+
+size_t ResponseCache::Charge(std::string_view key, const CacheEntry& entry) noexcept
+{
+	// the fixed part is a rough guess at the bookkeeping of the list,
+	// the index, and the shared pointers
+	size_t bytes = sizeof(Node) + sizeof(CacheEntry) + sizeof(SharedResponse) + 64;
+	bytes += key.size() + entry.etag.size() + entry.lastModified.size();
+	for (const auto& [name, value] : entry.vary)
+		bytes += name.size() + value.size();
+	if (entry.response != nullptr)
+		bytes += entry.response->headers.size() + entry.response->GetBody().size();
+	return bytes;
+}
@@ -0,0 +1,107 @@
+#include <curl-multi-asio/RetryPolicy.h>
+
+#include <algorithm>
+#include <random>
+
+using cma::RetryBudget;
+using cma::RetryPolicy;
+
+RetryBudget::RetryBudget(double maxTokens, double tokenRatio) noexcept :
+	m_milliTokens(static_cast<int64_t>(maxTokens * 1000.0)),
+	m_maxMilliTokens(static_cast<int64_t>(maxTokens * 1000.0)),
+	m_ratioMilliTokens(static_cast<int64_t>(tokenRatio * 1000.0)) {}
+
+void RetryBudget::OnSuccess() noexcept
+{
+	auto tokens = m_milliTokens.load(std::memory_order_relaxed);
+	while (tokens < m_maxMilliTokens && m_milliTokens.compare_exchange_weak(tokens,
+		std::min(tokens + m_ratioMilliTokens, m_maxMilliTokens),
+		std::memory_order_relaxed) == false);
+}
+
+bool RetryBudget::OnFailure() noexcept
+{
+	auto tokens = m_milliTokens.load(std::memory_order_relaxed);
+	while (tokens > 0 && m_milliTokens.compare_exchange_weak(tokens,
+		std::max<int64_t>(tokens - 1000, 0), std::memory_order_relaxed) == false);
+	// compare with what was left after paying for this failure
+	return std::max<int64_t>(tokens - 1000, 0) > m_maxMilliTokens / 2;
+}
+
+double RetryBudget::GetTokens() const noexcept
+{
+	return static_cast<double>(m_milliTokens.load(std::memory_order_relaxed)) / 1000.0;
+}
+
+bool RetryPolicy::IsTransient(const error_code& ec, long httpStatus) noexcept
+{
+	if (ec.category() == Detail::CURLcodeErrCategory::Instance())
+	{
+		switch (static_cast<CURLcode>(ec.value()))
+		{
+		case CURLcode::CURLE_COULDNT_CONNECT:
+		case CURLcode::CURLE_OPERATION_TIMEDOUT:
+		case CURLcode::CURLE_GOT_NOTHING:
+		case CURLcode::CURLE_SEND_ERROR:
+		case CURLcode::CURLE_RECV_ERROR:
+		case CURLcode::CURLE_PARTIAL_FILE:
+		case CURLcode::CURLE_HTTP2:
+		case CURLcode::CURLE_HTTP2_STREAM:
+			return true;
+		// with CURLOPT_FAILONERROR the status decides
+		case CURLcode::CURLE_HTTP_RETURNED_ERROR:
+			break;
+		default:
+			return false;
+		}
+	}
+	else if (ec)
+		return false;
+	switch (httpStatus)
+	{
+	case 408:
+	case 429:
+	case 500:
+	case 502:
+	case 503:
+	case 504:
+		return true;
+	default:
+		return false;
+	}
+}
+
+std::optional<std::chrono::milliseconds> RetryPolicy::NextDelay(const error_code& ec,
+	long httpStatus, unsigned attempt, std::optional<std::chrono::seconds> retryAfter,
+	std::optional<std::chrono::milliseconds> remaining) const noexcept
+{
+	if (attempt >= maxAttempts)
+		return std::nullopt;
+	const auto retryable = (isRetryable) ? isRetryable(ec, httpStatus) :
+		IsTransient(ec, httpStatus);
+	if (retryable == false)
+		return std::nullopt;
+	// capped exponential backoff. the shift is capped too so it can't overflow
+	const auto shift = std::min(attempt - 1, 30u);
+	const auto capped = std::min<int64_t>(baseDelay.count() * (int64_t(1) << shift),
+		maxDelay.count());
+	// take a random part of the delay off, so that clients that failed
+	// together don't retry together
+	thread_local std::minstd_rand s_rng(std::random_device{}());
+	const auto fraction = std::clamp(jitter, 0.0, 1.0) *
+		std::uniform_real_distribution<double>(0.0, 1.0)(s_rng);
+	auto delay = std::chrono::milliseconds(static_cast<int64_t>(
+		static_cast<double>(capped) * (1.0 - fraction)));
+	if (honorRetryAfter == true && retryAfter.has_value() == true &&
+		(httpStatus == 429 || httpStatus == 503))
+	{
+		if (*retryAfter > maxRetryAfter)
+			return std::nullopt;
+		delay = std::max<std::chrono::milliseconds>(delay, *retryAfter);
+	}
+	if (remaining.has_value() == true && delay >= *remaining)
+		return std::nullopt;
+	if (budget != nullptr && budget->OnFailure() == false)
+		return std::nullopt;
+	return delay;
+}
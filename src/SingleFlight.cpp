@@ -0,0 +1,135 @@
+#include <curl-multi-asio/SingleFlight.h>
+
+#include <algorithm>
+#include <cctype>
+
+using cma::SingleFlight;
+
+namespace
+{
+	/// @brief Lowercases a string in place
+	/// @param str The string
+	void Lowercase(std::string& str) noexcept
+	{
+		std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c)
+			{
+				return static_cast<char>(std::tolower(c));
+			});
+	}
+}
+
+SingleFlight::SingleFlight(Multi& multi, std::vector<std::string> keyHeaders,
+	Configure configure) noexcept :
+	m_multi(multi), m_keyHeaders(std::move(keyHeaders)),
+	m_configure(std::move(configure)), m_strand(multi.GetExecutor())
+{
+	for (auto& name : m_keyHeaders)
+		Lowercase(name);
+}
+
+std::string SingleFlight::MakeKey(const Request& request) const
+{
+	std::string key = request.method;
+	key += ' ';
+	key += request.url;
+	// the key headers in a fixed order, whatever order they were given in
+	for (const auto& name : m_keyHeaders)
+	{
+		key += '\n';
+		key += name;
+		key += ':';
+		for (const auto& [headerName, value] : request.headers)
+		{
+			if (Detail::HeaderNameEquals(headerName, name) == true)
+			{
+				key += value;
+				key += ',';
+			}
+		}
+	}
+	return key;
+}
+
+void SingleFlight::Join(Request&& request,
+	std::unique_ptr<Detail::ResponseHandlerBase> waiter) noexcept
+{
+	// only safe methods are shared. anything else may change something
+	// on the server, so every request gets a transfer of its own
+	const bool shared = request.method == "GET" || request.method == "HEAD";
+	std::string key;
+	if (shared == true)
+	{
+		key = MakeKey(request);
+		if (auto flightIt = m_flights.find(key); flightIt != m_flights.end())
+		{
+			// a late joiner just waits for the transfer that is already running
+			flightIt->second->waiters.push_back(std::move(waiter));
+			m_coalesced.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+	auto flight = std::make_unique<Flight>();
+	flight->response = std::make_shared<SharedResponse>();
+	flight->waiters.push_back(std::move(waiter));
+	auto& easy = flight->easy;
+	if (m_configure)
+		m_configure(easy);
+	easy.SetURL(request.url.c_str());
+	// a HEAD with a custom request would wait for a body that never comes
+	if (request.method == "HEAD")
+		easy.SetOption(CURLoption::CURLOPT_NOBODY, 1L);
+	else if (request.method != "GET")
+		easy.SetOption(CURLoption::CURLOPT_CUSTOMREQUEST, request.method.c_str());
+	for (const auto& [name, value] : request.headers)
+		easy.AddHeader({ name, value });
+	easy.SetBuffer(flight->response->body);
+	easy.SetOption(CURLoption::CURLOPT_HEADERFUNCTION, &Detail::HeaderCb);
+	easy.SetOption(CURLoption::CURLOPT_HEADERDATA, &flight->response->headers);
+	if (shared == false)
+	{
+		// nobody else can find it, so the transfer carries its own flight
+		m_multi.AsyncPerform(easy, [this, flight = std::move(flight)](
+			const error_code& ec) mutable
+			{
+				asio::post(m_strand, [this, flight = std::move(flight), ec]() mutable
+					{
+						Land(std::move(flight), ec);
+					});
+			});
+		return;
+	}
+	auto [flightIt, inserted] = m_flights.emplace(key, std::move(flight));
+	// the multi handle calls us from its own strand, so hop back into ours
+	m_multi.AsyncPerform(flightIt->second->easy, [this, key = std::move(key)](
+		const error_code& ec) mutable
+		{
+			asio::post(m_strand, [this, key = std::move(key), ec]
+				{
+					Land(key, ec);
+				});
+		});
+}
+
+void SingleFlight::Land(const std::string& key, error_code ec) noexcept
+{
+	auto flightIt = m_flights.find(key);
+	if (flightIt == m_flights.end())
+		return;
+	// untrack the flight first, so that anyone who asks for the same
+	// key from a handler gets a fresh transfer
+	auto flight = std::move(flightIt->second);
+	m_flights.erase(flightIt);
+	Land(std::move(flight), ec);
+}
+
+void SingleFlight::Land(std::unique_ptr<Flight> flight, error_code ec) noexcept
+{
+	ResponsePtr response;
+	if (!ec)
+	{
+		flight->easy.GetInfo(CURLINFO_RESPONSE_CODE, flight->response->status);
+		response = std::move(flight->response);
+	}
+	for (auto& waiter : flight->waiters)
+		waiter->Complete(ec, response);
+}
@@ -0,0 +1,102 @@
+#include <curl-multi-asio/Trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+using cma::TraceRecorder;
+
+namespace
+{
+	/// @brief How an event shows up in the trace
+	struct Phase
+	{
+		/// @brief The span it begins or ends, or the name of an instant
+		const char* name;
+		/// @brief The Chrome trace phase
+		char phase;
+	};
+
+	/// @param type The type of an event
+	/// @return How it shows up in the trace
+	Phase GetPhase(cma::TraceEventType type) noexcept
+	{
+		switch (type)
+		{
+		case cma::TraceEventType::Enqueue:
+			return { "queued", 'b' };
+		case cma::TraceEventType::Admit:
+			return { "queued", 'e' };
+		case cma::TraceEventType::Start:
+			return { "attempt", 'b' };
+		case cma::TraceEventType::Done:
+			return { "attempt", 'e' };
+		case cma::TraceEventType::HandlerBegin:
+			return { "handler", 'b' };
+		case cma::TraceEventType::HandlerEnd:
+			return { "handler", 'e' };
+		case cma::TraceEventType::Connect:
+			return { "connect", 'n' };
+		case cma::TraceEventType::FirstByte:
+			return { "first byte", 'n' };
+		case cma::TraceEventType::SocketOpen:
+			return { "socket open", 'i' };
+		default:
+			return { "socket close", 'i' };
+		}
+	}
+}
+
+TraceRecorder::TraceRecorder(size_t capacity) :
+	m_epoch(std::chrono::steady_clock::now()), m_records(std::max<size_t>(capacity, 1)) {}
+
+void TraceRecorder::OnEvent(const TraceEvent& event) noexcept
+{
+	std::lock_guard lock(m_mutex);
+	m_records[m_recorded++ % m_records.size()] = { event, std::this_thread::get_id() };
+}
+
+void TraceRecorder::WriteChromeTrace(std::ostream& out) const
+{
+	std::lock_guard lock(m_mutex);
+	const auto kept = std::min(m_recorded, m_records.size());
+	// threads get small ids in the order they show up
+	std::unordered_map<std::thread::id, size_t> threads;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	char line[256];
+	for (size_t i = 0; i < kept; ++i)
+	{
+		const auto& record = m_records[(m_recorded - kept + i) % m_records.size()];
+		const auto& event = record.event;
+		const auto phase = GetPhase(event.type);
+		const auto thread = threads.emplace(record.thread, threads.size() + 1).first->second;
+		const auto time = std::chrono::duration<double, std::micro>(event.time - m_epoch).count();
+		int length = std::snprintf(line, sizeof(line),
+			"%s{\"name\":\"%s\",\"cat\":\"transfer\",\"ph\":\"%c\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f",
+			(i == 0) ? "" : ",", phase.name, phase.phase, thread, time);
+		if (phase.phase == 'i')
+			length += std::snprintf(line + length, sizeof(line) - length,
+				",\"s\":\"p\",\"args\":{\"socket\":%lld}}", static_cast<long long>(event.socket));
+		else if (event.type == TraceEventType::Done)
+			length += std::snprintf(line + length, sizeof(line) - length,
+				",\"id\":\"%p\",\"args\":{\"result\":%d}}", static_cast<const void*>(event.transfer),
+				static_cast<int>(event.result));
+		else
+			length += std::snprintf(line + length, sizeof(line) - length,
+				",\"id\":\"%p\"}", static_cast<const void*>(event.transfer));
+		out.write(line, length);
+	}
+	out << "]}";
+}
+
+size_t TraceRecorder::GetSize() const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	return std::min(m_recorded, m_records.size());
+}
+
+void TraceRecorder::Clear() noexcept
+{
+	std::lock_guard lock(m_mutex);
+	m_recorded = 0;
+}
@@ -0,0 +1,122 @@
+#include <curl-multi-asio/TransferStream.h>
+
+#include <curl-multi-asio/RequestGroup.h>
+
+#include <algorithm>
+#include <utility>
+
+using cma::TransferStream;
+
+TransferStream::TransferStream(Multi& multi, std::span<Easy> easyHandles,
+	size_t window, StreamOrder order, PerformOptions options) :
+	m_multi(multi), m_easies(easyHandles), m_window(std::max<size_t>(window, 1)),
+	m_order(order), m_options(std::move(options)), m_strand(multi.GetExecutor()),
+	m_slots(m_window)
+{
+	m_options.group = std::make_shared<RequestGroup>(multi);
+}
+
+void TransferStream::Start()
+{
+	asio::post(m_strand, [self = shared_from_this()] { self->Admit(); });
+}
+
+void TransferStream::Cancel() noexcept
+{
+	// the transfers in flight are cancelled right away, and any the strand
+	// starts before it sees the stream was cancelled are aborted by the group
+	m_options.group->Cancel();
+	asio::post(m_strand, [self = shared_from_this()]
+		{
+			if (std::exchange(self->m_cancelled, true) == true)
+				return;
+			// nothing is started from here on, so once the group settles
+			// none of the easy handles are in use
+			self->m_options.group->AsyncWait([self](const error_code&, size_t)
+				{
+					asio::dispatch(self->m_strand, [self]
+						{
+							self->m_settled = true;
+							self->Deliver();
+						});
+				});
+		});
+}
+
+void TransferStream::Receive(std::unique_ptr<Detail::StreamReceiverBase> receiver)
+{
+	asio::post(m_strand, [self = shared_from_this(),
+		receiver = std::move(receiver)]() mutable
+		{
+			self->m_receiver = std::move(receiver);
+			self->Deliver();
+		});
+}
+
+void TransferStream::Admit() noexcept
+{
+	while (m_cancelled == false && m_started < m_easies.size() &&
+		m_started - m_received < m_window)
+	{
+		const auto index = m_started++;
+		m_multi.AsyncPerform(m_easies[index], m_options,
+			[self = shared_from_this(), index](const error_code& ec)
+			{
+				asio::dispatch(self->m_strand, [self, index, ec]
+					{
+						self->Land(index, ec);
+					});
+			});
+	}
+}
+
+void TransferStream::Land(size_t index, error_code result) noexcept
+{
+	// nothing is received after a cancel
+	if (m_cancelled == true)
+		return;
+	// there are never more than a window of results waiting, and in
+	// submission order they are all within a window of the next one
+	auto& slot = (m_order == StreamOrder::Submission) ? m_slots[index % m_window] :
+		m_slots[(m_head + m_ready++) % m_window];
+	slot.index = index;
+	slot.result = result;
+	slot.ready = true;
+	Deliver();
+}
+
+void TransferStream::Deliver() noexcept
+{
+	if (m_receiver == nullptr)
+		return;
+	// a receive after a cancel waits for the transfers to complete
+	if (m_cancelled == true)
+	{
+		if (m_settled == true)
+			std::exchange(m_receiver, nullptr)->Complete(
+				asio::error::operation_aborted, 0, error_code());
+		return;
+	}
+	if (m_received == m_easies.size())
+		return std::exchange(m_receiver, nullptr)->Complete(
+			asio::error::eof, m_easies.size(), error_code());
+	Slot* slot = nullptr;
+	if (m_order == StreamOrder::Submission)
+		slot = &m_slots[m_received % m_window];
+	else if (m_ready > 0)
+		slot = &m_slots[m_head];
+	if (slot == nullptr || slot->ready == false)
+		return;
+	if (m_order == StreamOrder::Completion)
+	{
+		m_head = (m_head + 1) % m_window;
+		--m_ready;
+	}
+	slot->ready = false;
+	const auto index = slot->index;
+	const auto result = slot->result;
+	++m_received;
+	// the consumer caught up by one, so another transfer can start
+	Admit();
+	std::exchange(m_receiver, nullptr)->Complete(error_code(), index, result);
+}